@@ -1,13 +1,20 @@
 #include "array.h"
+#include "dynflush.h"
 
 #include <setjmp.h>
 #include <stdint.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <time.h>
+#include <unistd.h>
 #include <zcmocka.h>
 
 DEFINE_COMPARE_TYPE(long)
 DEFINE_COMPARE_TYPE(float)
+DEFINE_TYPED_DA(long)
+DEFINE_TYPED_DA(float)
 #define FILENAME "mm.dat"
+#define WALNAME FILENAME WAL_SUFFIX
 
 dynArray *pDALng;
 dynArray *pDAFlt;
@@ -350,6 +357,198 @@ void test_subDA(void **state) {
   freeDA(sub);
 }
 
+bool isOdd(const void *entry, void *ref) {
+  (*(long *)ref)++;
+  return *(const long *)entry % 2 != 0;
+}
+
+void test_insertErase(void **state) {
+  pDALng = createDA(sizeof(long), compareDAlong, NULL);
+  long arr[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  long mid[] = {-1, -2, -3};
+
+  assert_true(insertArrayDA(pDALng, 0, arr, 10));
+  assert_false(insertArrayDA(pDALng, 11, mid, 3));
+  assert_true(insertArrayDA(pDALng, 4, mid, 3));
+  assert_true(insertArrayDA(pDALng, 13, mid, 1));
+  assert_int_equal(pDALng->size, 14);
+
+  long expected[] = {0, 1, 2, 3, -1, -2, -3, 4, 5, 6, 7, 8, 9, -1};
+  assert_memory_equal(pDALng->array, expected, sizeof(expected));
+
+  assert_false(eraseRangeDA(pDALng, 5, 14));
+  assert_false(eraseRangeDA(pDALng, 6, 5));
+  assert_true(eraseRangeDA(pDALng, 4, 6));
+  assert_true(eraseRangeDA(pDALng, 10, 10));
+  assert_int_equal(pDALng->size, 10);
+  assert_memory_equal(pDALng->array, arr, sizeof(arr));
+
+  // each entry is tested once and the even ones keep their order
+  long calls = 0;
+  assert_int_equal(removeIfDA(pDALng, isOdd, &calls), 5);
+  assert_int_equal(calls, 10);
+  long evens[] = {0, 2, 4, 6, 8};
+  assert_int_equal(pDALng->size, 5);
+  assert_memory_equal(pDALng->array, evens, sizeof(evens));
+  assert_int_equal(removeIfDA(pDALng, isOdd, &calls), 0);
+
+  dynArray *sub = subDA(pDALng, 1, 3);
+  assert_false(insertArrayDA(sub, 0, mid, 1));
+  assert_false(eraseRangeDA(sub, 0, 0));
+  assert_int_equal(removeIfDA(sub, isOdd, &calls), 0);
+  freeDA(sub);
+
+  assert_true(eraseRangeDA(pDALng, 0, 4));
+  assert_int_equal(pDALng->size, 0);
+}
+
+void test_emplace(void **state) {
+  pDALng = createDA(sizeof(long), compareDAlong, NULL);
+
+  for (long i = 0; i < 100; i++) {
+    *(long *)emplaceDA(pDALng) = i;
+  }
+  long *slots = emplaceArrayDA(pDALng, 50);
+  for (long i = 0; i < 50; i++) {
+    slots[i] = 100 + i;
+  }
+  assert_int_equal(pDALng->size, 150);
+  for (long i = 0; i < 150; i++) {
+    assert_int_equal(*(long *)getDA(pDALng, i), i);
+  }
+
+  dynArray *sub = subDA(pDALng, 0, 9);
+  assert_null(emplaceDA(sub));
+  assert_int_equal(sub->size, 10);
+  freeDA(sub);
+  freeDA(pDALng);
+
+  // the filled slots are committed to the log together, then the process
+  // exits without writing back the data
+  pid_t pid = fork();
+  if (pid == 0) {
+    dynArray *pDA = createDA(
+        sizeof(long), NULL,
+        &(dynArrayParams){.filename = FILENAME, .walBatch = 1});
+    beginWriteDA(pDA);
+    slots = emplaceArrayDA(pDA, 10);
+    for (long i = 0; i < 10; i++) {
+      slots[i] = -i;
+    }
+    endWriteDA(pDA);
+    _exit(0);
+  }
+  waitpid(pid, NULL, 0);
+
+  fileHeader header;
+  FILE *fp = fopen(FILENAME, "r+");
+  assert_int_equal(fread(&header, sizeof(fileHeader), 1, fp), 1);
+  ftruncate(fileno(fp), header.offset);
+  fclose(fp);
+
+  pDALng = loadDA(FILENAME, NULL);
+  assert_int_equal(pDALng->size, 10);
+  assert_int_equal(*(long *)getDA(pDALng, 9), -9);
+}
+
+void test_typed(void **state) {
+  pDALng = createDA(sizeof(long), compareDAlong, NULL);
+  dynArray *pDACmp = createDA(sizeof(long), compareDAlong, NULL);
+
+  unsigned int seed = 7;
+  for (long i = 0; i < 5000; i++) {
+    // plenty of duplicates
+    long value = rand_r(&seed) % 1000 - 500;
+    assert_true(pushDAlong(pDALng, value));
+    addDA(pDACmp, &value);
+  }
+  assert_int_equal(pDALng->size, 5000);
+  assert_int_equal(getDAlong(pDALng, 10), *(long *)getDA(pDACmp, 10));
+
+  sortDAlong(pDALng);
+  qsort(pDACmp->array, pDACmp->size, sizeof(long), compareDAlong);
+  assert_memory_equal(pDALng->array, pDACmp->array, 5000 * sizeof(long));
+  freeDA(pDACmp);
+
+  setDAlong(pDALng, 0, -1000);
+  size_t found = searchDAlong(pDALng, 7);
+  assert_int_equal(getDAlong(pDALng, found), 7);
+  assert_true(found == 0 || getDAlong(pDALng, found - 1) < 7);
+  assert_int_equal(searchDAlong(pDALng, -1000), 0);
+  assert_int_equal(searchDAlong(pDALng, 501), -1);
+  assert_int_equal(searchDAlong(pDALng, -501), -1);
+
+  // out of order values are sorted before searching
+  setDAlong(pDALng, 0, 2000);
+  assert_int_equal(searchDAlong(pDALng, 2000), 4999);
+
+  dynArray *sub = subDA(pDALng, 100, 199);
+  assert_false(pushDAlong(sub, 1));
+  for (size_t i = 0; i < sub->size; i++) {
+    setDAlong(sub, i, 100 - i);
+  }
+  sortDAlong(sub);
+  assert_int_equal(getDAlong(sub, 0), 1);
+  assert_int_equal(getDAlong(pDALng, 199), 100);
+  freeDA(sub);
+
+  pDAFlt = createDA(sizeof(float), compareDAfloat, NULL);
+  for (int i = 20; i > 0; i--) {
+    pushDAfloat(pDAFlt, i / 4.0f);
+  }
+  sortDAfloat(pDAFlt);
+  assert_true(getDAfloat(pDAFlt, 0) == 0.25f);
+  assert_int_equal(searchDAfloat(pDAFlt, 2.5f), 9);
+  freeDA(pDAFlt);
+  pDAFlt = NULL;
+}
+
+void test_view(void **state) {
+  pDALng = createDA(sizeof(long), compareDAlong, NULL);
+  long arr[] = {0, 9, 8, 7, 6, 5, 4, 3, 2, 1};
+  addArrayDA(pDALng, arr, 10);
+
+  dynArrayView view = viewDA(pDALng, 1, 8);
+  assert_true(validViewDA(&view));
+  assert_int_equal(view.size, 8);
+  assert_int_equal(*(long *)getViewDA(&view, 0), 9);
+  assert_null(getViewDA(&view, 8));
+
+  sortViewDA(&view, NULL);
+  assert_int_equal(*(long *)getDA(pDALng, 0), 0);
+  assert_int_equal(*(long *)getDA(pDALng, 1), 2);
+  assert_int_equal(*(long *)getDA(pDALng, 8), 9);
+  assert_int_equal(*(long *)getDA(pDALng, 9), 1);
+  assert_int_equal(searchViewDA(&view, &(long){7}, NULL), 5);
+  assert_int_equal(searchViewDA(&view, &(long){1}, NULL), -1);
+
+  reverseViewDA(&view);
+  assert_int_equal(*(long *)getDA(pDALng, 1), 9);
+  assert_int_equal(*(long *)getDA(pDALng, 8), 2);
+
+  // views of a sub array refer to the parent
+  dynArray *sub = subDA(pDALng, 2, 9);
+  dynArrayView inner = viewDA(sub, 1, 2);
+  assert_ptr_equal(inner.parent, pDALng);
+  assert_int_equal(*(long *)getViewDA(&inner, 0), 7);
+  freeDA(sub);
+
+  dynArrayView empty = viewDA(pDALng, 5, 10);
+  assert_int_equal(empty.size, 0);
+  assert_false(validViewDA(&empty));
+  assert_int_equal(searchViewDA(&empty, &(long){1}, NULL), -1);
+
+  // growing the array moves the storage
+  for (long i = 0; i < 100; i++) {
+    addDA(pDALng, &i);
+  }
+  assert_false(validViewDA(&view));
+  view = viewDA(pDALng, 1, 8);
+  assert_true(validViewDA(&view));
+  clearDA(pDALng);
+  assert_false(validViewDA(&view));
+}
+
 void test_copy(void **state) {
   pDALng = createDA(sizeof(long), compareDAlong, NULL);
   dynArray *copy;
@@ -366,10 +565,58 @@ void test_copy(void **state) {
   }
   assert_int_equal(copy->size, pDALng->size);
   assert_int_equal(copy->growth, pDALng->growth);
+  assert_int_equal(copy->capacity, pDALng->capacity);
 
   freeDA(copy);
 }
 
+void test_clone(void **state) {
+  char cloneName[] = "clone.dat";
+  pDALng = createDA(sizeof(long), compareDAlong,
+                    &(dynArrayParams){.filename = FILENAME, .capacity = 5000});
+  for (long i = 0; i < 3000; i++) {
+    addDA(pDALng, &i);
+  }
+
+  // file to file
+  dynArray *copy = cloneDA(
+      pDALng, &(dynArrayParams){.filename = cloneName, .checksumBlock = 4096});
+  assert_int_equal(copy->size, 3000);
+  assert_int_equal(copy->capacity, 5000);
+  assert_int_equal(*(long *)getDA(copy, 2999), 2999);
+  setDA(copy, 0, &(long){-1});
+  assert_int_equal(*(long *)getDA(pDALng, 0), 0);
+  syncDAMap(copy);
+  freeDA(copy);
+
+  copy = loadDA(cloneName, compareDAlong);
+  assert_non_null(copy);
+  assert_true(verifyDA(copy));
+  assert_int_equal(*(long *)getDA(copy, 0), -1);
+  assert_int_equal(*(long *)getDA(copy, 1500), 1500);
+
+  // file to heap, with a larger capacity
+  dynArray *heap = cloneDA(copy, &(dynArrayParams){.capacity = 8000});
+  assert_null(heap->fp);
+  assert_int_equal(heap->capacity, 8000);
+  assert_int_equal(*(long *)getDA(heap, 2999), 2999);
+  freeDA(copy);
+  remove(cloneName);
+
+  // heap to a logged file
+  copy = cloneDA(heap, &(dynArrayParams){.filename = cloneName, .walBatch = 4});
+  freeDA(heap);
+  syncDAMap(copy);
+  freeDA(copy);
+  copy = loadDA(cloneName, compareDAlong);
+  assert_int_equal(copy->size, 3000);
+  assert_int_equal(*(long *)getDA(copy, 0), -1);
+  assert_int_equal(*(long *)getDA(copy, 2999), 2999);
+  freeDA(copy);
+  remove(cloneName);
+  remove("clone.dat" WAL_SUFFIX);
+}
+
 void test_binSearch(void **state) {
   pDALng = createDA(sizeof(long), compareDAlong, NULL);
   long value;
@@ -442,6 +689,45 @@ void test_appendDA(void **state) {
   freeDA(other);
 }
 
+void test_typedAccess(void **state) {
+  size_t max = 10000000;
+  clock_t start_t;
+  long sum = 0;
+
+  pDALng = createDA(sizeof(long), NULL, NULL);
+  start_t = clock();
+  for (long i = 0; i < max; i++) {
+    addDA(pDALng, &i);
+  }
+  for (size_t i = 0; i < max; i++) {
+    sum += *(long *)getDA(pDALng, i);
+  }
+  printf("Generic add and get:%lu\tSum:%ld\tCPU Time(sec): %f\n", max, sum,
+         (double)(clock() - start_t) / CLOCKS_PER_SEC);
+  freeDA(pDALng);
+
+  sum = 0;
+  pDALng = createDA(sizeof(long), NULL, NULL);
+  start_t = clock();
+  for (long i = 0; i < max; i++) {
+    pushDAlong(pDALng, i);
+  }
+  for (size_t i = 0; i < max; i++) {
+    sum += getDAlong(pDALng, i);
+  }
+  printf("Typed push and get:%lu\tSum:%ld\tCPU Time(sec): %f\n", max, sum,
+         (double)(clock() - start_t) / CLOCKS_PER_SEC);
+
+  unsigned int seed = 1;
+  for (size_t i = 0; i < max; i++) {
+    setDAlong(pDALng, i, rand_r(&seed));
+  }
+  start_t = clock();
+  sortDAlong(pDALng);
+  printf("Typed sort:%lu\tCPU Time(sec): %f\n", max,
+         (double)(clock() - start_t) / CLOCKS_PER_SEC);
+}
+
 void test_growing(void **state) {
   size_t i, max = 10, capacity, range;
   clock_t start_t, end_t;
@@ -473,6 +759,35 @@ void test_growing(void **state) {
   }
 }
 
+void test_randomAccess(void **state) {
+  size_t i, max = 1UL << 27, reads = 1UL << 24;
+  clock_t start_t, end_t;
+  double total_t;
+  long sum;
+
+  for (int huge = 0; huge <= 1; huge++) {
+    dynArrayParams params = (dynArrayParams){.hugePages = huge};
+    pDALng = createDA(sizeof(long), NULL, &params);
+    resizeDA(pDALng, max, &(long){1});
+
+    unsigned int seed = 1;
+    sum = 0;
+    start_t = clock();
+    for (i = 0; i < reads; i++) {
+      seed = seed * 1103515245 + 12345;
+      sum += *(long *)getDA(pDALng, ((size_t)seed << 4) % max);
+    }
+    end_t = clock();
+    total_t = (double)(end_t - start_t) / CLOCKS_PER_SEC;
+    printf("Huge pages:%d\tObtained(MB):%lu\tReads:%lu\tSum:%ld\tCPU "
+           "Time(sec): %f\tReads/sec: %.0f\n",
+           huge, hugePagesDA(pDALng) >> 20, reads, sum, total_t,
+           reads / total_t);
+    freeDA(pDALng);
+    pDALng = NULL;
+  }
+}
+
 bool counter(void *entry, void *ref) {
   *((long *)ref) += *((long *)entry);
   return true;
@@ -492,6 +807,437 @@ void test_forEach(void **state) {
   assert_int_equal(count, 45);
 }
 
+bool rangeCounter(void *begin, size_t count, void *ref) {
+  long *entries = begin;
+  for (size_t i = 0; i < count; i++) {
+    ((long *)ref)[0] += entries[i];
+  }
+  ((long *)ref)[1]++;
+  return ((long *)ref)[1] < ((long *)ref)[2];
+}
+
+void test_forEachRange(void **state) {
+  pDALng = createDA(sizeof(long), NULL, NULL);
+  for (long i = 0; i < 10; i++) {
+    addDA(pDALng, &i);
+  }
+
+  // sum, calls, call limit
+  long totals[3] = {0, 0, 100};
+  assert_true(forEachRangeDA(pDALng, rangeCounter, totals, 3));
+  assert_int_equal(totals[0], 45);
+  assert_int_equal(totals[1], 4);
+
+  totals[0] = totals[1] = 0;
+  assert_true(forEachRangeDA(pDALng, rangeCounter, totals, 0));
+  assert_int_equal(totals[0], 45);
+  assert_int_equal(totals[1], 1);
+
+  totals[0] = totals[1] = 0;
+  totals[2] = 2;
+  assert_false(forEachRangeDA(pDALng, rangeCounter, totals, 4));
+  assert_int_equal(totals[0], 0 + 1 + 2 + 3 + 4 + 5 + 6 + 7);
+
+  dynArray *sub = subDA(pDALng, 2, 6);
+  totals[0] = totals[1] = 0;
+  totals[2] = 100;
+  assert_true(forEachRangeDA(sub, rangeCounter, totals, 2));
+  assert_int_equal(totals[0], 2 + 3 + 4 + 5 + 6);
+  assert_int_equal(totals[1], 3);
+  freeDA(sub);
+
+  clearDA(pDALng);
+  totals[1] = 0;
+  assert_true(forEachRangeDA(pDALng, rangeCounter, totals, 0));
+  assert_int_equal(totals[1], 0);
+}
+
+void test_arena(void **state) {
+  dynArrayArena *arena = createArenaDA(256);
+  dynArray *arrays[10];
+  long i, j;
+
+  for (j = 0; j < 2; j++) {
+    for (i = 0; i < 10; i++) {
+      arrays[i] = createDA(sizeof(long), NULL,
+                           &(dynArrayParams){.capacity = 4, .arena = arena});
+      assert_true(arrays[i]->arena == arena);
+    }
+
+    for (i = 0; i < 10; i++) {
+      for (long v = 0; v < 10; v++) {
+        long value = i * 100 + v;
+        addDA(arrays[i], &value);
+      }
+    }
+
+    for (i = 0; i < 10; i++) {
+      assert_int_equal(arrays[i]->size, 10);
+      for (long v = 0; v < 10; v++) {
+        assert_int_equal(*(long *)getDA(arrays[i], v), i * 100 + v);
+      }
+      freeDA(arrays[i]);
+    }
+
+    resetArenaDA(arena);
+    assert_int_equal(arena->used, 0);
+    assert_true(arena->next == NULL);
+  }
+
+  assert_true(arena->capacity > 256);
+  freeArenaDA(arena);
+}
+
+void test_inlineStorage(void **state) {
+  dynArrayParams params =
+      (dynArrayParams){.capacity = 4, .inlineStorage = true};
+  pDALng = createDA(sizeof(long), compareDAlong, &params);
+
+  assert_true(pDALng->inlined);
+  assert_true(pDALng->array > (void *)pDALng);
+
+  long i;
+  for (i = 0; i < 3; i++) {
+    addDA(pDALng, &i);
+  }
+  assert_true(pDALng->inlined);
+
+  for (i = 3; i < 20; i++) {
+    addDA(pDALng, &i);
+  }
+  assert_false(pDALng->inlined);
+
+  reverseDA(pDALng);
+  for (i = 0; i < 20; i++) {
+    assert_int_equal(*(long *)getDA(pDALng, i), 19 - i);
+  }
+}
+
+void test_reserveResize(void **state) {
+  dynArrayParams params =
+      (dynArrayParams){.capacity = 4, .size = 2, .noZeroInit = true};
+  pDALng = createDA(sizeof(long), NULL, &params);
+  long value = 7;
+
+  assert_true(reserveDA(pDALng, 100));
+  assert_int_equal(pDALng->capacity, 100);
+  assert_int_equal(pDALng->size, 2);
+
+  assert_true(reserveDA(pDALng, 10));
+  assert_int_equal(pDALng->capacity, 100);
+
+  assert_true(resizeDA(pDALng, 50, &value));
+  assert_int_equal(pDALng->size, 50);
+  assert_int_equal(pDALng->capacity, 100);
+  for (int i = 2; i < 50; i++) {
+    assert_int_equal(*(long *)getDA(pDALng, i), 7);
+  }
+
+  assert_true(resizeDA(pDALng, 10, NULL));
+  assert_int_equal(pDALng->size, 10);
+  assert_true(getDA(pDALng, 10) == NULL);
+
+  assert_true(resizeDA(pDALng, 200, NULL));
+  assert_int_equal(pDALng->size, 200);
+  assert_true(pDALng->capacity >= 200);
+  assert_int_equal(*(long *)getDA(pDALng, 9), 7);
+
+  dynArray *sub = subDA(pDALng, 2, 7);
+  assert_false(reserveDA(sub, 100));
+  assert_false(resizeDA(sub, 1, NULL));
+  freeDA(sub);
+}
+
+void test_hugePages(void **state) {
+  dynArrayParams params =
+      (dynArrayParams){.capacity = 10, .hugePages = true, .numaNodes = 1};
+  pDALng = createDA(sizeof(long), compareDAlong, &params);
+
+  assert_true(pDALng->mapped);
+  assert_int_equal((size_t)pDALng->array & (HUGE_PAGE_SIZE - 1), 0);
+
+  long i, max = 1000000;
+  for (i = max - 1; i >= 0; i--) {
+    addDA(pDALng, &i);
+  }
+  assert_int_equal((size_t)pDALng->array & (HUGE_PAGE_SIZE - 1), 0);
+
+  reverseDA(pDALng);
+  for (i = 0; i < max; i += 1000) {
+    assert_int_equal(*(long *)getDA(pDALng, i), i);
+  }
+
+  // the request holds as the map grows, whether or not it was granted
+  assert_true(pDALng->hugePages);
+  assert_true(hugePagesDA(pDALng) <= pDALng->capacity * sizeof(long) +
+                                         HUGE_PAGE_SIZE);
+
+  resizeDA(pDALng, 10, NULL);
+  reduceMemDA(pDALng);
+  assert_int_equal(pDALng->capacity, 10);
+  assert_int_equal(*(long *)getDA(pDALng, 9), 9);
+}
+
+void test_alignment(void **state) {
+  pDALng = createDA(sizeof(long), NULL, NULL);
+  assert_int_equal(pDALng->alignment, DEFAULT_ALIGNMENT);
+  assert_int_equal((size_t)pDALng->array % DEFAULT_ALIGNMENT, 0);
+
+  long i;
+  for (i = 0; i < 1000; i++) {
+    addDA(pDALng, &i);
+  }
+  assert_int_equal((size_t)pDALng->array % DEFAULT_ALIGNMENT, 0);
+  assert_int_equal(*(long *)getDA(pDALng, 999), 999);
+  freeDA(pDALng);
+
+  pDALng = createDA(sizeof(long), NULL,
+                    &(dynArrayParams){.alignment = CACHE_LINE_ALIGNMENT});
+  for (i = 0; i < 1000; i++) {
+    addDA(pDALng, &i);
+    assert_int_equal((size_t)pDALng->array % CACHE_LINE_ALIGNMENT, 0);
+  }
+  freeDA(pDALng);
+
+  pDALng = createDA(sizeof(long), NULL,
+                    &(dynArrayParams){.alignment = 256, .inlineStorage = true});
+  assert_int_equal((size_t)pDALng->array % 256, 0);
+  for (i = 0; i < 100; i++) {
+    addDA(pDALng, &i);
+  }
+  assert_int_equal((size_t)pDALng->array % 256, 0);
+  assert_int_equal(*(long *)getDA(pDALng, 99), 99);
+  freeDA(pDALng);
+
+  pDALng = createDA(sizeof(long), NULL,
+                    &(dynArrayParams){.filename = FILENAME});
+  assert_int_equal(pDALng->alignment, CACHE_LINE_ALIGNMENT);
+  assert_int_equal(pDALng->offset % CACHE_LINE_ALIGNMENT, 0);
+  assert_int_equal((size_t)pDALng->array % CACHE_LINE_ALIGNMENT, 0);
+  freeDA(pDALng);
+  remove(FILENAME);
+
+  pDALng = createDA(sizeof(long), NULL,
+                    &(dynArrayParams){.filename = FILENAME, .alignment = 128});
+  assert_int_equal(pDALng->offset % 128, 0);
+  assert_int_equal((size_t)pDALng->array % 128, 0);
+  for (i = 0; i < 100; i++) {
+    addDA(pDALng, &i);
+  }
+  freeDA(pDALng);
+
+  pDALng = loadDA(FILENAME, NULL);
+  assert_int_equal(pDALng->alignment, 128);
+  assert_int_equal((size_t)pDALng->array % 128, 0);
+  assert_int_equal(pDALng->size, 100);
+  for (i = 0; i < 100; i++) {
+    assert_int_equal(*(long *)getDA(pDALng, i), i);
+  }
+}
+
+void test_load_v1(void **state) {
+  long data[] = {5, 6, 7};
+  fileHeader header = (fileHeader){.version = 1,
+                                   .elementSize = sizeof(long),
+                                   .size = 3,
+                                   .capacity = 3,
+                                   .growth = 1.5};
+  FILE *fp = fopen(FILENAME, "w");
+  fwrite(&header, FILE_HEADER_V1_SIZE, 1, fp);
+  fwrite(data, sizeof(long), 3, fp);
+  fclose(fp);
+
+  pDALng = loadDA(FILENAME, NULL);
+  assert_int_equal(pDALng->offset, FILE_HEADER_V1_SIZE);
+  assert_int_equal(pDALng->size, 3);
+  for (int i = 0; i < 3; i++) {
+    assert_int_equal(*(long *)getDA(pDALng, i), data[i]);
+  }
+
+  long value = 8;
+  addDA(pDALng, &value);
+  freeDA(pDALng);
+
+  pDALng = loadDA(FILENAME, NULL);
+  assert_int_equal(pDALng->size, 4);
+  assert_int_equal(*(long *)getDA(pDALng, 0), 5);
+  assert_int_equal(*(long *)getDA(pDALng, 3), 8);
+}
+
+void test_checksum(void **state) {
+  assert_int_equal(crc32c("123456789", 9, 0), 0xE3069283);
+  assert_int_equal(crc32c("56789", 5, crc32c("1234", 4, 0)), 0xE3069283);
+
+  dynArrayParams params =
+      (dynArrayParams){.filename = FILENAME, .checksumBlock = 64};
+  pDALng = createDA(sizeof(long), NULL, &params);
+
+  long i;
+  for (i = 0; i < 100; i++) {
+    addDA(pDALng, &i);
+  }
+  syncDAMap(pDALng);
+  assert_int_equal(pDALng->checksums, 13);
+  assert_true(verifyDA(pDALng));
+  freeDA(pDALng);
+
+  pDALng = loadDA(FILENAME, NULL);
+  assert_non_null(pDALng);
+  assert_int_equal(pDALng->version, FILE_VERSION);
+  assert_true(verifyDA(pDALng));
+  size_t offset = pDALng->offset;
+  freeDA(pDALng);
+
+  // corrupt one element
+  FILE *fp = fopen(FILENAME, "r+");
+  fseek(fp, offset + 50 * sizeof(long), SEEK_SET);
+  fputc(0xFF, fp);
+  fclose(fp);
+
+  pDALng = loadDA(FILENAME, NULL);
+  assert_non_null(pDALng);
+  assert_false(verifyDA(pDALng));
+  freeDA(pDALng);
+  pDALng = NULL;
+
+  // corrupt the header
+  fp = fopen(FILENAME, "r+");
+  fseek(fp, offsetof(fileHeader, size), SEEK_SET);
+  fputc(0x01, fp);
+  fclose(fp);
+  assert_null(loadDA(FILENAME, NULL));
+
+  // truncated file
+  fp = fopen(FILENAME, "w");
+  fwrite("short", 5, 1, fp);
+  fclose(fp);
+  assert_null(loadDA(FILENAME, NULL));
+
+  assert_null(loadDA("missing.dat", NULL));
+}
+
+void test_wal(void **state) {
+  // write from a child process that exits without freeing, as in a crash
+  pid_t pid = fork();
+  if (pid == 0) {
+    dynArrayParams params =
+        (dynArrayParams){.filename = FILENAME, .walBatch = 10};
+    dynArray *pDA = createDA(sizeof(long), NULL, &params);
+    long i;
+    for (i = 0; i < 100; i++) {
+      addDA(pDA, &i);
+    }
+    setDA(pDA, 5, &(long){-5});
+    commitDA(pDA);
+    // never committed
+    for (; i < 105; i++) {
+      addDA(pDA, &i);
+    }
+    _exit(0);
+  }
+  waitpid(pid, NULL, 0);
+
+  // drop the data as if the pages were never written back
+  fileHeader header;
+  FILE *fp = fopen(FILENAME, "r+");
+  assert_int_equal(fread(&header, sizeof(fileHeader), 1, fp), 1);
+  assert_true(header.flags & FILE_FLAG_WAL);
+  ftruncate(fileno(fp), header.offset);
+  fclose(fp);
+
+  // a torn batch at the end of the log
+  fp = fopen(WALNAME, "a");
+  fwrite("torn", 4, 1, fp);
+  fclose(fp);
+
+  pDALng = loadDA(FILENAME, NULL);
+  assert_non_null(pDALng);
+  assert_non_null(pDALng->wal);
+  assert_int_equal(pDALng->walBatch, 10);
+  assert_int_equal(pDALng->size, 100);
+  assert_int_equal(*(long *)getDA(pDALng, 5), -5);
+  assert_int_equal(*(long *)getDA(pDALng, 99), 99);
+
+  struct stat st;
+  assert_int_equal(stat(WALNAME, &st), 0);
+  assert_int_equal(st.st_size, 0);
+
+  // writes through a pointer are marked explicitly, and a commit drops the
+  // private pages without losing them
+  *(long *)getDA(pDALng, 6) = -6;
+  logDA(pDALng, 6, 1);
+  commitDA(pDALng);
+  assert_int_equal(*(long *)getDA(pDALng, 6), -6);
+  clearDA(pDALng);
+  resizeDA(pDALng, 50, NULL);
+  freeDA(pDALng);
+
+  pDALng = loadDA(FILENAME, NULL);
+  assert_non_null(pDALng);
+  assert_int_equal(pDALng->size, 50);
+  assert_int_equal(*(long *)getDA(pDALng, 5), -5);
+  assert_int_equal(*(long *)getDA(pDALng, 6), -6);
+  assert_int_equal(*(long *)getDA(pDALng, 7), 7);
+
+  // a new file discards the old log
+  freeDA(pDALng);
+  pDALng = createDA(sizeof(long), NULL,
+                    &(dynArrayParams){.filename = FILENAME});
+  assert_null(pDALng->wal);
+  assert_int_not_equal(stat(WALNAME, &st), 0);
+}
+
+void test_writeBack(void **state) {
+  dynArrayParams params = (dynArrayParams){
+      .filename = FILENAME, .writeBack = true, .checksumBlock = 4096};
+  pDALng = createDA(sizeof(long), NULL, &params);
+  assert_non_null(pDALng->flusher);
+
+  long i;
+  for (i = 0; i < 300000; i++) {
+    addDA(pDALng, &i);
+  }
+  dynArrayFlush *flush = flushDA(pDALng);
+  assert_non_null(flush);
+  while (!pollFlushDA(flush)) {
+  }
+  assert_true(waitFlushDA(flush));
+  syncDAMap(pDALng);
+  assert_true(verifyDA(pDALng));
+  freeDA(pDALng);
+
+  // the file is interchangeable with a mapped array
+  pDALng = loadDA(FILENAME, NULL);
+  assert_non_null(pDALng);
+  assert_null(pDALng->flusher);
+  assert_int_equal(pDALng->size, 300000);
+  assert_true(verifyDA(pDALng));
+  assert_int_equal(*(long *)getDA(pDALng, 299999), 299999);
+  setDA(pDALng, 7, &(long){-7});
+  freeDA(pDALng);
+
+  pDALng = readDA(FILENAME, NULL, true);
+  assert_non_null(pDALng);
+  assert_non_null(pDALng->flusher);
+  assert_int_equal(*(long *)getDA(pDALng, 7), -7);
+  for (i = 0; i < 1000; i++) {
+    addDA(pDALng, &i);
+  }
+  setDA(pDALng, 8, &(long){-8});
+  assert_true(waitFlushDA(flushDA(pDALng)));
+  freeDA(pDALng);
+
+  pDALng = loadDA(FILENAME, NULL);
+  assert_non_null(pDALng);
+  assert_int_equal(pDALng->size, 301000);
+  assert_int_equal(*(long *)getDA(pDALng, 8), -8);
+  assert_int_equal(*(long *)getDA(pDALng, 300999), 999);
+  assert_true(verifyDA(pDALng));
+
+  assert_null(flushDA(pDALng));
+  assert_false(waitFlushDA(NULL));
+}
+
 int setupDA(void **state) {
   pDALng = NULL;
   pDAFlt = NULL;
@@ -507,10 +1253,68 @@ int teardownDA(void **state) {
   freeDA(pDADbl);
   pDADbl = NULL;
   remove(FILENAME);
+  remove(WALNAME);
 
   return 0;
 }
 
+void test_snapshot(void **state) {
+  dynArrayParams params = (dynArrayParams){.snapshots = true};
+  pDALng = createDA(sizeof(long), NULL, &params);
+  assert_non_null(pDALng->shared);
+
+  long i;
+  for (i = 0; i < 10000; i++) {
+    addDA(pDALng, &i);
+  }
+  dynArray *snap = snapshotDA(pDALng);
+  assert_true(snap->frozen);
+  assert_int_equal(snap->size, 10000);
+
+  // changes after the snapshot are not seen by it
+  setDA(pDALng, 5, &(long){-5});
+  for (i = 0; i < 10000; i++) {
+    addDA(pDALng, &i);
+  }
+  assert_int_equal(*(long *)getDA(snap, 5), 5);
+  assert_int_equal(*(long *)getDA(pDALng, 5), -5);
+  assert_int_equal(pDALng->size, 20000);
+
+  // an overlapping snapshot moves the array to new pages
+  dynArray *snap2 = snapshotDA(pDALng);
+  setDA(pDALng, 6, &(long){-6});
+  assert_int_equal(*(long *)getDA(snap, 6), 6);
+  assert_int_equal(*(long *)getDA(snap2, 5), -5);
+  assert_int_equal(*(long *)getDA(snap2, 6), 6);
+  assert_int_equal(*(long *)getDA(snap2, 19999), 9999);
+  freeDA(snap);
+
+  // a snapshot may be changed and grown without changing the array
+  setDA(snap2, 7, &(long){-7});
+  for (i = 0; i < 100000; i++) {
+    addDA(snap2, &i);
+  }
+  assert_false(snap2->frozen);
+  assert_int_equal(*(long *)getDA(snap2, 7), -7);
+  assert_int_equal(*(long *)getDA(pDALng, 7), 7);
+  assert_int_equal(*(long *)getDA(pDALng, 6), -6);
+  freeDA(snap2);
+
+  snap = snapshotDA(pDALng);
+  assert_int_equal(*(long *)getDA(snap, 6), -6);
+  assert_int_equal(snap->size, 20000);
+  freeDA(snap);
+
+  // other arrays are copied
+  dynArray *pDA = createDA(sizeof(long), NULL, NULL);
+  addDA(pDA, &(long){1});
+  snap = snapshotDA(pDA);
+  assert_null(snap->shared);
+  assert_int_equal(*(long *)getDA(snap, 0), 1);
+  freeDA(snap);
+  freeDA(pDA);
+}
+
 int test_array(void) {
   const struct CMUnitTest tests[] = {
       cmocka_unit_test_setup_teardown(test_new, setupDA, teardownDA),
@@ -527,15 +1331,33 @@ int test_array(void) {
       cmocka_unit_test_setup_teardown(test_memRelease, setupDA, teardownDA),
       cmocka_unit_test_setup_teardown(test_reverse, setupDA, teardownDA),
       cmocka_unit_test_setup_teardown(test_copy, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_view, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_typed, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_insertErase, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_emplace, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_clone, setupDA, teardownDA),
       cmocka_unit_test_setup_teardown(test_binSearch, setupDA, teardownDA),
       cmocka_unit_test_setup_teardown(test_subDA, setupDA, teardownDA),
       cmocka_unit_test_setup_teardown(test_appendDA, setupDA, teardownDA),
       cmocka_unit_test_setup_teardown(test_clearDA, setupDA, teardownDA),
       cmocka_unit_test_setup_teardown(test_forEach, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_forEachRange, setupDA, teardownDA),
       cmocka_unit_test_setup_teardown(test_new_params_mm, setupDA, teardownDA),
       cmocka_unit_test_setup_teardown(test_load_mm, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_arena, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_inlineStorage, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_reserveResize, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_hugePages, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_alignment, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_load_v1, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_checksum, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_wal, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_writeBack, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_snapshot, setupDA, teardownDA),
 #ifdef PERF
       cmocka_unit_test_setup_teardown(test_growing, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_typedAccess, setupDA, teardownDA),
+      cmocka_unit_test_setup_teardown(test_randomAccess, setupDA, teardownDA),
 #endif // PERF
   };
 
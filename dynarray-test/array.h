@@ -5,6 +5,8 @@
 
 DECLARE_COMPARE_TYPE(long)
 DECLARE_COMPARE_TYPE(float)
+DECLARE_TYPED_DA(long)
+DECLARE_TYPED_DA(float)
 
 int test_array(void);
 
@@ -0,0 +1,218 @@
+#include "column.h"
+#include "dynkernel.h"
+
+#include <setjmp.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <zcmocka.h>
+
+#define COLUMN_COUNT 1000
+#define COLUMN_FILENAME "columns.dat"
+
+typedef struct Trade {
+  int64_t id;
+  double price;
+  int32_t venue;
+  char symbol[8];
+} trade;
+
+int compareInt32(const void *a, const void *b) {
+  int32_t left = *(const int32_t *)a, right = *(const int32_t *)b;
+  return (left < right) ? -1 : (left > right) ? 1 : 0;
+}
+
+int compareDouble(const void *a, const void *b) {
+  double left = *(const double *)a, right = *(const double *)b;
+  return (left < right) ? -1 : (left > right) ? 1 : 0;
+}
+
+const dynColumn tradeFields[] = {
+    {offsetof(trade, id), sizeof(int64_t), NULL},
+    {offsetof(trade, price), sizeof(double), compareDouble},
+    {offsetof(trade, venue), sizeof(int32_t), compareInt32},
+    {offsetof(trade, symbol), 8, NULL},
+};
+
+dynColumns *pCols = NULL;
+
+trade makeTrade(int64_t i) {
+  trade t = (trade){.id = i, .price = (i * 7) % 13 + 0.5, .venue = i % 5};
+  snprintf(t.symbol, sizeof(t.symbol), "S%ld", (long)(i % 100));
+  return t;
+}
+
+bool sumRange(void *begin, size_t count, void *ref) {
+  for (size_t i = 0; i < count; i++) {
+    *(double *)ref += ((double *)begin)[i];
+  }
+  return true;
+}
+
+void test_columnRows(void **state) {
+  pCols = createColumnsDA(tradeFields, 4, sizeof(trade), NULL);
+  assert_int_equal(pCols->count, 4);
+
+  double total = 0;
+  for (int64_t i = 0; i < COLUMN_COUNT; i++) {
+    trade t = makeTrade(i);
+    assert_true(addRowDA(pCols, &t));
+    total += t.price;
+  }
+  assert_int_equal(pCols->size, COLUMN_COUNT);
+  for (size_t c = 0; c < pCols->count; c++) {
+    assert_int_equal(pCols->columns[c]->size, COLUMN_COUNT);
+    assert_int_equal(pCols->columns[c]->elementSize, tradeFields[c].size);
+  }
+
+  trade t, expected = makeTrade(123);
+  memset(&t, 0, sizeof(t));
+  assert_true(getRowDA(pCols, 123, &t));
+  assert_int_equal(t.id, 123);
+  assert_true(t.price == expected.price);
+  assert_int_equal(t.venue, expected.venue);
+  assert_string_equal(t.symbol, "S23");
+  assert_false(getRowDA(pCols, COLUMN_COUNT, &t));
+
+  expected.price = -1;
+  assert_true(setRowDA(pCols, 123, &expected));
+  assert_true(getRowDA(pCols, 123, &t));
+  assert_true(t.price == -1);
+  assert_false(setRowDA(pCols, COLUMN_COUNT, &expected));
+  total -= makeTrade(123).price + 1;
+
+  // a column scan only reads the prices
+  double scanned = 0;
+  assert_true(scanColumnDA(pCols, 1, sumRange, &scanned, 64));
+  assert_true(scanned == total);
+
+  double summed = 0;
+  assert_true(sumDA(pCols->columns[1], KernelDouble, &summed));
+  assert_true(summed == total);
+  assert_int_equal(countDA(pCols->columns[2], KernelInt32, &(int32_t){3}),
+                   COLUMN_COUNT / 5);
+
+  assert_true(reserveColumnsDA(pCols, COLUMN_COUNT * 2));
+  for (size_t c = 0; c < pCols->count; c++) {
+    assert_true(pCols->columns[c]->capacity >= COLUMN_COUNT * 2);
+  }
+
+  clearColumnsDA(pCols);
+  assert_int_equal(pCols->size, 0);
+  assert_int_equal(pCols->columns[3]->size, 0);
+}
+
+void test_columnSort(void **state) {
+  pCols = createColumnsDA(tradeFields, 4, sizeof(trade), NULL);
+  for (int64_t i = 0; i < COLUMN_COUNT; i++) {
+    trade t = makeTrade(i);
+    addRowDA(pCols, &t);
+  }
+
+  assert_null(sortPermutationDA(pCols, 0, NULL));
+
+  // equal venues keep their row order
+  dynArray *permutation = sortPermutationDA(pCols, 2, NULL);
+  assert_int_equal(permutation->size, COLUMN_COUNT);
+  size_t *rows = permutation->array;
+  for (size_t i = 1; i < COLUMN_COUNT; i++) {
+    int32_t before = *(int32_t *)getDA(pCols->columns[2], rows[i - 1]);
+    int32_t after = *(int32_t *)getDA(pCols->columns[2], rows[i]);
+    assert_true(before < after || (before == after && rows[i - 1] < rows[i]));
+  }
+
+  assert_true(permuteColumnsDA(pCols, permutation));
+  for (size_t i = 0; i < COLUMN_COUNT; i++) {
+    trade t, expected = makeTrade(rows[i]);
+    getRowDA(pCols, i, &t);
+    assert_int_equal(t.id, expected.id);
+    assert_int_equal(t.venue, expected.venue);
+    assert_string_equal(t.symbol, expected.symbol);
+  }
+  assert_int_equal(*(int32_t *)getDA(pCols->columns[2], 0), 0);
+  assert_int_equal(*(int64_t *)getDA(pCols->columns[0], 1), 5);
+
+  // a row twice is not a permutation
+  rows[0] = rows[1];
+  assert_false(permuteColumnsDA(pCols, permutation));
+  freeDA(permutation);
+
+  permutation = sortPermutationDA(pCols, 1, NULL);
+  assert_true(permuteColumnsDA(pCols, permutation));
+  freeDA(permutation);
+  for (size_t i = 1; i < COLUMN_COUNT; i++) {
+    assert_true(*(double *)getDA(pCols->columns[1], i - 1) <=
+                *(double *)getDA(pCols->columns[1], i));
+  }
+}
+
+void test_columnMMap(void **state) {
+  dynArrayParams params = (dynArrayParams){.filename = COLUMN_FILENAME};
+  pCols = createColumnsDA(tradeFields, 4, sizeof(trade), &params);
+  for (int64_t i = 0; i < COLUMN_COUNT; i++) {
+    trade t = makeTrade(i);
+    addRowDA(pCols, &t);
+  }
+  freeColumnsDA(pCols);
+
+  pCols = loadColumnsDA(COLUMN_FILENAME, tradeFields, 4, sizeof(trade));
+  assert_non_null(pCols);
+  assert_int_equal(pCols->size, COLUMN_COUNT);
+  trade t, expected = makeTrade(999);
+  getRowDA(pCols, 999, &t);
+  assert_int_equal(t.id, 999);
+  assert_true(t.price == expected.price);
+  assert_string_equal(t.symbol, "S99");
+  freeColumnsDA(pCols);
+  pCols = NULL;
+
+  // a row only reaching the first column, as in a crash, is dropped
+  dynArray *first = loadDA(COLUMN_FILENAME ".0", NULL);
+  addDA(first, &(int64_t){COLUMN_COUNT});
+  freeDA(first);
+  pCols = loadColumnsDA(COLUMN_FILENAME, tradeFields, 4, sizeof(trade));
+  assert_non_null(pCols);
+  assert_int_equal(pCols->size, COLUMN_COUNT);
+  for (int c = 0; c < 4; c++) {
+    assert_int_equal(pCols->columns[c]->size, COLUMN_COUNT);
+  }
+  freeColumnsDA(pCols);
+  pCols = NULL;
+
+  // the fields must match the column files
+  dynColumn wrong[] = {{0, sizeof(int32_t), NULL}};
+  assert_null(loadColumnsDA(COLUMN_FILENAME, wrong, 1, sizeof(int32_t)));
+  assert_null(loadColumnsDA("missing.dat", tradeFields, 4, sizeof(trade)));
+}
+
+int setupColumn(void **state) {
+  pCols = NULL;
+  return 0;
+}
+int teardownColumn(void **state) {
+  freeColumnsDA(pCols);
+  pCols = NULL;
+  char name[32];
+  for (int c = 0; c < 4; c++) {
+    snprintf(name, sizeof(name), COLUMN_FILENAME ".%d", c);
+    remove(name);
+  }
+
+  return 0;
+}
+
+int test_column(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test_setup_teardown(test_columnRows, setupColumn,
+                                      teardownColumn),
+      cmocka_unit_test_setup_teardown(test_columnSort, setupColumn,
+                                      teardownColumn),
+      cmocka_unit_test_setup_teardown(test_columnMMap, setupColumn,
+                                      teardownColumn),
+  };
+
+  int count_fail_tests = cmocka_run_group_tests(tests, NULL, NULL);
+
+  return count_fail_tests;
+}
@@ -0,0 +1,8 @@
+#ifndef COLUMN_H
+#define COLUMN_H
+
+#include "dyncolumn.h"
+
+int test_column(void);
+
+#endif
@@ -0,0 +1,181 @@
+#include "export.h"
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <zcmocka.h>
+
+#define FILENAME "mm.dat"
+
+dynArray *pDAExp = NULL;
+dynArray *pDAImp = NULL;
+FILE *stream = NULL;
+
+void assertSameDA(const dynArray *a, const dynArray *b) {
+  assert_int_equal(a->elementSize, b->elementSize);
+  assert_int_equal(a->size, b->size);
+  assert_int_equal(memcmp(a->array, b->array, a->size * a->elementSize), 0);
+}
+
+dynArray *roundTrip(const dynArrayCodec *codec, size_t threads,
+                    dynArrayParams *params) {
+  stream = tmpfile();
+  assert_true(exportDA(pDAExp, fileno(stream), codec, threads));
+  lseek(fileno(stream), 0, SEEK_SET);
+  dynArray *pDA = importDA(fileno(stream), NULL, params);
+  fclose(stream);
+  stream = NULL;
+  return pDA;
+}
+
+void test_exportRaw(void **state) {
+  pDAExp = createDA(sizeof(long), NULL, NULL);
+  for (long i = 0; i < 1000; i++) {
+    long value = i * i;
+    addDA(pDAExp, &value);
+  }
+
+  pDAImp = roundTrip(NULL, 1, NULL);
+  assert_non_null(pDAImp);
+  assertSameDA(pDAExp, pDAImp);
+}
+
+void test_exportLZ(void **state) {
+  pDAExp = createDA(sizeof(char), NULL, NULL);
+  char text[] = "the quick brown fox jumps over the lazy dog, ";
+  for (int i = 0; i < 100000; i++) {
+    addArrayDA(pDAExp, text, strlen(text));
+    addDA(pDAExp, &(char){'0' + i % 10});
+  }
+
+  stream = tmpfile();
+  assert_true(exportDA(pDAExp, fileno(stream), &CodecLZ, 4));
+  long length = lseek(fileno(stream), 0, SEEK_END);
+  assert_true(length < pDAExp->size / 4);
+  lseek(fileno(stream), 0, SEEK_SET);
+
+  pDAImp = importDA(fileno(stream), NULL, NULL);
+  assert_non_null(pDAImp);
+  assertSameDA(pDAExp, pDAImp);
+}
+
+void test_exportDelta(void **state) {
+  pDAExp = createDA(sizeof(int32_t), NULL, NULL);
+  for (int32_t i = 0; i < 1000000; i++) {
+    int32_t value = i * 3 - 500;
+    addDA(pDAExp, &value);
+  }
+
+  stream = tmpfile();
+  assert_true(exportDA(pDAExp, fileno(stream), &CodecDelta, 2));
+  long length = lseek(fileno(stream), 0, SEEK_END);
+  assert_true(length < pDAExp->size * 2);
+  lseek(fileno(stream), 0, SEEK_SET);
+
+  pDAImp = importDA(fileno(stream), NULL,
+                    &(dynArrayParams){.filename = FILENAME});
+  assert_non_null(pDAImp);
+  assert_true(pDAImp->fp != NULL);
+  assertSameDA(pDAExp, pDAImp);
+  freeDA(pDAImp);
+
+  pDAImp = loadDA(FILENAME, NULL);
+  assert_non_null(pDAImp);
+  assertSameDA(pDAExp, pDAImp);
+}
+
+void test_exportCorrupt(void **state) {
+  pDAExp = createDA(sizeof(long), NULL, NULL);
+  for (long i = 0; i < 1000; i++) {
+    addDA(pDAExp, &i);
+  }
+
+  stream = tmpfile();
+  assert_true(exportDA(pDAExp, fileno(stream), &CodecLZ, 1));
+  pwrite(fileno(stream), "x", 1, sizeof(fileHeader) + 100);
+  lseek(fileno(stream), 0, SEEK_SET);
+  assert_null(importDA(fileno(stream), NULL, NULL));
+
+  pwrite(fileno(stream), "x", 1, offsetof(fileHeader, size));
+  lseek(fileno(stream), 0, SEEK_SET);
+  assert_null(importDA(fileno(stream), NULL, NULL));
+}
+
+void dirtyStack(void) {
+  volatile char junk[4096];
+  for (size_t i = 0; i < sizeof(junk); i++) {
+    junk[i] = (char)(i * 7 + 1);
+  }
+}
+
+void test_exportStable(void **state) {
+  pDAExp = createDA(sizeof(long), NULL, NULL);
+  for (long i = 0; i < 1000; i++) {
+    addDA(pDAExp, &i);
+  }
+
+  FILE *first = tmpfile();
+  assert_true(exportDA(pDAExp, fileno(first), &CodecLZ, 1));
+  dirtyStack();
+  stream = tmpfile();
+  assert_true(exportDA(pDAExp, fileno(stream), &CodecLZ, 1));
+
+  long length = lseek(fileno(first), 0, SEEK_END);
+  assert_int_equal(lseek(fileno(stream), 0, SEEK_END), length);
+  char *a = malloc(length);
+  char *b = malloc(length);
+  assert_int_equal(pread(fileno(first), a, length, 0), length);
+  assert_int_equal(pread(fileno(stream), b, length, 0), length);
+  assert_int_equal(memcmp(a, b, length), 0);
+
+  // the header buffer of a heap array is empty
+  fileHeader header;
+  memcpy(&header, a, sizeof(fileHeader));
+  fileHeader empty = {0};
+  assert_int_equal(memcmp(header.buffer, empty.buffer, sizeof(header.buffer)),
+                   0);
+  free(a);
+  free(b);
+  fclose(first);
+}
+
+int setupExport(void **state) {
+  pDAExp = NULL;
+  pDAImp = NULL;
+  stream = NULL;
+  return 0;
+}
+
+int teardownExport(void **state) {
+  freeDA(pDAExp);
+  pDAExp = NULL;
+  freeDA(pDAImp);
+  pDAImp = NULL;
+  if (stream) {
+    fclose(stream);
+    stream = NULL;
+  }
+  remove(FILENAME);
+
+  return 0;
+}
+
+int test_export(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test_setup_teardown(test_exportRaw, setupExport,
+                                      teardownExport),
+      cmocka_unit_test_setup_teardown(test_exportLZ, setupExport,
+                                      teardownExport),
+      cmocka_unit_test_setup_teardown(test_exportDelta, setupExport,
+                                      teardownExport),
+      cmocka_unit_test_setup_teardown(test_exportCorrupt, setupExport,
+                                      teardownExport),
+      cmocka_unit_test_setup_teardown(test_exportStable, setupExport,
+                                      teardownExport),
+  };
+
+  int count_fail_tests = cmocka_run_group_tests(tests, NULL, NULL);
+
+  return count_fail_tests;
+}
@@ -0,0 +1,8 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include "dynexport.h"
+
+int test_export(void);
+
+#endif
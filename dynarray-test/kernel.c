@@ -0,0 +1,203 @@
+#include "kernel.h"
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <zcmocka.h>
+
+#define KERNEL_COUNT 1003
+
+dynArray *pDAKer = NULL;
+
+const dynKernelLevel levels[] = {KernelScalar, KernelSSE2, KernelAVX2};
+
+size_t countInt32(int32_t value) {
+  size_t count = 0;
+  for (size_t i = 0; i < pDAKer->size; i++) {
+    count += *(int32_t *)getDA(pDAKer, i) == value;
+  }
+  return count;
+}
+
+void test_kernelInt32(void **state) {
+  pDAKer = createDA(sizeof(int32_t), NULL, NULL);
+  for (int32_t i = 0; i < KERNEL_COUNT; i++) {
+    int32_t value = (i * 37) % 101 - 50;
+    addDA(pDAKer, &value);
+  }
+
+  for (int l = 0; l < 3; l++) {
+    kernelLevelDA(levels[l]);
+    assert_int_equal(findDA(pDAKer, KernelInt32, &(int32_t){-50}), 0);
+    assert_int_equal(findDA(pDAKer, KernelInt32, &(int32_t){-13}), 1);
+    assert_int_equal(findDA(pDAKer, KernelInt32, &(int32_t){51}), -1);
+    assert_int_equal(countDA(pDAKer, KernelInt32, &(int32_t){7}),
+                     countInt32(7));
+
+    int32_t min, max;
+    assert_true(minMaxDA(pDAKer, KernelInt32, &min, &max));
+    assert_int_equal(min, -50);
+    assert_int_equal(max, 50);
+
+    int64_t sum, expected = 0;
+    for (size_t i = 0; i < pDAKer->size; i++) {
+      expected += *(int32_t *)getDA(pDAKer, i);
+    }
+    assert_true(sumDA(pDAKer, KernelInt32, &sum));
+    assert_int_equal(sum, expected);
+  }
+
+  // the type must match the element size
+  assert_int_equal(findDA(pDAKer, KernelInt64, &(int64_t){0}), -1);
+  assert_false(sumDA(pDAKer, KernelDouble, &(double){0}));
+  kernelLevelDA(KernelAVX2);
+}
+
+void test_kernelInt64(void **state) {
+  pDAKer = createDA(sizeof(int64_t), NULL, NULL);
+  for (int64_t i = 0; i < KERNEL_COUNT; i++) {
+    // only the high half differs from the value searched for
+    int64_t value = (i % 3) * 0x100000000LL + 5;
+    addDA(pDAKer, &value);
+  }
+  int64_t large = INT64_MAX;
+  setDA(pDAKer, 1001, &large);
+
+  for (int l = 0; l < 3; l++) {
+    kernelLevelDA(levels[l]);
+    assert_int_equal(findDA(pDAKer, KernelInt64, &(int64_t){5}), 0);
+    assert_int_equal(findDA(pDAKer, KernelInt64, &large), 1001);
+    assert_int_equal(findDA(pDAKer, KernelInt64, &(int64_t){6}), -1);
+    assert_int_equal(countDA(pDAKer, KernelInt64, &(int64_t){5}), 335);
+
+    int64_t min, max;
+    assert_true(minMaxDA(pDAKer, KernelInt64, &min, &max));
+    assert_int_equal(min, 5);
+    assert_int_equal(max, INT64_MAX);
+
+    int64_t sum;
+    uint64_t expected = 0;
+    for (size_t i = 0; i < pDAKer->size; i++) {
+      expected += *(uint64_t *)getDA(pDAKer, i);
+    }
+    assert_true(sumDA(pDAKer, KernelInt64, &sum));
+    assert_int_equal(sum, (int64_t)expected);
+  }
+  kernelLevelDA(KernelAVX2);
+}
+
+void test_kernelFloat(void **state) {
+  pDAKer = createDA(sizeof(float), NULL, NULL);
+  for (int i = 0; i < KERNEL_COUNT; i++) {
+    float value = (float)(i % 17) - 8.5f;
+    addDA(pDAKer, &value);
+  }
+  setDA(pDAKer, 1002, &(float){-0.0f});
+
+  for (int l = 0; l < 3; l++) {
+    kernelLevelDA(levels[l]);
+    // zero compares equal to negative zero
+    assert_int_equal(findDA(pDAKer, KernelFloat, &(float){0.0f}), 1002);
+    assert_int_equal(countDA(pDAKer, KernelFloat, &(float){7.5f}), 58);
+
+    float min, max;
+    assert_true(minMaxDA(pDAKer, KernelFloat, &min, &max));
+    assert_true(min == -8.5f);
+    assert_true(max == 7.5f);
+
+    double sum, expected = 0;
+    for (size_t i = 0; i < pDAKer->size; i++) {
+      expected += *(float *)getDA(pDAKer, i);
+    }
+    assert_true(sumDA(pDAKer, KernelFloat, &sum));
+    assert_true(sum == expected);
+  }
+  kernelLevelDA(KernelAVX2);
+}
+
+void test_kernelDouble(void **state) {
+  pDAKer = createDA(sizeof(double), NULL, NULL);
+  for (int i = 0; i < KERNEL_COUNT; i++) {
+    double value = i * 0.25;
+    addDA(pDAKer, &value);
+  }
+
+  for (int l = 0; l < 3; l++) {
+    kernelLevelDA(levels[l]);
+    assert_int_equal(findDA(pDAKer, KernelDouble, &(double){250.5}), 1002);
+    assert_int_equal(countDA(pDAKer, KernelDouble, &(double){0.3}), 0);
+
+    double min, max;
+    assert_true(minMaxDA(pDAKer, KernelDouble, &min, &max));
+    assert_true(min == 0);
+    assert_true(max == 250.5);
+
+    double sum;
+    assert_true(sumDA(pDAKer, KernelDouble, &sum));
+    assert_true(sum == 0.25 * (KERNEL_COUNT - 1) * KERNEL_COUNT / 2);
+  }
+  kernelLevelDA(KernelAVX2);
+}
+
+void test_kernelFill(void **state) {
+  pDAKer = createDA(sizeof(int64_t), NULL, NULL);
+  for (int64_t i = 0; i < KERNEL_COUNT; i++) {
+    addDA(pDAKer, &i);
+  }
+
+  for (int l = 0; l < 3; l++) {
+    kernelLevelDA(levels[l]);
+    // only the sub array is changed
+    dynArray *sub = subDA(pDAKer, 100 - l, 900 + l);
+    assert_true(fillDA(sub, KernelInt64, &(int64_t){-l}));
+    assert_int_equal(countDA(sub, KernelInt64, &(int64_t){-l}), sub->size);
+
+    int64_t min, max;
+    assert_true(minMaxDA(sub, KernelInt64, &min, &max));
+    assert_int_equal(min, -l);
+    assert_int_equal(max, -l);
+    freeDA(sub);
+
+    assert_int_equal(*(int64_t *)getDA(pDAKer, 99 - l), 99 - l);
+    assert_int_equal(*(int64_t *)getDA(pDAKer, 100 - l), -l);
+    assert_int_equal(*(int64_t *)getDA(pDAKer, 900 + l), -l);
+    assert_int_equal(*(int64_t *)getDA(pDAKer, 901 + l), 901 + l);
+  }
+
+  int64_t min, max;
+  assert_false(minMaxDA(pDAKer, KernelInt32, &min, &max));
+  clearDA(pDAKer);
+  assert_false(minMaxDA(pDAKer, KernelInt64, &min, &max));
+  assert_int_equal(findDA(pDAKer, KernelInt64, &min), -1);
+  kernelLevelDA(KernelAVX2);
+}
+
+int setupKernel(void **state) {
+  pDAKer = NULL;
+  return 0;
+}
+int teardownKernel(void **state) {
+  freeDA(pDAKer);
+  pDAKer = NULL;
+
+  return 0;
+}
+
+int test_kernel(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test_setup_teardown(test_kernelInt32, setupKernel,
+                                      teardownKernel),
+      cmocka_unit_test_setup_teardown(test_kernelInt64, setupKernel,
+                                      teardownKernel),
+      cmocka_unit_test_setup_teardown(test_kernelFloat, setupKernel,
+                                      teardownKernel),
+      cmocka_unit_test_setup_teardown(test_kernelDouble, setupKernel,
+                                      teardownKernel),
+      cmocka_unit_test_setup_teardown(test_kernelFill, setupKernel,
+                                      teardownKernel),
+  };
+
+  int count_fail_tests = cmocka_run_group_tests(tests, NULL, NULL);
+
+  return count_fail_tests;
+}
@@ -0,0 +1,8 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include "dynkernel.h"
+
+int test_kernel(void);
+
+#endif
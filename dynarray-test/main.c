@@ -6,7 +6,9 @@
 
 int main(void) {
 
-  int count_fail_tests = test_array() + test_tree();
+  int count_fail_tests = test_array() + test_tree() + test_export() +
+                         test_kernel() + test_parallel() + test_wrapper() +
+                         test_column() + test_map();
 
   if (count_fail_tests == 0) {
     printf("****************\n  All good!! \n****************\n");
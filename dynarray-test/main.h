@@ -2,6 +2,12 @@
 #define MAIN_H
 
 #include "array.h"
+#include "column.h"
+#include "export.h"
+#include "kernel.h"
+#include "map.h"
+#include "parallel.h"
 #include "tree.h"
+#include "wrapper.h"
 
 #endif
\ No newline at end of file
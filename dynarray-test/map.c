@@ -0,0 +1,176 @@
+#include "map.h"
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zcmocka.h>
+
+#define MAP_COUNT 1000
+
+uint64_t mapKeys[MAP_COUNT];
+keyEntry mapEntries[MAP_COUNT];
+hashMap *pHM = NULL;
+
+int compareMapKey(const void *a, const void *b) {
+  uint64_t left = *(const uint64_t *)a, right = *(const uint64_t *)b;
+  return (left < right) ? -1 : (left > right) ? 1 : 0;
+}
+
+size_t mapDeleted = 0;
+
+void mapCallback(const hashMap *pHM, const keyEntry *kEntry, void *value,
+                 void *ref) {
+  assert_ptr_equal(kEntry->key, value);
+  mapDeleted++;
+}
+
+bool countNode(const hashMapNode *node, void *ref) {
+  (*(size_t *)ref)++;
+  return true;
+}
+
+void test_mapEntries(void **state) {
+  assert_null(getHM(pHM, &mapEntries[0]));
+  assert_false(deleteHM(pHM, &mapEntries[0]));
+
+  for (int i = 0; i < MAP_COUNT; i++) {
+    setHM(pHM, &mapEntries[i], &mapKeys[i]);
+  }
+  setHM(pHM, &mapEntries[1], NULL);
+  assert_int_equal(sizeHM(pHM), MAP_COUNT);
+  assert_null(getHM(pHM, &mapEntries[1])->value);
+  setHM(pHM, &mapEntries[1], &mapKeys[1]);
+
+  mapDeleted = 0;
+  for (int i = 0; i < MAP_COUNT; i += 2) {
+    assert_true(deleteCallbackHM(pHM, &mapEntries[i], mapCallback, NULL));
+    assert_false(deleteCallbackHM(pHM, &mapEntries[i], mapCallback, NULL));
+  }
+  assert_int_equal(mapDeleted, MAP_COUNT / 2);
+  assert_int_equal(sizeHM(pHM), MAP_COUNT / 2);
+  for (int i = 0; i < MAP_COUNT; i++) {
+    assert_true(hasEntryHM(pHM, &mapEntries[i]) == (i % 2 != 0));
+  }
+
+  // deleted nodes are reused
+  size_t nodes = pHM->nodes->size;
+  for (int i = 0; i < MAP_COUNT; i += 2) {
+    setHM(pHM, &mapEntries[i], &mapKeys[i]);
+  }
+  assert_int_equal(pHM->nodes->size, nodes);
+  size_t visited = 0;
+  visitHM(pHM, countNode, &visited);
+  assert_int_equal(visited, MAP_COUNT);
+
+  clearHM(pHM);
+  assert_int_equal(sizeHM(pHM), 0);
+  assert_false(hasEntryHM(pHM, &mapEntries[3]));
+  setHM(pHM, &mapEntries[3], &mapKeys[3]);
+  assert_ptr_equal(getHM(pHM, &mapEntries[3])->value, &mapKeys[3]);
+}
+
+void test_mapResize(void **state) {
+  freeHM(pHM);
+  pHM = createHM(compareMapKey, &(hashMapParams){.capacity = 4,
+                                                 .loadFactor = 1.0,
+                                                 .migrate = 1});
+  size_t resizing = 0;
+
+  for (int i = 0; i < MAP_COUNT; i++) {
+    setHM(pHM, &mapEntries[i], &mapKeys[i]);
+    resizing += pHM->old != NULL;
+
+    // every key is found part way through a resize, leaving the last one
+    if (pHM->old != NULL && pHM->migrated > 0 && i % 10 == 0 &&
+        i < MAP_COUNT / 2) {
+      for (int j = 0; j <= i; j++) {
+        assert_ptr_equal(getHM(pHM, &mapEntries[j])->value, &mapKeys[j]);
+      }
+    }
+  }
+  assert_true(resizing > 0);
+  assert_int_equal(pHM->buckets->size, 1024);
+
+  // deletes reach keys in either table
+  assert_non_null(pHM->old);
+  for (int i = 0; i < MAP_COUNT; i += 3) {
+    assert_true(deleteHM(pHM, &mapEntries[i]));
+  }
+
+  assert_false(rehashHM(pHM, SIZE_MAX));
+  assert_null(pHM->old);
+  assert_false(rehashHM(pHM, 1));
+  for (int i = 0; i < MAP_COUNT; i++) {
+    assert_true(hasEntryHM(pHM, &mapEntries[i]) == (i % 3 != 0));
+  }
+}
+
+void test_mapLatency(void **state) {
+  size_t max = 4000000;
+  uint64_t *numbers = calloc(max, sizeof(uint64_t));
+  keyEntry *entries = calloc(max, sizeof(keyEntry));
+
+  for (size_t i = 0; i < max; i++) {
+    numbers[i] = i;
+    entries[i] = (keyEntry){.key = &numbers[i], .length = sizeof(uint64_t)};
+  }
+
+  // moving every bucket at once is the stop the world resize
+  size_t migrate[] = {SIZE_MAX, 4};
+  for (int m = 0; m < 2; m++) {
+    hashMap *pMap =
+        createHM(compareMapKey, &(hashMapParams){.migrate = migrate[m]});
+    double slowest = 0;
+    clock_t start_t = clock();
+    for (size_t i = 0; i < max; i++) {
+      struct timespec before, after;
+      clock_gettime(CLOCK_MONOTONIC, &before);
+      setHM(pMap, &entries[i], NULL);
+      clock_gettime(CLOCK_MONOTONIC, &after);
+      double took = (after.tv_sec - before.tv_sec) +
+                    (after.tv_nsec - before.tv_nsec) / 1e9;
+      slowest = (took > slowest) ? took : slowest;
+    }
+    printf("%s resize sets:%lu\tSlowest(sec): %f\tCPU Time(sec): %f\n",
+           m ? "Incremental" : "Full", max, slowest,
+           (double)(clock() - start_t) / CLOCKS_PER_SEC);
+    assert_int_equal(sizeHM(pMap), max);
+    freeHM(pMap);
+  }
+
+  free(entries);
+  free(numbers);
+}
+
+int setupHM(void **state) {
+  pHM = createHM(compareMapKey, NULL);
+  for (int i = 0; i < MAP_COUNT; i++) {
+    mapKeys[i] = i * 7919;
+    mapEntries[i] =
+        (keyEntry){.key = &mapKeys[i], .length = sizeof(uint64_t)};
+  }
+  return 0;
+}
+
+int teardownHM(void **state) {
+  freeHM(pHM);
+  pHM = NULL;
+  return 0;
+}
+
+int test_map(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test_setup_teardown(test_mapEntries, setupHM, teardownHM),
+      cmocka_unit_test_setup_teardown(test_mapResize, setupHM, teardownHM),
+#ifdef PERF
+      cmocka_unit_test_setup_teardown(test_mapLatency, setupHM, teardownHM),
+#endif // PERF
+  };
+
+  int count_fail_tests = cmocka_run_group_tests(tests, NULL, NULL);
+
+  return count_fail_tests;
+}
@@ -0,0 +1,8 @@
+#ifndef MAP_H
+#define MAP_H
+
+#include "dynhashmap.h"
+
+int test_map(void);
+
+#endif
@@ -0,0 +1,144 @@
+#include "parallel.h"
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <zcmocka.h>
+
+#define PARALLEL_COUNT 1000003
+
+dynArray *pDAPar = NULL;
+
+bool addEntry(void *entry, void *ref) {
+  __atomic_add_fetch((long *)ref, *(long *)entry, __ATOMIC_RELAXED);
+  return true;
+}
+
+bool negateEntry(void *entry, void *ref) {
+  *(long *)entry = -*(long *)entry;
+  return true;
+}
+
+bool stopAtEntry(void *entry, void *ref) {
+  return *(long *)entry != *(long *)ref;
+}
+
+bool nestedEntry(void *entry, void *ref) {
+  // runs on the calling thread
+  if (*(long *)entry % 100000 == 0) {
+    long total = 0;
+    dynArray *sub = subDA(pDAPar, 0, 99);
+    parallelForEachDA(sub, addEntry, &total, 4);
+    freeDA(sub);
+    __atomic_add_fetch((long *)ref, total, __ATOMIC_RELAXED);
+  }
+  return true;
+}
+
+typedef struct Stats {
+  long sum;
+  long min;
+  long count;
+} stats;
+
+void mapStats(void *result, const void *entry) {
+  stats *pStats = result;
+  long value = *(const long *)entry;
+  pStats->sum += value;
+  pStats->min = (value < pStats->min) ? value : pStats->min;
+  pStats->count++;
+}
+
+void combineStats(void *result, const void *other) {
+  stats *pStats = result;
+  const stats *pOther = other;
+  pStats->sum += pOther->sum;
+  pStats->min = (pOther->min < pStats->min) ? pOther->min : pStats->min;
+  pStats->count += pOther->count;
+}
+
+void fillParallel(void) {
+  pDAPar = createDA(sizeof(long), NULL,
+                    &(dynArrayParams){.capacity = PARALLEL_COUNT});
+  for (long i = 0; i < PARALLEL_COUNT; i++) {
+    addDA(pDAPar, &i);
+  }
+}
+
+void test_parallelForEach(void **state) {
+  fillParallel();
+  long expected = (long)(PARALLEL_COUNT - 1) * PARALLEL_COUNT / 2;
+
+  for (size_t threads = 0; threads < 6; threads++) {
+    long total = 0;
+    assert_true(parallelForEachDA(pDAPar, addEntry, &total, threads));
+    assert_int_equal(total, expected);
+  }
+
+  // every entry is visited once
+  assert_true(parallelForEachDA(pDAPar, negateEntry, NULL, 4));
+  for (long i = 0; i < PARALLEL_COUNT; i += 997) {
+    assert_int_equal(*(long *)getDA(pDAPar, i), -i);
+  }
+  assert_true(parallelForEachDA(pDAPar, negateEntry, NULL, 4));
+
+  long stopAt = 500000;
+  assert_false(parallelForEachDA(pDAPar, stopAtEntry, &stopAt, 4));
+
+  long nested = 0;
+  assert_true(parallelForEachDA(pDAPar, nestedEntry, &nested, 4));
+  assert_int_equal(nested, 11 * 4950);
+}
+
+void test_parallelReduce(void **state) {
+  fillParallel();
+  setDA(pDAPar, 123456, &(long){-9});
+
+  stats result;
+  for (size_t threads = 0; threads < 8; threads += 3) {
+    result = (stats){.sum = 0, .min = INT64_MAX, .count = 0};
+    reduceDA(pDAPar, mapStats, combineStats, &result, sizeof(stats), threads);
+    assert_int_equal(result.count, PARALLEL_COUNT);
+    assert_int_equal(result.min, -9);
+    assert_int_equal(result.sum,
+                     (long)(PARALLEL_COUNT - 1) * PARALLEL_COUNT / 2 - 123465);
+  }
+
+  dynArray *sub = subDA(pDAPar, 10, 19);
+  result = (stats){.sum = 0, .min = INT64_MAX, .count = 0};
+  reduceDA(sub, mapStats, combineStats, &result, sizeof(stats), 4);
+  assert_int_equal(result.count, 10);
+  assert_int_equal(result.sum, 145);
+  assert_int_equal(result.min, 10);
+  freeDA(sub);
+
+  clearDA(pDAPar);
+  result = (stats){.sum = 0, .min = INT64_MAX, .count = 0};
+  reduceDA(pDAPar, mapStats, combineStats, &result, sizeof(stats), 4);
+  assert_int_equal(result.count, 0);
+  assert_int_equal(result.min, INT64_MAX);
+}
+
+int setupParallel(void **state) {
+  pDAPar = NULL;
+  return 0;
+}
+int teardownParallel(void **state) {
+  freeDA(pDAPar);
+  pDAPar = NULL;
+
+  return 0;
+}
+
+int test_parallel(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test_setup_teardown(test_parallelForEach, setupParallel,
+                                      teardownParallel),
+      cmocka_unit_test_setup_teardown(test_parallelReduce, setupParallel,
+                                      teardownParallel),
+  };
+
+  int count_fail_tests = cmocka_run_group_tests(tests, NULL, NULL);
+
+  return count_fail_tests;
+}
@@ -0,0 +1,8 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "dynparallel.h"
+
+int test_parallel(void);
+
+#endif
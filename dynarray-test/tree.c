@@ -3,7 +3,9 @@
 #include <setjmp.h>
 #include <stdint.h>
 #include <string.h>
+#include <sys/wait.h>
 #include <time.h>
+#include <unistd.h>
 #include <zcmocka.h>
 
 #define COUNT 10
@@ -532,6 +534,615 @@ void test_mmap(void **state) {
   }
 }
 
+void test_snapshotTree(void **state) {
+  hashTreeParams params = (hashTreeParams){.snapshots = true};
+  freeHT(pHT);
+  pHT = createHT(compareString, &params);
+
+  for (int i = 0; i < count / 2; i++) {
+    setHT(pHT, &kEntry[i], values[i]);
+  }
+
+  pMMHT = snapshotHT(pHT);
+  for (int i = count / 2; i < count; i++) {
+    setHT(pHT, &kEntry[i], values[i]);
+  }
+  deleteHT(pHT, &kEntry[0]);
+
+  for (int i = 0; i < count; i++) {
+    assert_int_equal(hasEntryHT(pMMHT, &kEntry[i]), i < count / 2);
+    assert_int_equal(hasEntryHT(pHT, &kEntry[i]), i != 0);
+  }
+}
+
+void test_walMMap(void **state) {
+
+  // build the tree in a child process that exits without freeing
+  pid_t pid = fork();
+  if (pid == 0) {
+    hashTreeParams params =
+        (hashTreeParams){.filename = FILENAME, .walBatch = 3};
+    hashTree *pTree = createHT(compareString, &params);
+
+    for (int i = 0; i < count; i++) {
+      setHT(pTree, &kEntry[i], values[i]);
+    }
+    balanceHT(pTree);
+    commitDA(pTree->da);
+    deleteHT(pTree, &kEntry[0]);
+    _exit(0);
+  }
+  waitpid(pid, NULL, 0);
+
+  pMMHT = loadHT(FILENAME, compareString);
+  assert_non_null(pMMHT);
+  assert_int_equal(pMMHT->root, 4);
+
+  for (int i = 0; i < count; i++) {
+    assert_true(hasEntryHT(pMMHT, &kEntry[i]));
+  }
+
+  deleteHT(pMMHT, &kEntry[0]);
+  freeHT(pMMHT);
+
+  pMMHT = loadHT(FILENAME, compareString);
+  assert_false(hasEntryHT(pMMHT, &kEntry[0]));
+  for (int i = 1; i < count; i++) {
+    assert_true(hasEntryHT(pMMHT, &kEntry[i]));
+  }
+}
+
+#define COMPACT_COUNT 1000
+
+bool collectEntry(const hashEntry *entry, const size_t entryIndex,
+                  void *ref) {
+  size_t fields[] = {entryIndex,   entry->hash,  entry->parent,
+                     entry->left,  entry->right, (size_t)entry->kEntry,
+                     (size_t)entry->value};
+  addArrayDA(ref, fields, 7);
+  return true;
+}
+
+void test_compact(void **state) {
+  static char compactKeys[COMPACT_COUNT][BUFFER];
+  static keyEntry compactEntries[COMPACT_COUNT];
+  hashTreeParams params = (hashTreeParams){.compact = true};
+  freeHT(pOther);
+  pOther = createHT(compareString, &params);
+
+  assert_int_equal(sizeof(hashNode), 12);
+  assert_int_equal(pOther->da->elementSize, sizeof(hashNode));
+  assert_non_null(pOther->cold);
+
+  for (int i = 0; i < COMPACT_COUNT; i++) {
+    snprintf(compactKeys[i], BUFFER, "Compact %d", i);
+    compactEntries[i] = (keyEntry){.key = compactKeys[i],
+                                   .length = strlen(compactKeys[i])};
+    setHT(pHT, &compactEntries[i], compactKeys[i]);
+    setHT(pOther, &compactEntries[i], compactKeys[i]);
+  }
+  for (int i = 0; i < COMPACT_COUNT; i += 3) {
+    deleteHT(pHT, &compactEntries[i]);
+    deleteHT(pOther, &compactEntries[i]);
+  }
+  balanceHT(pHT);
+  balanceHT(pOther);
+  setHT(pOther, &compactEntries[1], values[0]);
+  setHT(pHT, &compactEntries[1], values[0]);
+
+  // both layouts build the same tree
+  assert_int_equal(pOther->da->size, pHT->da->size);
+  assert_int_equal(pOther->cold->size, pHT->da->size);
+  assert_int_equal(pOther->root, pHT->root);
+  dynArray *wide = createDA(sizeof(size_t), NULL, NULL);
+  dynArray *compact = createDA(sizeof(size_t), NULL, NULL);
+  visitNodesHT(pHT, collectEntry, wide);
+  visitNodesHT(pOther, collectEntry, compact);
+  assert_int_equal(compact->size, wide->size);
+  assert_memory_equal(compact->array, wide->array,
+                      wide->size * sizeof(size_t));
+  freeDA(wide);
+  freeDA(compact);
+
+  for (int i = 0; i < COMPACT_COUNT; i++) {
+    assert_true(hasEntryHT(pOther, &compactEntries[i]) == (i % 3 != 0));
+  }
+  assert_ptr_equal(getHT(pOther, &compactEntries[1])->value, values[0]);
+  assert_ptr_equal(getHT(pOther, &compactEntries[2])->value, compactKeys[2]);
+  assert_null(getHT(pOther, &compactEntries[3]));
+
+  hashTree *copy = copyHT(pOther);
+  clearHT(pOther);
+  assert_int_equal(pOther->cold->size, 0);
+  assert_false(hasEntryHT(pOther, &compactEntries[2]));
+  assert_true(hasEntryHT(copy, &compactEntries[2]));
+  freeHT(copy);
+}
+
+void test_compactMMap(void **state) {
+  hashTreeParams params =
+      (hashTreeParams){.filename = FILENAME, .compact = true};
+  pMMHT = createHT(compareString, &params);
+
+  for (int i = 0; i < count; i++) {
+    setHT(pMMHT, &kEntry[i], values[i]);
+  }
+  balanceHT(pMMHT);
+  freeHT(pMMHT);
+
+  pMMHT = loadHT(FILENAME, compareString);
+  assert_non_null(pMMHT);
+  assert_non_null(pMMHT->cold);
+  assert_int_equal(pMMHT->root, 4);
+  for (int i = 0; i < count; i++) {
+    assert_ptr_equal(getHT(pMMHT, &kEntry[i])->value, values[i]);
+  }
+  freeHT(pMMHT);
+
+  // the node data file is required
+  remove(FILENAME HT_COLD_SUFFIX);
+  pMMHT = loadHT(FILENAME, compareString);
+  assert_null(pMMHT);
+}
+
+bool checkOrder(const hashEntry *entry, const size_t entryIndex, void *ref) {
+  hashEntry **last = ref;
+  if (*last != NULL) {
+    assert_true((*last)->hash < entry->hash ||
+                ((*last)->hash == entry->hash &&
+                 compareString((*last)->kEntry->key, entry->kEntry->key) < 0));
+  }
+  // the visited entry is a gathered copy, so keep a copy of it
+  memcpy(last[1], entry, sizeof(hashEntry));
+  *last = last[1];
+  return true;
+}
+
+size_t btreeDeleted = 0;
+
+void btreeCallback(const hashTree *pHT, const keyEntry *kEntry, void *value,
+                   void *ref) {
+  assert_ptr_equal(kEntry->key, value);
+  btreeDeleted++;
+}
+
+void test_btree(void **state) {
+  static char btreeKeys[COMPACT_COUNT][BUFFER];
+  static keyEntry btreeEntries[COMPACT_COUNT];
+  hashTreeParams params = (hashTreeParams){.btree = true};
+  freeHT(pOther);
+  pOther = createHT(compareString, &params);
+
+  assert_int_equal(sizeof(hashPage), 384);
+  assert_int_equal(pOther->da->elementSize, sizeof(hashPage));
+  assert_null(getHT(pOther, &kEntry[0]));
+  deleteHT(pOther, &kEntry[0]);
+
+  for (int i = 0; i < COMPACT_COUNT; i++) {
+    snprintf(btreeKeys[i], BUFFER, "BTree %d", i);
+    btreeEntries[i] =
+        (keyEntry){.key = btreeKeys[i], .length = strlen(btreeKeys[i])};
+    setHT(pHT, &btreeEntries[i], btreeKeys[i]);
+    setHT(pOther, &btreeEntries[i], btreeKeys[i]);
+  }
+  setHT(pOther, &btreeEntries[1], btreeKeys[1]);
+  assert_int_equal(sizeHT(pOther), COMPACT_COUNT);
+  assert_int_equal(maxDepthHT(pOther, pOther->root), 3);
+
+  btreeDeleted = 0;
+  for (int i = 0; i < COMPACT_COUNT; i += 3) {
+    deleteHT(pHT, &btreeEntries[i]);
+    deleteCallbackHT(pOther, &btreeEntries[i], btreeCallback, NULL);
+    deleteCallbackHT(pOther, &btreeEntries[i], btreeCallback, NULL);
+  }
+  assert_int_equal(btreeDeleted, (COMPACT_COUNT + 2) / 3);
+
+  // both layouts hold the same entries, the B-tree in order
+  assert_int_equal(sizeHT(pOther), sizeHT(pHT));
+  assert_true(hasAllHT(pOther, pHT));
+  assert_true(hasAllHT(pHT, pOther));
+  hashEntry previous = (hashEntry){.hash = 0};
+  hashEntry *order[] = {NULL, &previous};
+  visitNodesHT(pOther, checkOrder, order);
+  for (int i = 0; i < COMPACT_COUNT; i++) {
+    assert_true(hasEntryHT(pOther, &btreeEntries[i]) == (i % 3 != 0));
+  }
+  assert_ptr_equal(getHT(pOther, &btreeEntries[2])->value, btreeKeys[2]);
+  assert_null(getHT(pOther, &btreeEntries[3]));
+
+  // freed pages are reused
+  size_t pages = pOther->da->size;
+  for (int i = 0; i < COMPACT_COUNT; i += 3) {
+    setHT(pOther, &btreeEntries[i], btreeKeys[i]);
+  }
+  assert_int_equal(sizeHT(pOther), COMPACT_COUNT);
+  assert_true(pOther->da->size <= pages + 1);
+
+  hashTree *copy = copyHT(pOther);
+  retainAllHT(pOther, pHT);
+  assert_int_equal(sizeHT(pOther), sizeHT(pHT));
+  setAllHT(pOther, copy);
+  assert_true(hasAllHT(pOther, copy));
+
+  for (int i = COMPACT_COUNT - 1; i >= 0; i--) {
+    deleteHT(pOther, &btreeEntries[(i * 7) % COMPACT_COUNT]);
+  }
+  assert_int_equal(sizeHT(pOther), 0);
+  assert_int_equal(pOther->root, -1);
+  assert_int_equal(sizeHT(copy), COMPACT_COUNT);
+
+  clearHT(copy);
+  assert_false(hasEntryHT(copy, &btreeEntries[2]));
+  assert_int_equal(sizeHT(copy), 0);
+  freeHT(copy);
+}
+
+void test_btreeMMap(void **state) {
+  static char mmapKeys[COMPACT_COUNT][BUFFER];
+  static keyEntry mmapEntries[COMPACT_COUNT];
+  hashTreeParams params = (hashTreeParams){
+      .filename = FILENAME, .walBatch = 1, .btree = true};
+  pMMHT = createHT(compareString, &params);
+
+  for (int i = 0; i < COMPACT_COUNT; i++) {
+    snprintf(mmapKeys[i], BUFFER, "MMap %d", i);
+    mmapEntries[i] =
+        (keyEntry){.key = mmapKeys[i], .length = strlen(mmapKeys[i])};
+    setHT(pMMHT, &mmapEntries[i], NULL);
+  }
+  for (int i = 0; i < COMPACT_COUNT; i += 2) {
+    deleteHT(pMMHT, &mmapEntries[i]);
+  }
+  size_t root = pMMHT->root, freePage = pMMHT->freePage;
+  freeHT(pMMHT);
+
+  // the root, free pages and count are restored
+  pMMHT = loadHT(FILENAME, compareString);
+  assert_non_null(pMMHT);
+  assert_int_equal(pMMHT->da->elementSize, sizeof(hashPage));
+  assert_int_equal(pMMHT->root, root);
+  assert_int_equal(pMMHT->freePage, freePage);
+  assert_int_equal(sizeHT(pMMHT), COMPACT_COUNT / 2);
+  for (int i = 0; i < COMPACT_COUNT; i++) {
+    assert_true(hasEntryHT(pMMHT, &mmapEntries[i]) == (i % 2 != 0));
+  }
+}
+
+bool collectKey(const hashEntry *entry, const size_t entryIndex, void *ref) {
+  addDA(ref, &entry->kEntry->key);
+  return ((dynArray *)ref)->size < 5;
+}
+
+void test_ordered(void **state) {
+  static char orderedKeys[COMPACT_COUNT][BUFFER];
+  static keyEntry orderedEntries[COMPACT_COUNT];
+  hashTreeParams params =
+      (hashTreeParams){.filename = FILENAME, .ordered = true};
+  pMMHT = createHT(compareString, &params);
+
+  assert_null(firstHT(pMMHT));
+  assert_null(lastHT(pMMHT));
+  for (int i = 0; i < COMPACT_COUNT; i++) {
+    // even keys only, added out of order
+    int key = ((i * 7) % COMPACT_COUNT) * 2;
+    snprintf(orderedKeys[i], BUFFER, "Key %04d", key);
+    orderedEntries[i] =
+        (keyEntry){.key = orderedKeys[i], .length = strlen(orderedKeys[i])};
+    setHT(pMMHT, &orderedEntries[i], orderedKeys[i]);
+  }
+  freeHT(pMMHT);
+  pMMHT = loadHT(FILENAME, compareString);
+  assert_true(pMMHT->ordered);
+
+  assert_string_equal(firstHT(pMMHT)->kEntry->key, "Key 0000");
+  assert_string_equal(lastHT(pMMHT)->kEntry->key, "Key 1998");
+
+  // a cursor seeks to the next key and walks in key order
+  hashCursor cursor;
+  keyEntry lo = (keyEntry){.key = "Key 0101", .length = 8};
+  keyEntry hi = (keyEntry){.key = "Key 0108", .length = 8};
+  assert_true(seekHT(&cursor, pMMHT, &lo));
+  int expected = 102;
+  for (hashEntry *entry; (entry = nextHT(&cursor)) != NULL; expected += 2) {
+    char key[BUFFER];
+    snprintf(key, BUFFER, "Key %04d", expected);
+    assert_string_equal(entry->kEntry->key, key);
+    assert_ptr_equal(entry->value, entry->kEntry->key);
+  }
+  assert_int_equal(expected, 2000);
+
+  dynArray *found = createDA(sizeof(char *), NULL, NULL);
+  assert_true(rangeHT(pMMHT, &lo, &hi, collectKey, found));
+  assert_int_equal(found->size, 4);
+  assert_string_equal(*(char **)getDA(found, 0), "Key 0102");
+  assert_string_equal(*(char **)getDA(found, 3), "Key 0108");
+
+  // the visitor stops at five keys
+  clearDA(found);
+  assert_false(rangeHT(pMMHT, NULL, NULL, collectKey, found));
+  assert_string_equal(*(char **)getDA(found, 4), "Key 0008");
+
+  // deleted keys leave the range
+  clearDA(found);
+  deleteHT(pMMHT, &(keyEntry){.key = "Key 1994", .length = 8});
+  lo = (keyEntry){.key = "Key 1990", .length = 8};
+  assert_true(rangeHT(pMMHT, &lo, NULL, collectKey, found));
+  assert_int_equal(found->size, 4);
+  assert_string_equal(*(char **)getDA(found, 2), "Key 1996");
+  assert_true(seekHT(&cursor, pMMHT, &(keyEntry){.key = "Key 2", .length = 5}));
+  assert_null(nextHT(&cursor));
+  freeDA(found);
+
+  // unordered trees have no ranges or cursors
+  assert_false(rangeHT(pHT, NULL, NULL, collectKey, NULL));
+  assert_false(seekHT(&cursor, pHT, NULL));
+}
+
+void evictedCallback(const hashTree *pHT, const keyEntry *kEntry, void *value,
+                     void *ref) {
+  addDA(ref, &value);
+}
+
+void test_cache(void **state) {
+  static char cacheKeys[COMPACT_COUNT][BUFFER];
+  static keyEntry cacheEntries[COMPACT_COUNT];
+  dynArray *evicted = createDA(sizeof(char *), NULL, NULL);
+  hashTreeParams params = (hashTreeParams){.maxEntries = 100,
+                                           .evicted = evictedCallback,
+                                           .evictedRef = evicted};
+  freeHT(pOther);
+  pOther = createHT(compareString, &params);
+
+  for (int i = 0; i < COMPACT_COUNT; i++) {
+    snprintf(cacheKeys[i], BUFFER, "Cache %03d", i);
+    cacheEntries[i] =
+        (keyEntry){.key = cacheKeys[i], .length = strlen(cacheKeys[i])};
+  }
+  for (int i = 0; i < 100; i++) {
+    setHT(pOther, &cacheEntries[i], cacheKeys[i]);
+  }
+  assert_int_equal(evicted->size, 0);
+  assert_int_equal(pOther->bytes, 100 * 9);
+
+  // the keys looked up are spared, the others evicted in turn
+  for (int i = 0; i < 50; i++) {
+    assert_non_null(getHT(pOther, &cacheEntries[i]));
+  }
+  for (int i = 100; i < 150; i++) {
+    setHT(pOther, &cacheEntries[i], cacheKeys[i]);
+  }
+  assert_int_equal(pOther->da->size, 100);
+  assert_int_equal(evicted->size, 50);
+  for (int i = 0; i < 50; i++) {
+    assert_ptr_equal(*(char **)getDA(evicted, i), cacheKeys[50 + i]);
+  }
+  for (int i = 0; i < 150; i++) {
+    assert_true(hasEntryHT(pOther, &cacheEntries[i]) == (i < 50 || i >= 100));
+  }
+
+  // the bytes follow replaced and deleted entries
+  hashTree *copy = copyHT(pOther);
+  setSizedHT(pOther, &cacheEntries[0], cacheKeys[0], 109);
+  assert_int_equal(pOther->bytes, 100 * 9 + 100);
+  deleteHT(pOther, &cacheEntries[0]);
+  assert_int_equal(pOther->bytes, 99 * 9);
+  assert_int_equal(copy->bytes, 100 * 9);
+  freeHT(copy);
+  clearHT(pOther);
+  assert_int_equal(pOther->bytes, 0);
+
+  // a byte budget evicts until the new entry fits
+  clearDA(evicted);
+  params = (hashTreeParams){.maxBytes = 1000,
+                            .compact = true,
+                            .evicted = evictedCallback,
+                            .evictedRef = evicted};
+  freeHT(pOther);
+  pOther = createHT(compareString, &params);
+  for (int i = 0; i < COMPACT_COUNT; i++) {
+    setSizedHT(pOther, &cacheEntries[i], cacheKeys[i], 10 + (i % 7) * 20);
+    assert_true(pOther->bytes <= 1000);
+    if (i % 3 == 0) {
+      getHT(pOther, &cacheEntries[i]);
+    }
+  }
+  assert_int_equal(sizeHT(pOther) + evicted->size, COMPACT_COUNT);
+  assert_true(hasEntryHT(pOther, &cacheEntries[COMPACT_COUNT - 1]));
+  freeDA(evicted);
+
+  // B-trees are not bounded
+  hashTree *btree = createHT(compareString, &(hashTreeParams){
+                                                .btree = true,
+                                                .maxEntries = 1});
+  assert_null(btree->cache);
+  freeHT(btree);
+}
+
+void freedCallback(const hashTree *pHT, const keyEntry *kEntry, void *value,
+                   void *ref) {
+  (*(int *)ref)++;
+  free((void *)kEntry->key);
+  free((void *)kEntry);
+}
+
+void test_deleteFreeKey(void **state) {
+  const hashTreeParams layouts[] = {(hashTreeParams){0},
+                                    (hashTreeParams){.compact = true},
+                                    (hashTreeParams){.btree = true},
+                                    (hashTreeParams){.ordered = true}};
+
+  // the callback may free the key, as the entry has left the tree
+  for (int layout = 0; layout < 4; layout++) {
+    hashTreeParams params = layouts[layout];
+    hashTree *pTree = createHT(compareString, &params);
+    keyEntry *added[COMPACT_COUNT];
+    for (int i = 0; i < COMPACT_COUNT; i++) {
+      char *key = malloc(BUFFER);
+      snprintf(key, BUFFER, "Freed %03d", i);
+      added[i] = malloc(sizeof(keyEntry));
+      *added[i] = (keyEntry){.key = key, .length = strlen(key)};
+      setHT(pTree, added[i], NULL);
+    }
+
+    int freed = 0;
+    for (int i = 0; i < COMPACT_COUNT; i++) {
+      deleteCallbackHT(pTree, added[(i * 7) % COMPACT_COUNT], freedCallback,
+                       &freed);
+    }
+    assert_int_equal(freed, COMPACT_COUNT);
+    assert_int_equal(sizeHT(pTree), 0);
+    freeHT(pTree);
+  }
+}
+
+void test_setAlgebra(void **state) {
+  static char setKeys[COMPACT_COUNT][BUFFER];
+  static keyEntry setEntries[COMPACT_COUNT];
+  static keyEntry otherEntries[COMPACT_COUNT];
+  const hashTreeParams layouts[] = {(hashTreeParams){0},
+                                    (hashTreeParams){.compact = true},
+                                    (hashTreeParams){.btree = true},
+                                    (hashTreeParams){.ordered = true}};
+
+  for (int i = 0; i < COMPACT_COUNT; i++) {
+    snprintf(setKeys[i], BUFFER, "Set %03d", i);
+    setEntries[i] = (keyEntry){.key = setKeys[i], .length = strlen(setKeys[i])};
+    otherEntries[i] = setEntries[i];
+  }
+
+  // each layout against each, merged when the orders match
+  for (int left = 0; left < 4; left++) {
+    for (int right = 0; right < 4; right++) {
+      hashTreeParams params = layouts[left];
+      hashTree *pLeft = createHT(compareString, &params);
+      params = layouts[right];
+      hashTree *pRight = createHT(compareString, &params);
+      for (int i = 0; i < COMPACT_COUNT; i++) {
+        if (i % 2 == 0) {
+          setHT(pLeft, &setEntries[i], "left");
+        }
+        if (i % 3 == 0) {
+          setHT(pRight, &setEntries[i], "right");
+        }
+      }
+
+      hashTree *pUnion = unionHT(pLeft, pRight, NULL);
+      hashTree *pIntersect = intersectHT(pLeft, pRight, NULL);
+      hashTree *pDifference = differenceHT(pLeft, pRight, NULL);
+      for (int i = 0; i < COMPACT_COUNT; i++) {
+        const hashEntry *found = getHT(pUnion, &setEntries[i]);
+        assert_true((found != NULL) == (i % 2 == 0 || i % 3 == 0));
+        if (found != NULL) {
+          assert_string_equal(found->value, (i % 2 == 0) ? "left" : "right");
+        }
+        assert_true(hasEntryHT(pIntersect, &setEntries[i]) == (i % 6 == 0));
+        assert_true(hasEntryHT(pDifference, &setEntries[i]) ==
+                    (i % 2 == 0 && i % 3 != 0));
+      }
+      assert_int_equal(sizeHT(pUnion), 667);
+      assert_int_equal(sizeHT(pIntersect), 167);
+      assert_int_equal(sizeHT(pDifference), 333);
+      // the bulk built trees are balanced
+      assert_true(maxDepthHT(pUnion, pUnion->root) <= 10);
+      assert_true(maxDepthHT(pIntersect, pIntersect->root) <= 8);
+
+      assert_true(subsetHT(pIntersect, pLeft));
+      assert_true(subsetHT(pIntersect, pRight));
+      assert_false(subsetHT(pLeft, pIntersect));
+      assert_false(subsetHT(pDifference, pRight));
+      assert_true(hasAllHT(pUnion, pLeft));
+      assert_false(hasAllHT(pLeft, pRight));
+
+      freeHT(pUnion);
+      freeHT(pIntersect);
+      freeHT(pDifference);
+      freeHT(pLeft);
+      freeHT(pRight);
+    }
+  }
+
+  // retain and set in place keep the tree searchable
+  for (int i = 0; i < COMPACT_COUNT; i++) {
+    setHT(pHT, &setEntries[i], "left");
+    if (i % 3 == 0) {
+      setHT(pOther, &setEntries[i], "right");
+    }
+  }
+  retainAllHT(pHT, pOther);
+  assert_int_equal(sizeHT(pHT), 334);
+  assert_true(hasAllHT(pHT, pOther) && hasAllHT(pOther, pHT));
+  clearHT(pOther);
+  for (int i = 0; i < COMPACT_COUNT; i += 2) {
+    setHT(pOther, &otherEntries[i], "right");
+  }
+  setAllHT(pHT, pOther);
+  assert_int_equal(sizeHT(pHT), 667);
+  for (int i = 0; i < COMPACT_COUNT; i++) {
+    const hashEntry *found = getHT(pHT, &setEntries[i]);
+    assert_true((found != NULL) == (i % 2 == 0 || i % 3 == 0));
+    if (found != NULL) {
+      assert_string_equal(found->value, (i % 2 == 0) ? "right" : "left");
+      // the keys already held are kept, only the values are replaced
+      assert_ptr_equal(found->kEntry, (i % 6 == 0 || i % 2 != 0)
+                                          ? &setEntries[i]
+                                          : &otherEntries[i]);
+    }
+  }
+  assert_true(maxDepthHT(pHT, pHT->root) <= 10);
+
+  // bounded results are set entry by entry, still balanced
+  hashTree *pBounded =
+      unionHT(pHT, pOther, &(hashTreeParams){.maxEntries = COMPACT_COUNT});
+  assert_int_equal(sizeHT(pBounded), 667);
+  assert_true(maxDepthHT(pBounded, pBounded->root) <= 10);
+  freeHT(pBounded);
+}
+
+int compareUint64(const void *a, const void *b) {
+  uint64_t left = *(const uint64_t *)a, right = *(const uint64_t *)b;
+  return (left < right) ? -1 : (left > right) ? 1 : 0;
+}
+
+void test_layoutLookup(void **state) {
+  size_t max = 1000000;
+  uint64_t *numbers = calloc(max, sizeof(uint64_t));
+  keyEntry *entries = calloc(max, sizeof(keyEntry));
+  unsigned int seed = 1;
+
+  for (size_t i = 0; i < max; i++) {
+    numbers[i] = ((uint64_t)rand_r(&seed) << 32) | i;
+    entries[i] = (keyEntry){.key = &numbers[i], .length = sizeof(uint64_t)};
+  }
+
+  const char *layouts[] = {"Wide", "Compact", "BTree"};
+  for (int layout = 0; layout < 3; layout++) {
+    hashTreeParams params = (hashTreeParams){.growth = 1.5,
+                                             .capacity = max,
+                                             .compact = layout == 1,
+                                             .btree = layout == 2};
+    hashTree *pTree = createHT(compareUint64, &params);
+    for (size_t i = 0; i < max; i++) {
+      setHT(pTree, &entries[i], NULL);
+    }
+
+    clock_t start_t = clock();
+    size_t found = 0;
+    for (int round = 0; round < 5; round++) {
+      for (size_t i = 0; i < max; i++) {
+        found += hasEntryHT(pTree, &entries[(i * 7919) % max]);
+      }
+    }
+    printf("%s lookups:%lu\tFound:%lu\tCPU Time(sec): %f\n",
+           layouts[layout], max * 5, found,
+           (double)(clock() - start_t) / CLOCKS_PER_SEC);
+    assert_int_equal(found, max * 5);
+    freeHT(pTree);
+  }
+
+  free(entries);
+  free(numbers);
+}
+
 int setupHT(void **state) {
 
   pHT = createHT(compareString, NULL);
@@ -559,6 +1170,8 @@ int teardownHT(void **state) {
   }
 
   remove(FILENAME);
+  remove(FILENAME WAL_SUFFIX);
+  remove(FILENAME HT_COLD_SUFFIX);
 
   return 0;
 }
@@ -585,11 +1198,24 @@ int test_tree(void) {
       cmocka_unit_test_setup_teardown(test_delete, setupHT, teardownHT),
       cmocka_unit_test_setup_teardown(test_clear, setupHT, teardownHT),
       cmocka_unit_test_setup_teardown(test_deleteCallback, setupHT, teardownHT),
+      cmocka_unit_test_setup_teardown(test_deleteFreeKey, setupHT, teardownHT),
       cmocka_unit_test_setup_teardown(test_hasEntry, setupHT, teardownHT),
       cmocka_unit_test_setup_teardown(test_setAllHT, setupHT, teardownHT),
       cmocka_unit_test_setup_teardown(test_copyTree, setupHT, teardownHT),
       cmocka_unit_test_setup_teardown(test_retainAll, setupHT, teardownHT),
       cmocka_unit_test_setup_teardown(test_mmap, setupHT, teardownHT),
+      cmocka_unit_test_setup_teardown(test_walMMap, setupHT, teardownHT),
+      cmocka_unit_test_setup_teardown(test_snapshotTree, setupHT, teardownHT),
+      cmocka_unit_test_setup_teardown(test_compact, setupHT, teardownHT),
+      cmocka_unit_test_setup_teardown(test_compactMMap, setupHT, teardownHT),
+      cmocka_unit_test_setup_teardown(test_btree, setupHT, teardownHT),
+      cmocka_unit_test_setup_teardown(test_btreeMMap, setupHT, teardownHT),
+      cmocka_unit_test_setup_teardown(test_ordered, setupHT, teardownHT),
+      cmocka_unit_test_setup_teardown(test_cache, setupHT, teardownHT),
+      cmocka_unit_test_setup_teardown(test_setAlgebra, setupHT, teardownHT),
+#ifdef PERF
+      cmocka_unit_test_setup_teardown(test_layoutLookup, setupHT, teardownHT),
+#endif // PERF
 
   };
 
@@ -0,0 +1,128 @@
+#include "wrapper.h"
+#include "dynarray.hpp"
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <string>
+#include <zcmocka.h>
+
+struct point {
+  long x;
+  long y;
+  point(long x, long y) : x(x), y(y) {}
+  bool operator<(const point &other) const {
+    return x < other.x || (x == other.x && y < other.y);
+  }
+};
+
+void test_wrapperArray(void **state) {
+  dynarray::array<long> values;
+
+  assert_true(values.empty());
+  for (long i = 0; i < 1000; i++) {
+    values.emplace_back(999 - i);
+  }
+  assert_int_equal(values.size(), 1000);
+  assert_int_equal(values.front(), 999);
+  assert_int_equal(values.back(), 0);
+  assert_int_equal(*(long *)getDA(values.handle(), 1), 998);
+
+  values.sort();
+  for (long i = 0; i < 1000; i++) {
+    assert_int_equal(values[i], i);
+  }
+  assert_int_equal(values.find_sorted(500) - values.begin(), 500);
+  assert_true(values.find_sorted(1000) == values.end());
+
+  values.erase(values.begin(), values.begin() + 100);
+  assert_int_equal(values.size(), 900);
+  assert_int_equal(values[0], 100);
+  assert_int_equal(values.remove_if([](long v) { return v % 2 == 1; }), 450);
+  assert_int_equal(values.size(), 450);
+  assert_int_equal(values[1], 102);
+  values.pop_back();
+  assert_int_equal(values.back(), 996);
+
+  bool thrown = false;
+  try {
+    values.at(values.size());
+  } catch (const std::out_of_range &) {
+    thrown = true;
+  }
+  assert_true(thrown);
+
+  dynarray::array<long> copy = values.clone();
+  values.clear();
+  assert_int_equal(copy.size(), 449);
+  assert_int_equal(copy[0], 100);
+
+  dynarray::array<long> moved = std::move(copy);
+  assert_int_equal(moved.size(), 449);
+  dynArray *released = moved.release();
+  freeDA(released);
+
+  dynarray::array<point> points;
+  points.emplace_back(2, 1);
+  points.emplace_back(1, 2);
+  points.push_back(point(1, 1));
+  points.sort();
+  assert_int_equal(points[0].y, 1);
+  assert_int_equal(points[1].y, 2);
+  assert_int_equal(points[2].x, 2);
+  points.resize(5, point(9, 9));
+  assert_int_equal(points.at(4).x, 9);
+}
+
+void test_wrapperTree(void **state) {
+  dynarray::hash_tree<std::string, std::string> names;
+
+  for (int i = 0; i < 500; i++) {
+    names.emplace("key" + std::to_string(i), "value" + std::to_string(i));
+  }
+  assert_int_equal(names.size(), 500);
+  assert_string_equal(names.find("key42")->c_str(), "value42");
+  assert_null(names.find("key500"));
+
+  // emplace keeps the existing value, insert_or_assign replaces it
+  names.emplace("key42", "other");
+  assert_string_equal(names.find("key42")->c_str(), "value42");
+  names.insert_or_assign("key42", "other");
+  assert_string_equal(names.find("key42")->c_str(), "other");
+  assert_int_equal(names.size(), 500);
+
+  names.erase("key42");
+  assert_false(names.contains("key42"));
+  assert_int_equal(names.size(), 499);
+  names.balance();
+  for (int i = 0; i < 500; i++) {
+    assert_true(names.contains("key" + std::to_string(i)) == (i != 42));
+  }
+
+  size_t visited = 0;
+  names.for_each([&](const std::string &key, std::string &value) {
+    visited++;
+    return true;
+  });
+  assert_int_equal(visited, 499);
+
+  dynarray::hash_tree<uint64_t, double> numbers;
+  for (uint64_t i = 0; i < 100; i++) {
+    numbers.insert_or_assign(i, i / 2.0);
+  }
+  assert_true(*numbers.find(9) == 4.5);
+  numbers.clear();
+  assert_true(numbers.empty());
+  numbers.emplace(1, 1.0);
+  assert_int_equal(numbers.size(), 1);
+}
+
+int test_wrapper(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_wrapperArray),
+      cmocka_unit_test(test_wrapperTree),
+  };
+
+  int count_fail_tests = cmocka_run_group_tests(tests, NULL, NULL);
+
+  return count_fail_tests;
+}
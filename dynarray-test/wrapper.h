@@ -0,0 +1,14 @@
+#ifndef WRAPPER_H
+#define WRAPPER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int test_wrapper(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,11 +1,19 @@
+#define _GNU_SOURCE
+
 #include <errno.h>
+#include <fcntl.h>
 #include <math.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <linux/mempolicy.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 #include "dynarray.h"
+#include "dynflush.h"
 
 /**
  * @private
@@ -22,17 +30,322 @@ void *_safeCalloc(const size_t count, const size_t size) {
 /**
  * @private
  */
-void *_safeMMap(FILE *fp, const size_t count, const size_t size) {
+void *_safeAlignedAlloc(const size_t align, const size_t count,
+                        const size_t size, const bool zero) {
+  void *rtn = NULL;
+  size_t bytes;
+
+  if (__builtin_mul_overflow(count, size, &bytes) ||
+      posix_memalign(&rtn, align, bytes) != 0) {
+    EXIT_ERROR("Out of memory while allocating aligned. Count: %lu, Size: "
+               "%lu\n",
+               count, size);
+  }
+  if (zero) {
+    memset(rtn, 0, bytes);
+  }
+  return rtn;
+}
+
+/**
+ * @private
+ */
+static inline size_t _alignToDA(const size_t bytes, const size_t align) {
+  return (bytes + align - 1) & ~(align - 1);
+}
+
+/**
+ * @private
+ */
+static inline size_t _alignUpDA(const size_t bytes) {
+  return _alignToDA(bytes, sizeof(max_align_t));
+}
+
+/**
+ * @private
+ */
+static inline size_t _normaliseAlignmentDA(const size_t alignment,
+                                          const bool file) {
+  size_t align = sizeof(max_align_t);
+  size_t page = sysconf(_SC_PAGESIZE);
+
+  if (alignment == 0) {
+    // mapped files never grow with realloc(), so align them for cache lines
+    align = file ? CACHE_LINE_ALIGNMENT : DEFAULT_ALIGNMENT;
+  } else {
+    while (align < alignment && align < page) {
+      align <<= 1;
+    }
+  }
+
+  return align;
+}
+
+/**
+ * @private
+ */
+static inline size_t _dataOffsetDA(const size_t alignment) {
+  return _alignToDA(sizeof(fileHeader), alignment);
+}
+
+/**
+ * @private
+ */
+static inline size_t _imageBytesDA(const dynArray *pDA) {
+  return _alignToDA(pDA->offset + (pDA->capacity * pDA->elementSize),
+                    FLUSH_PAGE);
+}
+
+/**
+ * @private
+ */
+void *_arenaAllocDA(dynArrayArena *arena, const size_t bytes) {
+  size_t need = _alignUpDA(bytes);
+
+  if (arena->used + need > arena->capacity) {
+    // keep the full region on the chain and start a larger one
+    dynArrayArena *full = _safeCalloc(1, sizeof(dynArrayArena));
+    *full = *arena;
+    arena->capacity = (arena->capacity * 2 > need) ? arena->capacity * 2 : need;
+    arena->region = _safeReallocarray(NULL, 1, arena->capacity);
+    arena->used = 0;
+    arena->next = full;
+  }
+
+  void *rtn = arena->region + arena->used;
+  arena->used += need;
+  return rtn;
+}
+
+/**
+ * @private
+ */
+void _freeArenaChainDA(dynArrayArena *arena) {
+  while (arena) {
+    dynArrayArena *next = arena->next;
+    free(arena->region);
+    free(arena);
+    arena = next;
+  }
+}
+
+/**
+ * @private
+ */
+void *_safeMMap(FILE *fp, const size_t offset, const size_t count,
+                const size_t size) {
   void *rtn;
-  size_t cap = sizeof(fileHeader) + (count * size);
+  size_t cap = offset + (count * size);
   int fd = fileno(fp);
-  ftruncate(fd, cap);
+  struct stat st;
+  // only extend, anything stored after the data is kept
+  if (fstat(fd, &st) != 0 || st.st_size < cap) {
+    ftruncate(fd, cap);
+  }
   rtn = mmap(NULL, cap, PROT_WRITE | PROT_READ, MAP_SHARED, fd, 0);
   if (rtn == MAP_FAILED) {
     EXIT_ERROR("Error creating memory map file. Capacity: %lu\n", cap);
   }
 
-  return rtn + sizeof(fileHeader);
+  return rtn + offset;
+}
+
+/**
+ * @private
+ */
+static inline size_t _mappedBytesDA(const size_t count, const size_t size) {
+  size_t bytes = count * size;
+  return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+}
+
+/**
+ * @private
+ */
+void *_safeAnonMMap(dynArray *pDA, const size_t count, const size_t size) {
+  size_t bytes = _mappedBytesDA(count, size);
+
+  // over allocate so the region can be trimmed to a huge page boundary
+  void *map = mmap(NULL, bytes + HUGE_PAGE_SIZE, PROT_WRITE | PROT_READ,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (map == MAP_FAILED) {
+    EXIT_ERROR("Error creating anonymous memory map. Capacity: %lu\n", bytes);
+  }
+  size_t lead = (HUGE_PAGE_SIZE - ((size_t)map & (HUGE_PAGE_SIZE - 1))) &
+                (HUGE_PAGE_SIZE - 1);
+  if (lead > 0) {
+    munmap(map, lead);
+  }
+  munmap(map + lead + bytes, HUGE_PAGE_SIZE - lead);
+  void *rtn = map + lead;
+
+  // asked again for each new map, as a failure may be temporary
+  if (pDA->hugePages && madvise(rtn, bytes, MADV_HUGEPAGE) != 0) {
+    DEBUG_LOG("Unable to request huge pages. Error: %d\n", errno);
+  }
+
+  if (pDA->numaNodes != 0) {
+    int mode = pDA->numaInterleave ? MPOL_INTERLEAVE : MPOL_BIND;
+    if (syscall(SYS_mbind, rtn, bytes, mode, &pDA->numaNodes,
+                sizeof(pDA->numaNodes) * 8 + 1, 0) != 0) {
+      DEBUG_LOG("Unable to apply NUMA policy. Nodes: %lx, Error: %d\n",
+                pDA->numaNodes, errno);
+    }
+  }
+
+  return rtn;
+}
+
+/**
+ * @private
+ */
+void *_safeAnonReMMap(dynArray *pDA, void *ptr, const size_t cap,
+                      const size_t count, const size_t size) {
+  size_t oldBytes = _mappedBytesDA(cap, size);
+  size_t newBytes = _mappedBytesDA(count, size);
+  void *rtn = ptr;
+
+  if (newBytes < oldBytes) {
+    munmap(ptr + newBytes, oldBytes - newBytes);
+  } else if (newBytes > oldBytes) {
+    // move the existing pages into the new region rather than copy them
+    rtn = _safeAnonMMap(pDA, count, size);
+    if (mremap(ptr, oldBytes, oldBytes, MREMAP_MAYMOVE | MREMAP_FIXED, rtn) ==
+        MAP_FAILED) {
+      EXIT_ERROR("Error extending anonymous memory map. Capacity: %lu\n",
+                 newBytes);
+    }
+  }
+
+  return rtn;
+}
+
+/**
+ * @private
+ */
+typedef struct DynamicArrayShared {
+  int fd;            ///< the memfd holding the shared pages
+  size_t length;     ///< the memfd length
+  size_t references; ///< the arrays mapping the memfd
+} dynArrayShared;
+
+/**
+ * @private
+ */
+static inline size_t _sharedBytesDA(const size_t count, const size_t size) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  return ((count * size + page - 1) / page) * page;
+}
+
+/**
+ * @private
+ */
+bool _pwriteAllDA(const int fd, const void *data, const size_t length,
+                  const off_t offset) {
+  ssize_t rtn = 1;
+  for (size_t pos = 0; rtn > 0 && pos < length; pos += rtn) {
+    rtn = pwrite(fd, data + pos, length - pos, offset + pos);
+  }
+  return rtn > 0;
+}
+
+/**
+ * @private
+ */
+dynArrayShared *_createSharedDA(const size_t bytes) {
+  dynArrayShared *shared = _safeCalloc(1, sizeof(dynArrayShared));
+  shared->fd = memfd_create("dynarray", MFD_CLOEXEC);
+  if (shared->fd == -1 || ftruncate(shared->fd, bytes) != 0) {
+    EXIT_ERROR("Error creating shared memory. Capacity: %lu\n", bytes);
+  }
+  shared->length = bytes;
+  shared->references = 1;
+  return shared;
+}
+
+/**
+ * @private
+ */
+void _releaseSharedDA(dynArrayShared *shared) {
+  if (--shared->references == 0) {
+    close(shared->fd);
+    free(shared);
+  }
+}
+
+/**
+ * @private
+ */
+void *_safeSharedMMap(const dynArrayShared *shared, const size_t bytes) {
+  // private so writes are copied, leaving the shared pages unchanged
+  void *rtn = mmap(NULL, bytes, PROT_WRITE | PROT_READ, MAP_PRIVATE,
+                   shared->fd, 0);
+  if (rtn == MAP_FAILED) {
+    EXIT_ERROR("Error mapping shared memory. Capacity: %lu\n", bytes);
+  }
+  return rtn;
+}
+
+/**
+ * @private
+ */
+void *_safeSharedReMMap(dynArray *pDA, void *ptr, const size_t cap,
+                        const size_t count, const size_t size) {
+  size_t oldBytes = _sharedBytesDA(cap, size);
+  size_t newBytes = _sharedBytesDA(count, size);
+
+  // never shrink, snapshots may still map the tail
+  if (newBytes > pDA->shared->length) {
+    if (ftruncate(pDA->shared->fd, newBytes) != 0) {
+      EXIT_ERROR("Error extending shared memory. Capacity: %lu\n", newBytes);
+    }
+    pDA->shared->length = newBytes;
+  }
+  void *rtn = mremap(ptr, oldBytes, newBytes, MREMAP_MAYMOVE);
+  if (rtn == MAP_FAILED) {
+    EXIT_ERROR("Error extending shared memory map. Capacity: %lu\n",
+               newBytes);
+  }
+  return rtn;
+}
+
+/**
+ * @private
+ */
+void _writeBackSharedDA(dynArray *pDA, const size_t bytes) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t pages = bytes / page;
+  off_t first = ((size_t)pDA->array / page) * sizeof(uint64_t);
+  uint64_t entries[FILE_BUFFER];
+  int pagemap = open("/proc/self/pagemap", O_RDONLY);
+  size_t run = 0;
+
+  // private copies are present anonymous pages or swapped out, every other
+  // page still matches the shared pages
+  for (size_t p = 0; p < pages;) {
+    size_t batch = (pages - p < FILE_BUFFER) ? pages - p : FILE_BUFFER;
+    bool known = pagemap != -1 &&
+                 pread(pagemap, entries, batch * sizeof(uint64_t),
+                       first + (p * sizeof(uint64_t))) ==
+                     batch * sizeof(uint64_t);
+    for (size_t i = 0; i < batch; i++, p++) {
+      bool copied = !known ||
+                    ((entries[i] >> 63) & 1 && !((entries[i] >> 61) & 1)) ||
+                    (entries[i] >> 62) & 1;
+      if (!copied && run < p) {
+        _pwriteAllDA(pDA->shared->fd, pDA->array + (run * page),
+                     (p - run) * page, run * page);
+      }
+      run = copied ? run : p + 1;
+    }
+  }
+  if (run < pages) {
+    _pwriteAllDA(pDA->shared->fd, pDA->array + (run * page),
+                 (pages - run) * page, run * page);
+  }
+
+  if (pagemap != -1) {
+    close(pagemap);
+  }
 }
 
 /**
@@ -50,13 +363,13 @@ void *_safeReallocarray(void *ptr, const size_t count, const size_t size) {
 /**
  * @private
  */
-void *_safeReMMap(FILE *fp, void *ptr, const size_t cap, const size_t count,
-                  const size_t size) {
+void *_safeReMMap(FILE *fp, void *ptr, const size_t offset, const size_t cap,
+                  const size_t count, const size_t size) {
   void *rtn;
-  size_t newCap = sizeof(fileHeader) + (count * size);
-  size_t oldCap = sizeof(fileHeader) + (cap * size);
-  msync(ptr - sizeof(fileHeader), oldCap, MS_SYNC);
-  munmap(ptr - sizeof(fileHeader), oldCap);
+  size_t newCap = offset + (count * size);
+  size_t oldCap = offset + (cap * size);
+  msync(ptr - offset, oldCap, MS_SYNC);
+  munmap(ptr - offset, oldCap);
   int fd = fileno(fp);
   ftruncate(fd, newCap);
   rtn = mmap(NULL, newCap, PROT_WRITE | PROT_READ, MAP_SHARED, fd, 0);
@@ -64,22 +377,203 @@ void *_safeReMMap(FILE *fp, void *ptr, const size_t cap, const size_t count,
     EXIT_ERROR("Error extending memory map file. Capacity: %lu\n", newCap);
   }
 
-  return rtn + sizeof(fileHeader);
+  return rtn + offset;
+}
+
+/**
+ * @private
+ */
+void *_safePrivateReMMap(FILE *fp, void *ptr, const size_t offset,
+                         const size_t cap, const size_t count,
+                         const size_t size) {
+  void *rtn;
+  size_t newCap = offset + (count * size);
+  size_t oldCap = offset + (cap * size);
+  int fd = fileno(fp);
+  struct stat st;
+  // only extend, the last commit may still refer to the tail
+  if (fstat(fd, &st) != 0 || st.st_size < newCap) {
+    ftruncate(fd, newCap);
+  }
+  // the private pages move with the map so uncommitted writes are kept
+  rtn = mremap(ptr - offset, oldCap, newCap, MREMAP_MAYMOVE);
+  if (rtn == MAP_FAILED) {
+    EXIT_ERROR("Error extending memory map file. Capacity: %lu\n", newCap);
+  }
+
+  return rtn + offset;
+}
+
+/**
+ * @private
+ */
+static const uint32_t _crc32cTable[256] = {
+    // reflected Castagnoli polynomial 0x82F63B78, fixed rather than filled on
+    // first use so concurrent callers never read it part filled
+    0x00000000U, 0xF26B8303U, 0xE13B70F7U, 0x1350F3F4U, 0xC79A971FU,
+    0x35F1141CU, 0x26A1E7E8U, 0xD4CA64EBU, 0x8AD958CFU, 0x78B2DBCCU,
+    0x6BE22838U, 0x9989AB3BU, 0x4D43CFD0U, 0xBF284CD3U, 0xAC78BF27U,
+    0x5E133C24U, 0x105EC76FU, 0xE235446CU, 0xF165B798U, 0x030E349BU,
+    0xD7C45070U, 0x25AFD373U, 0x36FF2087U, 0xC494A384U, 0x9A879FA0U,
+    0x68EC1CA3U, 0x7BBCEF57U, 0x89D76C54U, 0x5D1D08BFU, 0xAF768BBCU,
+    0xBC267848U, 0x4E4DFB4BU, 0x20BD8EDEU, 0xD2D60DDDU, 0xC186FE29U,
+    0x33ED7D2AU, 0xE72719C1U, 0x154C9AC2U, 0x061C6936U, 0xF477EA35U,
+    0xAA64D611U, 0x580F5512U, 0x4B5FA6E6U, 0xB93425E5U, 0x6DFE410EU,
+    0x9F95C20DU, 0x8CC531F9U, 0x7EAEB2FAU, 0x30E349B1U, 0xC288CAB2U,
+    0xD1D83946U, 0x23B3BA45U, 0xF779DEAEU, 0x05125DADU, 0x1642AE59U,
+    0xE4292D5AU, 0xBA3A117EU, 0x4851927DU, 0x5B016189U, 0xA96AE28AU,
+    0x7DA08661U, 0x8FCB0562U, 0x9C9BF696U, 0x6EF07595U, 0x417B1DBCU,
+    0xB3109EBFU, 0xA0406D4BU, 0x522BEE48U, 0x86E18AA3U, 0x748A09A0U,
+    0x67DAFA54U, 0x95B17957U, 0xCBA24573U, 0x39C9C670U, 0x2A993584U,
+    0xD8F2B687U, 0x0C38D26CU, 0xFE53516FU, 0xED03A29BU, 0x1F682198U,
+    0x5125DAD3U, 0xA34E59D0U, 0xB01EAA24U, 0x42752927U, 0x96BF4DCCU,
+    0x64D4CECFU, 0x77843D3BU, 0x85EFBE38U, 0xDBFC821CU, 0x2997011FU,
+    0x3AC7F2EBU, 0xC8AC71E8U, 0x1C661503U, 0xEE0D9600U, 0xFD5D65F4U,
+    0x0F36E6F7U, 0x61C69362U, 0x93AD1061U, 0x80FDE395U, 0x72966096U,
+    0xA65C047DU, 0x5437877EU, 0x4767748AU, 0xB50CF789U, 0xEB1FCBADU,
+    0x197448AEU, 0x0A24BB5AU, 0xF84F3859U, 0x2C855CB2U, 0xDEEEDFB1U,
+    0xCDBE2C45U, 0x3FD5AF46U, 0x7198540DU, 0x83F3D70EU, 0x90A324FAU,
+    0x62C8A7F9U, 0xB602C312U, 0x44694011U, 0x5739B3E5U, 0xA55230E6U,
+    0xFB410CC2U, 0x092A8FC1U, 0x1A7A7C35U, 0xE811FF36U, 0x3CDB9BDDU,
+    0xCEB018DEU, 0xDDE0EB2AU, 0x2F8B6829U, 0x82F63B78U, 0x709DB87BU,
+    0x63CD4B8FU, 0x91A6C88CU, 0x456CAC67U, 0xB7072F64U, 0xA457DC90U,
+    0x563C5F93U, 0x082F63B7U, 0xFA44E0B4U, 0xE9141340U, 0x1B7F9043U,
+    0xCFB5F4A8U, 0x3DDE77ABU, 0x2E8E845FU, 0xDCE5075CU, 0x92A8FC17U,
+    0x60C37F14U, 0x73938CE0U, 0x81F80FE3U, 0x55326B08U, 0xA759E80BU,
+    0xB4091BFFU, 0x466298FCU, 0x1871A4D8U, 0xEA1A27DBU, 0xF94AD42FU,
+    0x0B21572CU, 0xDFEB33C7U, 0x2D80B0C4U, 0x3ED04330U, 0xCCBBC033U,
+    0xA24BB5A6U, 0x502036A5U, 0x4370C551U, 0xB11B4652U, 0x65D122B9U,
+    0x97BAA1BAU, 0x84EA524EU, 0x7681D14DU, 0x2892ED69U, 0xDAF96E6AU,
+    0xC9A99D9EU, 0x3BC21E9DU, 0xEF087A76U, 0x1D63F975U, 0x0E330A81U,
+    0xFC588982U, 0xB21572C9U, 0x407EF1CAU, 0x532E023EU, 0xA145813DU,
+    0x758FE5D6U, 0x87E466D5U, 0x94B49521U, 0x66DF1622U, 0x38CC2A06U,
+    0xCAA7A905U, 0xD9F75AF1U, 0x2B9CD9F2U, 0xFF56BD19U, 0x0D3D3E1AU,
+    0x1E6DCDEEU, 0xEC064EEDU, 0xC38D26C4U, 0x31E6A5C7U, 0x22B65633U,
+    0xD0DDD530U, 0x0417B1DBU, 0xF67C32D8U, 0xE52CC12CU, 0x1747422FU,
+    0x49547E0BU, 0xBB3FFD08U, 0xA86F0EFCU, 0x5A048DFFU, 0x8ECEE914U,
+    0x7CA56A17U, 0x6FF599E3U, 0x9D9E1AE0U, 0xD3D3E1ABU, 0x21B862A8U,
+    0x32E8915CU, 0xC083125FU, 0x144976B4U, 0xE622F5B7U, 0xF5720643U,
+    0x07198540U, 0x590AB964U, 0xAB613A67U, 0xB831C993U, 0x4A5A4A90U,
+    0x9E902E7BU, 0x6CFBAD78U, 0x7FAB5E8CU, 0x8DC0DD8FU, 0xE330A81AU,
+    0x115B2B19U, 0x020BD8EDU, 0xF0605BEEU, 0x24AA3F05U, 0xD6C1BC06U,
+    0xC5914FF2U, 0x37FACCF1U, 0x69E9F0D5U, 0x9B8273D6U, 0x88D28022U,
+    0x7AB90321U, 0xAE7367CAU, 0x5C18E4C9U, 0x4F48173DU, 0xBD23943EU,
+    0xF36E6F75U, 0x0105EC76U, 0x12551F82U, 0xE03E9C81U, 0x34F4F86AU,
+    0xC69F7B69U, 0xD5CF889DU, 0x27A40B9EU, 0x79B737BAU, 0x8BDCB4B9U,
+    0x988C474DU, 0x6AE7C44EU, 0xBE2DA0A5U, 0x4C4623A6U, 0x5F16D052U,
+    0xAD7D5351U};
+
+/**
+ * @private
+ */
+uint32_t _crc32cSoft(uint32_t crc, const uint8_t *data, size_t length) {
+  while (length--) {
+    crc = _crc32cTable[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if defined(__x86_64__)
+/**
+ * @private
+ */
+__attribute__((target("sse4.2"))) uint32_t
+_crc32cHard(uint32_t crc, const uint8_t *data, size_t length) {
+  uint64_t crc64 = crc;
+  uint64_t block;
+
+  while (length >= sizeof(block)) {
+    memcpy(&block, data, sizeof(block));
+    crc64 = __builtin_ia32_crc32di(crc64, block);
+    data += sizeof(block);
+    length -= sizeof(block);
+  }
+  crc = crc64;
+  while (length--) {
+    crc = __builtin_ia32_crc32qi(crc, *data++);
+  }
+  return crc;
+}
+#endif // __x86_64__
+
+/**
+ * @private
+ */
+static inline size_t _headerSizeDA(const size_t version) {
+  return (version == 1)   ? FILE_HEADER_V1_SIZE
+         : (version == 2) ? FILE_HEADER_V2_SIZE
+                          : sizeof(fileHeader);
+}
+
+/**
+ * @private
+ */
+static inline uint32_t _headerChecksumDA(const fileHeader *header) {
+  return crc32c(header, offsetof(fileHeader, checksum), 0);
+}
+
+/**
+ * @private
+ */
+static inline size_t _checksumOffsetDA(const dynArray *pDA) {
+  return pDA->offset + (pDA->capacity * pDA->elementSize);
 }
 
 /**
  * @private
  */
-void _updateFromHeader(dynArray *pDA, const fileHeader *header) {
+bool _updateFromHeader(dynArray *pDA, const fileHeader *header,
+                       const size_t length) {
+  bool valid = false;
 
-  if (header->version == 1) {
+  if (header->version == 1 || header->version == 2 ||
+      header->version == 3) {
+    pDA->version = header->version;
     pDA->elementSize = header->elementSize;
     pDA->size = header->size;
     pDA->capacity = header->capacity;
     pDA->growth = header->growth;
+    if (header->version == 1) {
+      // version 1 data follows the unpadded header
+      pDA->offset = FILE_HEADER_V1_SIZE;
+      pDA->alignment = sizeof(size_t);
+    } else {
+      pDA->offset = header->offset;
+      pDA->alignment = header->alignment;
+    }
+    // a corrupt capacity must not wrap the size check
+    size_t bytes;
+    valid = pDA->elementSize > 0 && pDA->size <= pDA->capacity &&
+            pDA->offset >= _headerSizeDA(pDA->version) &&
+            !__builtin_mul_overflow(pDA->capacity, pDA->elementSize, &bytes) &&
+            !__builtin_add_overflow(bytes, pDA->offset, &bytes) &&
+            length >= bytes;
+
+    if (valid && header->version == 3) {
+      if (header->magic != FILE_MAGIC || header->endian != FILE_ENDIAN) {
+        DEBUG_LOG("Error invalid header magic: %x\n", header->magic);
+        valid = false;
+      } else if (header->checksum != _headerChecksumDA(header)) {
+        DEBUG_LOG("Error invalid header checksum: %x\n", header->checksum);
+        valid = false;
+      } else if (header->flags & FILE_FLAG_CHECKSUM) {
+        pDA->checksumBlock = header->blockSize;
+        pDA->checksums = header->blocks;
+        valid = pDA->checksumBlock > 0 &&
+                !__builtin_mul_overflow(pDA->checksums, sizeof(uint32_t),
+                                        &bytes) &&
+                !__builtin_add_overflow(bytes, _checksumOffsetDA(pDA),
+                                        &bytes) &&
+                length >= bytes;
+      }
+    }
+  } else if (__builtin_bswap64(header->version) == FILE_VERSION) {
+    DEBUG_LOG("Error header byte order mismatch: %lx\n", header->version);
   } else {
-    EXIT_ERROR("Error invalid header version: %lu\n", header->version);
+    DEBUG_LOG("Error invalid header version: %lu\n", header->version);
   }
+
+  return valid;
 }
 
 /**
@@ -89,14 +583,320 @@ void _updateMMap(dynArray *pDA) {
 
   fileHeader header;
   readHeaderDA(pDA, &header);
-  header.version=1;
+  header.version = pDA->version;
   header.elementSize = pDA->elementSize;
   header.size = pDA->size;
   header.capacity = pDA->capacity;
   header.growth = pDA->growth;
 
-  *(fileHeader *)(pDA->array - sizeof(fileHeader)) = header;
-  msync(pDA->array - sizeof(fileHeader), sizeof(fileHeader), MS_SYNC);
+  // older files have no room for the newer fields
+  if (pDA->version >= 2) {
+    header.offset = pDA->offset;
+    header.alignment = pDA->alignment;
+  }
+  if (pDA->version >= 3) {
+    header.magic = FILE_MAGIC;
+    header.endian = FILE_ENDIAN;
+    size_t batch = (pDA->walBatch < 0xFFFF) ? pDA->walBatch : 0xFFFF;
+    header.flags = ((pDA->checksumBlock > 0) ? FILE_FLAG_CHECKSUM : 0) |
+                   ((pDA->wal != NULL)
+                        ? FILE_FLAG_WAL | (batch << FILE_WAL_BATCH_SHIFT)
+                        : 0);
+    header.blockSize = pDA->checksumBlock;
+    header.blocks = pDA->checksums;
+    header.checksum = _headerChecksumDA(&header);
+  }
+
+  size_t length = _headerSizeDA(pDA->version);
+  memcpy(pDA->array - pDA->offset, &header, length);
+  // with a log the header only reaches the file through a commit, and write
+  // back arrays are not mapped
+  if (pDA->wal == NULL && pDA->flusher == NULL) {
+    msync(pDA->array - pDA->offset, length, MS_SYNC);
+  }
+}
+
+/**
+ * @private
+ */
+void _writeChecksumsDA(dynArray *pDA) {
+  size_t bytes = pDA->size * pDA->elementSize;
+  size_t blocks = (bytes + pDA->checksumBlock - 1) / pDA->checksumBlock;
+  uint32_t sums[FILE_BUFFER];
+  off_t pos = _checksumOffsetDA(pDA);
+
+  // write the table in batches to keep the stack use bounded
+  for (size_t b = 0; b < blocks;) {
+    size_t batch = 0;
+    for (; batch < FILE_BUFFER && b < blocks; batch++, b++) {
+      size_t from = b * pDA->checksumBlock;
+      size_t len =
+          (bytes - from < pDA->checksumBlock) ? bytes - from : pDA->checksumBlock;
+      sums[batch] = crc32c(pDA->array + from, len, 0);
+    }
+    if (pwrite(fileno(pDA->fp), sums, batch * sizeof(uint32_t), pos) < 0) {
+      EXIT_ERROR("Error writing checksums. Blocks: %lu\n", blocks);
+    }
+    pos += batch * sizeof(uint32_t);
+  }
+  pDA->checksums = blocks;
+}
+
+/**
+ * @private
+ */
+#define WAL_COMMIT UINT64_MAX
+
+/**
+ * @private
+ */
+typedef struct WalRange {
+  size_t index; ///< the first element written
+  size_t count; ///< the number of elements written
+} walRange;
+
+/**
+ * @private
+ */
+typedef struct WalRecord {
+  uint64_t offset;   ///< the file offset, or WAL_COMMIT for a commit record
+  uint64_t length;   ///< the data length, or the batch length for a commit
+  uint32_t checksum; ///< the CRC32C of the batch for a commit record
+  uint32_t reserved; ///< unused and set to 0
+} walRecord;
+
+/**
+ * @private
+ */
+static inline void _walNameDA(char *walName, const char *filename) {
+  strcpy(walName, filename);
+  strcat(walName, WAL_SUFFIX);
+}
+
+/**
+ * @private
+ */
+void _appendWalDA(dynArray *buffer, const size_t offset, const void *data,
+                  const size_t length) {
+  walRecord record = {.offset = offset, .length = length};
+  addArrayDA(buffer, &record, sizeof(walRecord));
+  addArrayDA(buffer, data, length);
+}
+
+/**
+ * @private
+ */
+bool _applyWalDA(const int fd, const void *batch, const size_t length) {
+  bool applied = true;
+  walRecord record;
+
+  for (size_t pos = 0; applied && pos + sizeof(walRecord) <= length;) {
+    // records follow unaligned data so copy them out
+    memcpy(&record, batch + pos, sizeof(walRecord));
+    pos += sizeof(walRecord);
+    applied = pos + record.length <= length &&
+              pwrite(fd, batch + pos, record.length, record.offset) ==
+                  record.length;
+    pos += record.length;
+  }
+
+  return applied;
+}
+
+/**
+ * @private
+ */
+void _remapCommittedDA(dynArray *pDA, const void *batch, const size_t length) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t cap = pDA->offset + (pDA->capacity * pDA->elementSize);
+  void *base = pDA->array - pDA->offset;
+  walRecord record;
+
+  // the committed pages now match the file, so their private copies are
+  // dropped by mapping the file over them again
+  for (size_t pos = 0; pos + sizeof(walRecord) <= length;
+       pos += sizeof(walRecord) + record.length) {
+    memcpy(&record, batch + pos, sizeof(walRecord));
+    size_t from = record.offset & ~(page - 1);
+    size_t to = _alignToDA(record.offset + record.length, page);
+    to = (to < cap) ? to : cap;
+    if (from < to &&
+        mmap(base + from, to - from, PROT_WRITE | PROT_READ,
+             MAP_PRIVATE | MAP_FIXED, fileno(pDA->fp), from) == MAP_FAILED) {
+      EXIT_ERROR("Error remapping committed pages. Offset: %lu\n", from);
+    }
+  }
+}
+
+/**
+ * @private
+ */
+void _openWalDA(dynArray *pDA, const char *filename, const size_t batch) {
+  char walName[strlen(filename) + sizeof(WAL_SUFFIX)];
+  _walNameDA(walName, filename);
+
+  pDA->wal = fopen(walName, "w");
+  if (pDA->wal == NULL) {
+    EXIT_ERROR("Error creating write ahead log: %s\n", walName);
+  }
+  pDA->walBatch = (batch < 1) ? 1 : batch;
+  pDA->walPending = 0;
+  pDA->walRanges = createDA(sizeof(walRange), NULL, NULL);
+  pDA->walBuffer = createDA(sizeof(char), NULL, NULL);
+
+  // flag and sync the file, then switch to a private map so uncommitted
+  // writes never reach it
+  size_t cap = pDA->offset + (pDA->capacity * pDA->elementSize);
+  _updateMMap(pDA);
+  msync(pDA->array - pDA->offset, cap, MS_SYNC);
+  if (mmap(pDA->array - pDA->offset, cap, PROT_WRITE | PROT_READ,
+           MAP_PRIVATE | MAP_FIXED, fileno(pDA->fp), 0) == MAP_FAILED) {
+    EXIT_ERROR("Error creating private memory map. Capacity: %lu\n", cap);
+  }
+}
+
+/**
+ * @private
+ */
+bool _recoverDA(const char *filename) {
+  bool recovered = false;
+  char walName[strlen(filename) + sizeof(WAL_SUFFIX)];
+  _walNameDA(walName, filename);
+
+  FILE *wal = fopen(walName, "r");
+  int fd = (wal != NULL) ? open(filename, O_RDWR) : -1;
+
+  if (fd != -1) {
+    dynArray *batch = createDA(sizeof(char), NULL, NULL);
+    struct stat st;
+    walRecord record;
+    bool valid = fstat(fileno(wal), &st) == 0;
+
+    // apply each complete batch, a torn batch at the end was never committed
+    while (valid && fread(&record, sizeof(walRecord), 1, wal) == 1) {
+      if (record.offset != WAL_COMMIT) {
+        size_t at = batch->size + sizeof(walRecord);
+        valid = record.length <= (size_t)st.st_size &&
+                addArrayDA(batch, &record, sizeof(walRecord)) &&
+                resizeDA(batch, at + record.length, NULL) &&
+                fread(batch->array + at, 1, record.length, wal) ==
+                    record.length;
+      } else {
+        valid = record.length == batch->size &&
+                record.checksum == crc32c(batch->array, batch->size, 0) &&
+                _applyWalDA(fd, batch->array, batch->size);
+        recovered |= valid;
+        clearDA(batch);
+      }
+    }
+    freeDA(batch);
+
+    // the last committed header may describe a longer file than was synced
+    fileHeader header = {0};
+    dynArray replayed = {0};
+    if (recovered && pread(fd, &header, sizeof(fileHeader), 0) > 0 &&
+        _updateFromHeader(&replayed, &header, SIZE_MAX) &&
+        fstat(fd, &st) == 0) {
+      size_t length = _checksumOffsetDA(&replayed) +
+                      (replayed.checksums * sizeof(uint32_t));
+      if (st.st_size < length) {
+        ftruncate(fd, length);
+      }
+    }
+    fdatasync(fd);
+    close(fd);
+  }
+
+  if (wal != NULL) {
+    fclose(wal);
+    if (fd != -1) {
+      // the file now holds every commit so the log is done with
+      remove(walName);
+    }
+  }
+
+  return recovered;
+}
+
+/**
+ * @private
+ */
+static inline void _walOperationDA(dynArray *pDA) {
+  if (pDA->wal != NULL && pDA->walDepth == 0 &&
+      ++pDA->walPending >= pDA->walBatch) {
+    commitDA(pDA);
+  }
+}
+
+/**
+ * @private
+ */
+void _reallocStorageDA(dynArray *pDA, const size_t cap) {
+  if (pDA->arena != NULL || pDA->inlined) {
+    // carved storage can not be reallocated so move it
+    void *array =
+        (pDA->arena != NULL)
+            ? (void *)_alignToDA(
+                  (size_t)_arenaAllocDA(pDA->arena,
+                                        pDA->capacity * pDA->elementSize +
+                                            pDA->alignment),
+                  pDA->alignment)
+            : _safeAlignedAlloc(pDA->alignment, pDA->capacity,
+                                pDA->elementSize, false);
+    memcpy(array, pDA->array, cap * pDA->elementSize);
+    pDA->array = array;
+    pDA->inlined = false;
+  } else if (pDA->shared != NULL && pDA->frozen) {
+    // a snapshot that is resized takes its own storage
+    void *array = _safeAlignedAlloc(pDA->alignment, pDA->capacity,
+                                    pDA->elementSize, false);
+    memcpy(array, pDA->array,
+           ((cap < pDA->capacity) ? cap : pDA->capacity) * pDA->elementSize);
+    munmap(pDA->array, _sharedBytesDA(cap, pDA->elementSize));
+    _releaseSharedDA(pDA->shared);
+    pDA->shared = NULL;
+    pDA->frozen = false;
+    pDA->array = array;
+  } else if (pDA->shared != NULL) {
+    pDA->array = _safeSharedReMMap(pDA, pDA->array, cap, pDA->capacity,
+                                   pDA->elementSize);
+  } else if (pDA->mapped) {
+    pDA->array = _safeAnonReMMap(pDA, pDA->array, cap, pDA->capacity,
+                                 pDA->elementSize);
+  } else if (pDA->fp == NULL && pDA->alignment <= sizeof(max_align_t)) {
+    pDA->array = _safeReallocarray(pDA->array, pDA->capacity, pDA->elementSize);
+  } else if (pDA->fp == NULL) {
+    // realloc does not keep the alignment so move into a new buffer
+    void *array = _safeAlignedAlloc(pDA->alignment, pDA->capacity,
+                                    pDA->elementSize, false);
+    memcpy(array, pDA->array,
+           ((cap < pDA->capacity) ? cap : pDA->capacity) * pDA->elementSize);
+    free(pDA->array);
+    pDA->array = array;
+  } else if (pDA->flusher != NULL) {
+    // a flush may still be reading the image, so wait for it before moving
+    _drainFlusherDA(pDA->flusher);
+    void *image = _safeAlignedAlloc(FLUSH_PAGE, 1, _imageBytesDA(pDA), false);
+    memcpy(image, pDA->array - pDA->offset,
+           pDA->offset +
+               ((cap < pDA->capacity) ? cap : pDA->capacity) * pDA->elementSize);
+    free(pDA->array - pDA->offset);
+    pDA->array = image + pDA->offset;
+    // the checksum table follows the capacity so it is dropped
+    pDA->checksums = 0;
+    _updateMMap(pDA);
+  } else {
+    pDA->array = (pDA->wal != NULL)
+                     ? _safePrivateReMMap(pDA->fp, pDA->array, pDA->offset,
+                                          cap, pDA->capacity, pDA->elementSize)
+                     : _safeReMMap(pDA->fp, pDA->array, pDA->offset, cap,
+                                   pDA->capacity, pDA->elementSize);
+    // resizing the file drops the checksum table after the data
+    pDA->checksums = 0;
+    _updateMMap(pDA);
+  }
+  // views of the old storage are no longer valid
+  pDA->generation++;
 }
 
 /**
@@ -118,14 +918,7 @@ bool _extendCapacityDA(dynArray *pDA) {
     while (pDA->size > pDA->capacity) {
       pDA->capacity = ceil(pDA->capacity * pDA->growth);
     }
-    if (pDA->fp == NULL) {
-      pDA->array =
-          _safeReallocarray(pDA->array, pDA->capacity, pDA->elementSize);
-    } else {
-      pDA->array = _safeReMMap(pDA->fp, pDA->array, cap, pDA->capacity,
-                               pDA->elementSize);
-      _updateMMap(pDA);
-    }
+    _reallocStorageDA(pDA, cap);
 
     extended = true;
   }
@@ -214,11 +1007,157 @@ size_t _binarySearch(const dynArray *pDA,
   return found;
 }
 
-void syncDA(dynArray *pDA) {
-  if (pDA->fp == NULL) {
-    size_t cap = sizeof(fileHeader) + (pDA->capacity * pDA->size);
-    msync(pDA->array - sizeof(fileHeader), cap, MS_SYNC);
+void syncDAMap(dynArray *pDA) {
+  if (pDA->fp != NULL) {
+    size_t cap = pDA->offset + (pDA->capacity * pDA->elementSize);
+    commitDA(pDA);
+    if (pDA->checksumBlock > 0) {
+      _writeChecksumsDA(pDA);
+    }
+    _updateMMap(pDA);
+    if (pDA->wal != NULL) {
+      // every commit is in the file once it is synced, so reset the log
+      int fd = fileno(pDA->fp);
+      pwrite(fd, pDA->array - pDA->offset, _headerSizeDA(pDA->version), 0);
+      fdatasync(fd);
+      ftruncate(fileno(pDA->wal), 0);
+      rewind(pDA->wal);
+    } else if (pDA->flusher != NULL) {
+      if (!waitFlushDA(flushDA(pDA))) {
+        EXIT_ERROR("Error writing back file. Capacity: %lu\n", cap);
+      }
+      fdatasync(fileno(pDA->fp));
+    } else {
+      msync(pDA->array - pDA->offset, cap, MS_SYNC);
+    }
+  }
+}
+
+void logDA(dynArray *pDA, const size_t index, const size_t count) {
+  if (pDA->parent != NULL) {
+    // sub-arrays write into the parent storage
+    logDA((dynArray *)pDA->parent,
+          ((pDA->array - pDA->parent->array) / pDA->elementSize) + index,
+          count);
+  } else if (pDA->wal != NULL) {
+    walRange *last = (pDA->walRanges->size > 0)
+                         ? getDA(pDA->walRanges, pDA->walRanges->size - 1)
+                         : NULL;
+    if (count == 0) {
+      // header only change
+    } else if (last != NULL && index >= last->index &&
+               index <= last->index + last->count) {
+      // merge with the last range
+      size_t end = index + count;
+      if (end > last->index + last->count) {
+        last->count = end - last->index;
+      }
+    } else {
+      addDA(pDA->walRanges, &(walRange){.index = index, .count = count});
+    }
+    _walOperationDA(pDA);
+  }
+}
+
+void beginWriteDA(dynArray *pDA) { pDA->walDepth++; }
+
+void endWriteDA(dynArray *pDA) {
+  if (pDA->walDepth > 0 && --pDA->walDepth == 0) {
+    _walOperationDA(pDA);
+  }
+}
+
+bool commitDA(dynArray *pDA) {
+  bool committed = false;
+
+  if (pDA->wal != NULL) {
+    dynArray *buffer = pDA->walBuffer;
+    clearDA(buffer);
+    _updateMMap(pDA);
+
+    for (size_t i = 0; i < pDA->walRanges->size; i++) {
+      walRange *range = getDA(pDA->walRanges, i);
+      // the array may have shrunk since the range was marked
+      if (range->index < pDA->capacity) {
+        size_t count = (range->count < pDA->capacity - range->index)
+                           ? range->count
+                           : pDA->capacity - range->index;
+        _appendWalDA(buffer, pDA->offset + (range->index * pDA->elementSize),
+                     _toPtr(pDA, range->index), count * pDA->elementSize);
+      }
+    }
+    _appendWalDA(buffer, 0, pDA->array - pDA->offset,
+                 _headerSizeDA(pDA->version));
+
+    size_t length = buffer->size;
+    walRecord commit = {.offset = WAL_COMMIT,
+                        .length = length,
+                        .checksum = crc32c(buffer->array, length, 0)};
+    addArrayDA(buffer, &commit, sizeof(walRecord));
+
+    // the batch must be durable in the log before the file is changed
+    if (fwrite(buffer->array, 1, buffer->size, pDA->wal) != buffer->size ||
+        fflush(pDA->wal) != 0 || fdatasync(fileno(pDA->wal)) != 0 ||
+        !_applyWalDA(fileno(pDA->fp), buffer->array, length)) {
+      EXIT_ERROR("Error writing write ahead log. Bytes: %lu\n", buffer->size);
+    }
+    _remapCommittedDA(pDA, buffer->array, length);
+
+    clearDA(pDA->walRanges);
+    pDA->walPending = 0;
+    committed = true;
+  }
+
+  return committed;
+}
+
+size_t hugePagesDA(const dynArray *pDA) {
+  size_t bytes = 0;
+  size_t from = (size_t)pDA->array;
+  size_t to = from + _mappedBytesDA(pDA->capacity, pDA->elementSize);
+  FILE *fp = pDA->mapped ? fopen("/proc/self/smaps", "r") : NULL;
+
+  if (fp != NULL) {
+    char line[FILE_BUFFER];
+    bool inside = false;
+    size_t start, end, kb;
+    // the map may be split, so every mapping within the array is counted
+    while (fgets(line, FILE_BUFFER, fp) != NULL) {
+      if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+        inside = start < to && end > from;
+      } else if (inside && sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+        bytes += kb * 1024;
+      }
+    }
+    fclose(fp);
+  }
+
+  return bytes;
+}
+
+bool verifyDA(const dynArray *pDA) {
+  bool valid = pDA->fp != NULL && pDA->checksumBlock > 0;
+  size_t bytes = pDA->size * pDA->elementSize;
+  size_t blocks = valid ? (bytes + pDA->checksumBlock - 1) / pDA->checksumBlock
+                        : 0;
+  uint32_t sums[FILE_BUFFER];
+  off_t pos = valid ? _checksumOffsetDA(pDA) : 0;
+
+  valid = valid && pDA->checksums == blocks;
+  for (size_t b = 0; valid && b < blocks;) {
+    size_t batch = (blocks - b < FILE_BUFFER) ? blocks - b : FILE_BUFFER;
+    valid = pread(fileno(pDA->fp), sums, batch * sizeof(uint32_t), pos) ==
+            batch * sizeof(uint32_t);
+    for (size_t i = 0; valid && i < batch; i++, b++) {
+      size_t from = b * pDA->checksumBlock;
+      size_t len =
+          (bytes - from < pDA->checksumBlock) ? bytes - from : pDA->checksumBlock;
+      valid = sums[i] == crc32c(pDA->array + from, len, 0);
+    }
+    pos += batch * sizeof(uint32_t);
   }
+
+  return valid;
 }
 
 size_t searchDA(dynArray *pDA, const void *value,
@@ -232,39 +1171,132 @@ size_t searchDA(dynArray *pDA, const void *value,
   return found;
 }
 
-dynArray *loadDA(const char *filename,
-                 int compare(const void *a, const void *b)) {
+dynArrayArena *createArenaDA(const size_t capacity) {
+  dynArrayArena *arena = _safeCalloc(1, sizeof(dynArrayArena));
+  arena->capacity = (capacity < 1) ? 1 : capacity;
+  // each array clears what it carves, so the regions are not zeroed
+  arena->region = _safeReallocarray(NULL, 1, arena->capacity);
+  arena->used = 0;
+  arena->next = NULL;
+  return arena;
+}
+
+void resetArenaDA(dynArrayArena *arena) {
+  if (arena) {
+    if (arena->next != NULL) {
+      // fold the overflow regions into one to fit the next cycle
+      size_t total = arena->capacity;
+      for (dynArrayArena *full = arena->next; full; full = full->next) {
+        total += full->capacity;
+      }
+      _freeArenaChainDA(arena->next);
+      free(arena->region);
+      arena->region = _safeReallocarray(NULL, 1, total);
+      arena->capacity = total;
+      arena->next = NULL;
+    }
+    arena->used = 0;
+  }
+}
+
+void freeArenaDA(dynArrayArena *arena) {
+  if (arena) {
+    _freeArenaChainDA(arena->next);
+    free(arena->region);
+    free(arena);
+  }
+}
+
+/**
+ * @private
+ */
+dynArray *_openFileDA(const char *filename,
+                      int compare(const void *a, const void *b),
+                      const bool writeBack, const bool directIO) {
   dynArray *pDA;
+  fileHeader header = {0};
+  struct stat st;
+
+  // replay any log left by a crash before reading the header
+  bool recovered = _recoverDA(filename);
 
   pDA = _safeCalloc(1, sizeof(dynArray));
-  pDA->fp = fopen(filename, "a+");
+  pDA->fp = fopen(filename, "r+");
 
   pDA->compare = compare;
   pDA->parent = NULL;
 
-  // load the file
-  int fd = fileno(pDA->fp);
-  void *map =
-      mmap(NULL, sizeof(fileHeader), PROT_WRITE | PROT_READ, MAP_SHARED, fd, 0);
-  if (map == MAP_FAILED) {
-    EXIT_ERROR("Error creating memory map file. Capacity: %lu\n",
-               sizeof(fileHeader));
+  // read and validate the header before mapping, older files may be shorter
+  // than the full header
+  int fd = (pDA->fp != NULL) ? fileno(pDA->fp) : -1;
+  bool valid = fd != -1 && fstat(fd, &st) == 0 &&
+               pread(fd, &header, sizeof(fileHeader), 0) >=
+                   FILE_HEADER_V1_SIZE &&
+               _updateFromHeader(pDA, &header, st.st_size);
+
+  if (valid && writeBack) {
+    // read the whole image, the file has at least the capacity
+    void *image = _safeAlignedAlloc(FLUSH_PAGE, 1, _imageBytesDA(pDA), true);
+    size_t length = pDA->offset + (pDA->capacity * pDA->elementSize);
+    ssize_t rtn = 1;
+    for (size_t pos = 0; rtn > 0 && pos < length; pos += rtn) {
+      rtn = pread(fd, image + pos, length - pos, pos);
+    }
+    valid = rtn > 0;
+    pDA->array = image + pDA->offset;
+    if (valid) {
+      pDA->flusher = _createFlusherDA(pDA->fp, filename, directIO);
+    } else {
+      free(image);
+    }
+  } else if (valid) {
+    // map the whole file
+    pDA->array =
+        _safeMMap(pDA->fp, pDA->offset, pDA->capacity, pDA->elementSize);
+    if (pDA->version == 3 && (header.flags & FILE_FLAG_WAL)) {
+      size_t batch = header.flags >> FILE_WAL_BATCH_SHIFT;
+      _openWalDA(pDA, filename, (batch > 0) ? batch : WAL_BATCH);
+    }
   }
-  _updateFromHeader(pDA, (fileHeader *)map);
-  pDA->array = map + sizeof(fileHeader);
 
-  pDA->temp = _safeCalloc(1, pDA->size);
+  if (valid) {
+    pDA->temp = _safeCalloc(1, pDA->elementSize);
+    if (recovered) {
+      // the stored checksums do not cover the replayed writes
+      syncDAMap(pDA);
+    }
+  } else {
+    DEBUG_LOG("Error invalid memory map file: %s\n", filename);
+    if (pDA->fp != NULL) {
+      fclose(pDA->fp);
+    }
+    free(pDA);
+    pDA = NULL;
+  }
 
   return pDA;
 }
 
+dynArray *loadDA(const char *filename,
+                 int compare(const void *a, const void *b)) {
+  return _openFileDA(filename, compare, false, false);
+}
+
+dynArray *readDA(const char *filename,
+                 int compare(const void *a, const void *b),
+                 const bool directIO) {
+  return _openFileDA(filename, compare, true, directIO);
+}
+
 dynArray *createDA(const size_t elementSize,
                    int compare(const void *a, const void *b),
                    dynArrayParams *params) {
   dynArray *pDA;
+  dynArrayParams defaults =
+      (dynArrayParams){.size = 0, .growth = 1.5, .capacity = 10};
 
   if (params == NULL) {
-    params = &((dynArrayParams){.size = 0, .growth = 1.5, .capacity = 10});
+    params = &defaults;
   }
 
   if (params->growth <= 1.0) {
@@ -274,24 +1306,91 @@ dynArray *createDA(const size_t elementSize,
     params->capacity = params->size;
   }
 
-  pDA = _safeCalloc(1, sizeof(dynArray));
+  size_t capacity = (params->capacity) < 1 ? 1 : params->capacity;
+  size_t alignment =
+      _normaliseAlignmentDA(params->alignment, params->filename != NULL);
+  bool shared = params->filename == NULL && params->snapshots;
+  bool mapped = params->filename == NULL && !shared &&
+                (params->hugePages || params->numaNodes != 0);
+  bool carved = params->filename == NULL && !mapped && !shared &&
+                (params->arena != NULL || params->inlineStorage);
+  size_t inlineBytes = 0;
+
+  if (carved) {
+    // the struct, temp store and initial array share a single allocation
+    size_t head = _alignUpDA(sizeof(dynArray));
+    size_t temp = _alignUpDA(elementSize);
+    inlineBytes = head + temp + alignment + (capacity * elementSize);
+
+    pDA = (params->arena != NULL)
+              ? _arenaAllocDA(params->arena, inlineBytes)
+              : _safeReallocarray(NULL, 1, inlineBytes);
+    memset(pDA, 0, params->noZeroInit ? head + temp : inlineBytes);
+    pDA->temp = (void *)pDA + head;
+    pDA->array = (void *)_alignToDA((size_t)(pDA->temp + temp), alignment);
+    pDA->arena = params->arena;
+    pDA->inlined = params->arena == NULL;
+    pDA->carved = true;
+  } else {
+    pDA = _safeCalloc(1, sizeof(dynArray));
+  }
+
   if (params->filename != NULL) {
+    // a log left by an earlier file must not be replayed over this one
+    char walName[strlen(params->filename) + sizeof(WAL_SUFFIX)];
+    _walNameDA(walName, params->filename);
+    remove(walName);
     pDA->fp = fopen(params->filename, "w+");
   } else {
     pDA->fp = NULL;
   }
 
-  pDA->capacity = (params->capacity) < 1 ? 1 : params->capacity;
+  pDA->capacity = capacity;
+  pDA->alignment = alignment;
   pDA->growth = params->growth;
   pDA->size = params->size;
   pDA->elementSize = elementSize;
   pDA->compare = compare;
-  pDA->temp = _safeCalloc(1, elementSize);
-  if (pDA->fp == NULL) {
-    pDA->array = _safeCalloc(pDA->capacity, elementSize);
-  } else {
-    pDA->array = _safeMMap(pDA->fp, pDA->capacity, elementSize);
-    _updateMMap(pDA);
+  if (!carved) {
+    pDA->temp = _safeCalloc(1, elementSize);
+    if (shared) {
+      size_t bytes = _sharedBytesDA(pDA->capacity, elementSize);
+      pDA->shared = _createSharedDA(bytes);
+      pDA->array = _safeSharedMMap(pDA->shared, bytes);
+    } else if (mapped) {
+      pDA->mapped = true;
+      pDA->hugePages = params->hugePages;
+      pDA->numaNodes = params->numaNodes;
+      pDA->numaInterleave = params->numaInterleave;
+      pDA->array = _safeAnonMMap(pDA, pDA->capacity, elementSize);
+    } else if (pDA->fp == NULL && alignment <= sizeof(max_align_t)) {
+      pDA->array = params->noZeroInit
+                       ? _safeReallocarray(NULL, pDA->capacity, elementSize)
+                       : _safeCalloc(pDA->capacity, elementSize);
+    } else if (pDA->fp == NULL) {
+      pDA->array = _safeAlignedAlloc(alignment, pDA->capacity, elementSize,
+                                     !params->noZeroInit);
+    } else {
+      pDA->version = FILE_VERSION;
+      pDA->offset = _dataOffsetDA(alignment);
+      pDA->checksumBlock = params->checksumBlock;
+      if (params->writeBack) {
+        pDA->array = _safeAlignedAlloc(FLUSH_PAGE, 1, _imageBytesDA(pDA), true) +
+                     pDA->offset;
+        pDA->flusher =
+            _createFlusherDA(pDA->fp, params->filename, params->directIO);
+      } else {
+        pDA->array =
+            _safeMMap(pDA->fp, pDA->offset, pDA->capacity, elementSize);
+      }
+      _updateMMap(pDA);
+      if (pDA->flusher != NULL) {
+        // write the header so the file can be loaded straight away
+        syncDAMap(pDA);
+      } else if (params->walBatch > 0) {
+        _openWalDA(pDA, params->filename, params->walBatch);
+      }
+    }
   }
   pDA->parent = NULL;
   return pDA;
@@ -299,6 +1398,7 @@ dynArray *createDA(const size_t elementSize,
 
 void sortDA(dynArray *pDA, int compare(const void *a, const void *b)) {
   _quickSort(pDA, 0, pDA->size - 1, compare ? compare : pDA->compare);
+  logDA(pDA, 0, pDA->size);
 }
 
 bool addArrayDA(dynArray *pDA, const void *src, const size_t length) {
@@ -311,6 +1411,7 @@ bool addArrayDA(dynArray *pDA, const void *src, const size_t length) {
 
     void *dest = _toPtr(pDA, lastIndex);
     memcpy(dest, src, pDA->elementSize * length);
+    logDA(pDA, lastIndex, length);
 
     added = true;
   }
@@ -318,6 +1419,128 @@ bool addArrayDA(dynArray *pDA, const void *src, const size_t length) {
   return added;
 }
 
+bool insertArrayDA(dynArray *pDA, const size_t index, const void *src,
+                   const size_t length) {
+  bool inserted = false;
+  if (pDA->parent == NULL && index <= pDA->size) {
+    size_t tail = pDA->size - index;
+    pDA->size += length;
+
+    _extendCapacityDA(pDA);
+
+    void *dest = _toPtr(pDA, index);
+    memmove(dest + (length * pDA->elementSize), dest,
+            tail * pDA->elementSize);
+    memcpy(dest, src, length * pDA->elementSize);
+    logDA(pDA, index, length + tail);
+
+    inserted = true;
+  }
+
+  return inserted;
+}
+
+bool eraseRangeDA(dynArray *pDA, const size_t min, const size_t max) {
+  bool erased = false;
+  if (pDA->parent == NULL && min <= max && max < pDA->size) {
+    size_t tail = pDA->size - max - 1;
+    memmove(_toPtr(pDA, min), _toPtr(pDA, max + 1), tail * pDA->elementSize);
+    pDA->size -= max - min + 1;
+    logDA(pDA, min, tail);
+
+    erased = true;
+  }
+
+  return erased;
+}
+
+size_t removeIfDA(dynArray *pDA, bool remove(const void *entry, void *ref),
+                  void *ref) {
+  size_t removed = 0;
+
+  if (pDA->parent == NULL) {
+    size_t limit = pDA->size;
+    size_t kept = 0;
+    // everything before the first removal stays where it is
+    for (; kept < limit && !remove(_toPtr(pDA, kept), ref); kept++) {
+    }
+    size_t first = kept;
+    for (size_t i = first + 1; i < limit; i++) {
+      void *entry = _toPtr(pDA, i);
+      if (!remove(entry, ref)) {
+        memcpy(_toPtr(pDA, kept), entry, pDA->elementSize);
+        kept++;
+      }
+    }
+    if (kept < limit) {
+      pDA->size = kept;
+      logDA(pDA, first, kept - first);
+    }
+    removed = limit - kept;
+  }
+
+  return removed;
+}
+
+bool reserveDA(dynArray *pDA, const size_t capacity) {
+  bool reserved = false;
+  if (pDA->parent == NULL) {
+    if (capacity > pDA->capacity) {
+      size_t cap = pDA->capacity;
+      pDA->capacity = capacity;
+      _reallocStorageDA(pDA, cap);
+      logDA(pDA, 0, 0);
+    }
+    reserved = true;
+  }
+  return reserved;
+}
+
+bool resizeDA(dynArray *pDA, const size_t size, const void *init) {
+  bool resized = false;
+  if (pDA->parent == NULL) {
+    size_t lastIndex = pDA->size;
+    pDA->size = size;
+
+    _extendCapacityDA(pDA);
+
+    if (init != NULL && size > lastIndex) {
+      // seed one element then double the initialised span
+      void *dest = _toPtr(pDA, lastIndex);
+      size_t done = 1, todo = size - lastIndex;
+      memcpy(dest, init, pDA->elementSize);
+      while (done < todo) {
+        size_t chunk = (done < todo - done) ? done : todo - done;
+        memcpy(dest + (done * pDA->elementSize), dest,
+               chunk * pDA->elementSize);
+        done += chunk;
+      }
+    }
+    logDA(pDA, lastIndex,
+          (init != NULL && size > lastIndex) ? size - lastIndex : 0);
+
+    resized = true;
+  }
+  return resized;
+}
+
+void *emplaceArrayDA(dynArray *pDA, const size_t length) {
+  void *slots = NULL;
+  if (pDA->parent == NULL) {
+    size_t lastIndex = pDA->size;
+    pDA->size += length;
+
+    _extendCapacityDA(pDA);
+
+    slots = _toPtr(pDA, lastIndex);
+    logDA(pDA, lastIndex, length);
+  }
+
+  return slots;
+}
+
+void *emplaceDA(dynArray *pDA) { return emplaceArrayDA(pDA, 1); }
+
 void *addDA(dynArray *pDA, const void *value) {
   void *rtn;
   if (pDA->parent == NULL) {
@@ -334,6 +1557,7 @@ bool setDA(dynArray *pDA, const size_t index, const void *value) {
 
   if (index >= 0 && index < pDA->size) {
     memcpy(pDA->array + (index * pDA->elementSize), value, pDA->elementSize);
+    logDA(pDA, index, 1);
   } else {
     DEBUG_LOG("Index out of range: %ld, array size: %ld\n", index, pDA->size);
     ok = false;
@@ -358,23 +1582,104 @@ void reverseDA(dynArray *pDA) {
   for (size_t i = 0; i < half; i++) {
     _swap(pDA, _toPtr(pDA, i), _toPtr(pDA, pDA->size - i - 1));
   }
+  logDA(pDA, 0, pDA->size);
 }
 
 void reduceMemDA(dynArray *pDA) {
-  if (pDA && pDA->capacity > pDA->size) {
-    pDA->capacity = pDA->size;
-    pDA->array = _safeReallocarray(pDA->array, pDA->capacity, pDA->elementSize);
+  if (pDA && pDA->parent == NULL && pDA->capacity > pDA->size &&
+      pDA->arena == NULL && !pDA->inlined) {
+    size_t cap = pDA->capacity;
+    pDA->capacity = (pDA->size < 1) ? 1 : pDA->size;
+    _reallocStorageDA(pDA, cap);
+    logDA(pDA, 0, 0);
   }
 }
 
-dynArray *copyDA(const dynArray *pDA) {
-  dynArray *copy =
-      createDA(pDA->elementSize, pDA->compare,
-               &(dynArrayParams){.size = pDA->size, .growth = pDA->growth});
-  memcpy(copy->array, pDA->array, pDA->size * pDA->elementSize);
+/**
+ * @private
+ */
+bool _copyFileRangeDA(const dynArray *pDA, dynArray *copy) {
+  // only shared mappings keep the file current with the array
+  bool plain = pDA->parent == NULL && pDA->fp != NULL && pDA->wal == NULL &&
+               pDA->flusher == NULL && copy->fp != NULL &&
+               copy->wal == NULL && copy->flusher == NULL;
+  size_t length = pDA->size * pDA->elementSize;
+  loff_t from = pDA->offset;
+  loff_t to = copy->offset;
+  ssize_t rtn = 1;
+
+  while (plain && rtn > 0 && from < (loff_t)(pDA->offset + length)) {
+    rtn = copy_file_range(fileno(pDA->fp), &from, fileno(copy->fp), &to,
+                          pDA->offset + length - from, 0);
+  }
+  return plain && rtn > 0;
+}
+
+dynArray *cloneDA(const dynArray *pDA, const dynArrayParams *params) {
+  dynArrayParams cloneParams = (params != NULL) ? *params : (dynArrayParams){};
+
+  // the live elements are copied over, so there is nothing to zero
+  cloneParams.size = pDA->size;
+  cloneParams.noZeroInit = true;
+  if (cloneParams.capacity < pDA->capacity) {
+    cloneParams.capacity = pDA->capacity;
+  }
+  if (cloneParams.growth <= 1.0) {
+    cloneParams.growth = pDA->growth;
+  }
+
+  dynArray *copy = createDA(pDA->elementSize, pDA->compare, &cloneParams);
+  if (pDA->size > 0 && !_copyFileRangeDA(pDA, copy)) {
+    memcpy(copy->array, pDA->array, pDA->size * pDA->elementSize);
+    logDA(copy, 0, pDA->size);
+  }
   return copy;
 }
 
+dynArray *copyDA(const dynArray *pDA) { return cloneDA(pDA, NULL); }
+
+dynArray *snapshotDA(dynArray *pDA) {
+  dynArray *snap;
+
+  if (pDA->shared != NULL && !pDA->frozen) {
+    size_t bytes = _sharedBytesDA(pDA->capacity, pDA->elementSize);
+    if (pDA->shared->references > 1) {
+      // older snapshots still map the shared pages, so move to new ones
+      dynArrayShared *shared = _createSharedDA(bytes);
+      if (!_pwriteAllDA(shared->fd, pDA->array, bytes, 0)) {
+        EXIT_ERROR("Error copying shared memory. Capacity: %lu\n", bytes);
+      }
+      _releaseSharedDA(pDA->shared);
+      pDA->shared = shared;
+    } else {
+      _writeBackSharedDA(pDA, bytes);
+    }
+
+    // the private copies are now shared, so drop them from the writer
+    if (mmap(pDA->array, bytes, PROT_WRITE | PROT_READ,
+             MAP_PRIVATE | MAP_FIXED, pDA->shared->fd, 0) == MAP_FAILED) {
+      EXIT_ERROR("Error mapping shared memory. Capacity: %lu\n", bytes);
+    }
+
+    snap = _safeCalloc(1, sizeof(dynArray));
+    snap->elementSize = pDA->elementSize;
+    snap->size = pDA->size;
+    snap->capacity = pDA->capacity;
+    snap->growth = pDA->growth;
+    snap->compare = pDA->compare;
+    snap->alignment = pDA->alignment;
+    snap->temp = _safeCalloc(1, pDA->elementSize);
+    snap->array = _safeSharedMMap(pDA->shared, bytes);
+    snap->shared = pDA->shared;
+    snap->frozen = true;
+    pDA->shared->references++;
+  } else {
+    snap = copyDA(pDA);
+  }
+
+  return snap;
+}
+
 dynArray *subDA(dynArray *pDA, const size_t min, const size_t max) {
   dynArray *sub = NULL;
   if (max > min && max < pDA->size) {
@@ -393,6 +1698,98 @@ dynArray *subDA(dynArray *pDA, const size_t min, const size_t max) {
   return sub;
 }
 
+/**
+ * @private
+ */
+static inline void _checkViewDA(const dynArrayView *view) {
+#ifdef DEBUG
+  if (view->parent != NULL && !validViewDA(view)) {
+    EXIT_ERROR("Stale view of array. Generation: %lu\n", view->generation);
+  }
+#endif
+}
+
+/**
+ * @private
+ */
+static inline dynArray _viewArrayDA(const dynArrayView *view, void *temp) {
+  // a sub array on the stack, so changes are logged against the parent
+  return (dynArray){.elementSize = view->elementSize,
+                    .size = view->size,
+                    .array = view->array,
+                    .temp = temp,
+                    .parent = view->parent,
+                    .compare = (view->parent != NULL) ? view->parent->compare
+                                                      : NULL};
+}
+
+dynArrayView viewDA(dynArray *pDA, const size_t min, const size_t max) {
+  dynArrayView view = {.elementSize = pDA->elementSize};
+
+  // views always refer to the array that owns the storage
+  dynArray *owner = pDA;
+  while (owner->parent != NULL) {
+    owner = (dynArray *)owner->parent;
+  }
+  if (min <= max && max < pDA->size) {
+    view.array = _toPtr(pDA, min);
+    view.size = max - min + 1;
+    view.parent = owner;
+    view.generation = owner->generation;
+  }
+
+  return view;
+}
+
+bool validViewDA(const dynArrayView *view) {
+  return view->parent != NULL &&
+         view->generation == view->parent->generation &&
+         view->array + (view->size * view->elementSize) <=
+             _toPtr(view->parent, view->parent->size);
+}
+
+void *getViewDA(const dynArrayView *view, const size_t index) {
+  void *entry = NULL;
+  _checkViewDA(view);
+  if (index < view->size) {
+    entry = view->array + (index * view->elementSize);
+  } else {
+    DEBUG_LOG("Index out of range: %ld, view size: %ld\n", index, view->size);
+  }
+  return entry;
+}
+
+void sortViewDA(const dynArrayView *view,
+                int compare(const void *a, const void *b)) {
+  _checkViewDA(view);
+  if (view->size > 0) {
+    char temp[view->elementSize];
+    dynArray sub = _viewArrayDA(view, temp);
+    sortDA(&sub, compare);
+  }
+}
+
+size_t searchViewDA(const dynArrayView *view, const void *value,
+                    int compare(const void *a, const void *b)) {
+  size_t found = -1;
+  _checkViewDA(view);
+  if (view->size > 0) {
+    char temp[view->elementSize];
+    dynArray sub = _viewArrayDA(view, temp);
+    found = searchDA(&sub, value, compare);
+  }
+  return found;
+}
+
+void reverseViewDA(const dynArrayView *view) {
+  _checkViewDA(view);
+  if (view->size > 0) {
+    char temp[view->elementSize];
+    dynArray sub = _viewArrayDA(view, temp);
+    reverseDA(&sub);
+  }
+}
+
 bool appendDA(dynArray *pDA, dynArray *pSrc) {
   bool appended = false;
   if (pDA->elementSize == pSrc->elementSize) {
@@ -404,42 +1801,87 @@ bool appendDA(dynArray *pDA, dynArray *pSrc) {
 void clearDA(dynArray *pDA) {
   if (pDA) {
     pDA->size = 0;
+    logDA(pDA, 0, 0);
   }
 }
 
 void freeDA(dynArray *pDA) {
-  if (pDA) {
-    free(pDA->temp);
+  if (pDA && pDA->arena == NULL) {
+    if (!pDA->carved) {
+      free(pDA->temp);
+    }
     if (pDA->parent == NULL) {
-      if (pDA->fp == NULL) {
+      if (pDA->shared != NULL) {
+        munmap(pDA->array, _sharedBytesDA(pDA->capacity, pDA->elementSize));
+        _releaseSharedDA(pDA->shared);
+      } else if (pDA->mapped) {
+        munmap(pDA->array, _mappedBytesDA(pDA->capacity, pDA->elementSize));
+      } else if (pDA->fp == NULL && !pDA->inlined) {
         free(pDA->array);
       }
     }
     if (pDA->fp != NULL) {
-      _updateMMap(pDA);
-      syncDA(pDA);
+      syncDAMap(pDA);
+      if (pDA->flusher != NULL) {
+        _freeFlusherDA(pDA->flusher);
+        free(pDA->array - pDA->offset);
+      } else {
+        munmap(pDA->array - pDA->offset,
+               pDA->offset + (pDA->capacity * pDA->elementSize));
+      }
       fclose(pDA->fp);
     }
+    if (pDA->wal != NULL) {
+      fclose(pDA->wal);
+      freeDA(pDA->walRanges);
+      freeDA(pDA->walBuffer);
+    }
     free(pDA);
   }
 }
 
 int compareString(const void *a, const void *b) { return strcmp(a, b); }
 
+uint32_t crc32c(const void *input, const size_t length, const uint32_t seed) {
+  uint32_t crc = ~seed;
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("sse4.2")) {
+    return ~_crc32cHard(crc, input, length);
+  }
+#endif // __x86_64__
+  return ~_crc32cSoft(crc, input, length);
+}
+
 void forEachDA(dynArray *pDA, bool call(void *entry, void *ref), void *ref) {
   size_t limit = pDA->size;
   bool cont = true;
   for (size_t i = 0; cont && i < limit; i++) {
-    cont = call(getDA(pDA, i), ref);
+    cont = call(_toPtr(pDA, i), ref);
   }
 }
 
+bool forEachRangeDA(dynArray *pDA,
+                    bool call(void *begin, size_t count, void *ref), void *ref,
+                    size_t chunk) {
+  size_t limit = pDA->size;
+  bool cont = true;
+  if (chunk == 0) {
+    chunk = (limit > 0) ? limit : 1;
+  }
+  for (size_t i = 0; cont && i < limit; i += chunk) {
+    cont = call(_toPtr(pDA, i), (limit - i < chunk) ? limit - i : chunk, ref);
+  }
+  return cont;
+}
+
 bool readHeaderDA(dynArray *pDA, fileHeader *header) {
   bool read = false;
 
   if (pDA->fp != NULL) {
-    const fileHeader *src = (fileHeader *)(pDA->array - sizeof(fileHeader));
-    *header = *src;
+    // older headers end where the newer fields start
+    memset(header, 0, sizeof(fileHeader));
+    memcpy(header, pDA->array - pDA->offset, _headerSizeDA(pDA->version));
+    read = true;
   }
 
   return read;
@@ -449,8 +1891,11 @@ bool saveHeaderBufferDA(dynArray *pDA, char buffer[]) {
   bool read = false;
 
   if (pDA->fp != NULL) {
-    fileHeader *header = (fileHeader *)(pDA->array - sizeof(fileHeader));
+    fileHeader *header = (fileHeader *)(pDA->array - pDA->offset);
     memcpy(header->buffer, buffer, FILE_BUFFER);
+    _updateMMap(pDA);
+    logDA(pDA, 0, 0);
+    read = true;
   }
 
   return read;
@@ -2,7 +2,14 @@
 #define DYNARRAY_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /**
  * @file dynarray.h
@@ -48,6 +55,66 @@
 
 #define FILE_BUFFER 255
 
+/**
+ * @brief The file header version written for new files
+ */
+#define FILE_VERSION 3
+
+/**
+ * @brief The file magic number, "DYNA" when read as bytes
+ */
+#define FILE_MAGIC 0x414E5944U
+
+/**
+ * @brief The byte order mark, stored in the writer's byte order
+ */
+#define FILE_ENDIAN 0x01020304U
+
+/**
+ * @brief File flag set when block checksums are stored after the data
+ */
+#define FILE_FLAG_CHECKSUM 0x1U
+
+/**
+ * @brief File flag set while the array is written through a write ahead log
+ */
+#define FILE_FLAG_WAL 0x4U
+
+/**
+ * @brief The shift of the group commit size kept in the upper file flags
+ *
+ * Files written through a log keep their walBatch, up to 0xFFFF, so loaded
+ * arrays continue with it.
+ */
+#define FILE_WAL_BATCH_SHIFT 16
+
+/**
+ * @brief The write ahead log filename suffix, appended to the array filename
+ */
+#define WAL_SUFFIX ".wal"
+
+/**
+ * @brief The write ahead log group commit size for loaded files without one
+ */
+#define WAL_BATCH 64
+
+/**
+ * @brief The default element buffer alignment of heap arrays, as from
+ * malloc(), so they grow with realloc()
+ */
+#define DEFAULT_ALIGNMENT sizeof(max_align_t)
+
+/**
+ * @brief A cache line element buffer alignment, the default for memory mapped
+ * files and for other arrays that ask for it
+ */
+#define CACHE_LINE_ALIGNMENT 64
+
+/**
+ * @brief The region alignment for huge page backed arrays
+ */
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+
 /**
  * @brief Dynamic array file header
  */
@@ -58,8 +125,40 @@ typedef struct FileHeader {
   size_t capacity;    ///< the array capacity
   float growth;       ///< the array growth rate
   char buffer[FILE_BUFFER];   ///< header buffer space
+  size_t offset;      ///< the data offset in the file, from version 2
+  size_t alignment;   ///< the data alignment, from version 2
+  uint32_t magic;     ///< the file magic number, from version 3
+  uint32_t endian;    ///< the writer's byte order mark, from version 3
+  uint32_t flags;     ///< the file flags, from version 3
+  uint32_t blockSize; ///< the checksum block size in bytes, from version 3
+  uint64_t blocks;    ///< the number of stored block checksums, from version 3
+  uint32_t checksum;  ///< the CRC32C of the preceding header, from version 3
 } fileHeader;
 
+/**
+ * @brief The size of a version 1 file header, which has no layout fields
+ */
+#define FILE_HEADER_V1_SIZE offsetof(fileHeader, offset)
+
+/**
+ * @brief The size of a version 2 file header, which has no validation fields
+ */
+#define FILE_HEADER_V2_SIZE offsetof(fileHeader, magic)
+
+/**
+ * @brief Dynamic array arena
+ *
+ * Arrays created with an arena carve their struct, temp store and element
+ * storage from a shared region. Individual arrays are not released by freeDA(),
+ * instead all arrays in the arena are released at once by resetArenaDA().
+ */
+typedef struct DynamicArrayArena {
+  void *region;                   ///< the current region
+  size_t capacity;                ///< the current region size in bytes
+  size_t used;                    ///< the bytes used in the current region
+  struct DynamicArrayArena *next; ///< the previous full region or NULL
+} dynArrayArena;
+
 /**
  * @brief Dynamic array entity
  */
@@ -74,8 +173,44 @@ typedef struct DynamicArray {
   int (*compare)(const void *a,
                  const void *b); ///< the default comparator function
   FILE *fp; ///< the memory mapped file pointer or NULL if not used
+  dynArrayArena *arena; ///< the arena the array is carved from or NULL
+  bool inlined;         ///< 'true' while the array uses the inline storage
+  bool carved;          ///< 'true' if the struct and temp store are carved
+  bool mapped;          ///< 'true' if the array is an anonymous memory map
+  bool hugePages;       ///< 'true' if huge pages are requested for the map,
+                        ///< see hugePagesDA()
+  unsigned long numaNodes; ///< the NUMA node mask for the map or 0
+  bool numaInterleave;     ///< 'true' to interleave the map across the nodes
+  size_t alignment;        ///< the element buffer alignment
+  size_t offset;           ///< the data offset in the memory mapped file
+  size_t version;          ///< the memory mapped file header version
+  size_t checksumBlock;    ///< the checksum block size in bytes or 0
+  size_t checksums;        ///< the number of stored block checksums
+  FILE *wal;         ///< the write ahead log file pointer or NULL if not used
+  size_t walBatch;   ///< the write operations per group commit
+  size_t walPending; ///< the write operations since the last commit
+  size_t walDepth;   ///< the open write groups, see beginWriteDA()
+  struct DynamicArray *walRanges; ///< the element ranges to commit
+  struct DynamicArray *walBuffer; ///< the commit batch buffer
+  struct DynamicArrayFlusher
+      *flusher; ///< the write back engine or NULL if the file is mapped
+  struct DynamicArrayShared
+      *shared; ///< the pages shared with snapshots or NULL if not used
+  bool frozen; ///< 'true' if the array is a snapshot of the shared pages
+  size_t generation; ///< incremented each time the storage moves
 } dynArray;
 
+/**
+ * @brief A slice of an array, small enough to pass by value
+ */
+typedef struct DynamicArrayView {
+  void *array;        ///< the first element of the view
+  size_t size;        ///< the number of elements in the view
+  size_t elementSize; ///< the element size in bytes
+  dynArray *parent;   ///< the array owning the storage, NULL if empty
+  size_t generation;  ///< the parent generation when the view was taken
+} dynArrayView;
+
 /**
  * @brief Basic type comparator function declaration macro
  *
@@ -103,6 +238,158 @@ typedef struct DynamicArray {
     return (*(TYPE *)a < *(TYPE *)b) ? -1 : (*(TYPE *)a > *(TYPE *)b) ? 1 : 0; \
   }
 
+#ifdef DEBUG
+/**
+ * @brief Typed accessor range check, only in debug builds
+ */
+#define TYPED_RANGE_CHECK(pDA, index)                                          \
+  if ((index) >= (pDA)->size) {                                                \
+    EXIT_ERROR("Index out of range: %ld, array size: %ld\n", (index),         \
+               (pDA)->size);                                                   \
+  }
+#else
+/**
+ * @brief Typed accessor range check, only in debug builds
+ */
+#define TYPED_RANGE_CHECK(pDA, index)
+#endif // DEBUG
+
+/**
+ * @brief The range below which the typed sort switches to insertion sort
+ */
+#define TYPED_SORT_CUTOFF 16
+
+/**
+ * @brief Typed array function declaration macro
+ *
+ * Generates accessors for arrays created with an element size of
+ * sizeof(TYPE), which index the storage as TYPE and so avoid the element size
+ * multiply and memcpy. The accessors are inline and have no range checks
+ * outside debug builds:
+ *
+ * bool pushDA<TYPE>(dynArray *pDA, TYPE value)
+ * TYPE getDA<TYPE>(const dynArray *pDA, size_t index)
+ * void setDA<TYPE>(dynArray *pDA, size_t index, TYPE value)
+ *
+ * Along with sortDA<TYPE>() and searchDA<TYPE>(), which compare with the
+ * built in operators rather than a comparator, see DEFINE_TYPED_DA().
+ *
+ * @param TYPE the element type, a single word such as long or a typedef
+ */
+#define DECLARE_TYPED_DA(TYPE)                                                 \
+  static inline bool pushDA##TYPE(dynArray *pDA, TYPE value) {                \
+    bool added = true;                                                         \
+    if (pDA->parent == NULL && pDA->size < pDA->capacity) {                    \
+      ((TYPE *)pDA->array)[pDA->size] = value;                                 \
+      if (pDA->wal != NULL) {                                                  \
+        logDA(pDA, pDA->size, 1);                                              \
+      }                                                                        \
+      pDA->size++;                                                             \
+    } else {                                                                   \
+      added = addArrayDA(pDA, &value, 1);                                      \
+    }                                                                          \
+    return added;                                                              \
+  }                                                                            \
+  static inline TYPE getDA##TYPE(const dynArray *pDA, const size_t index) {    \
+    TYPED_RANGE_CHECK(pDA, index);                                             \
+    return ((const TYPE *)pDA->array)[index];                                  \
+  }                                                                            \
+  static inline void setDA##TYPE(dynArray *pDA, const size_t index,            \
+                                 TYPE value) {                                 \
+    TYPED_RANGE_CHECK(pDA, index);                                             \
+    ((TYPE *)pDA->array)[index] = value;                                       \
+    if (pDA->wal != NULL || pDA->parent != NULL) {                             \
+      logDA(pDA, index, 1);                                                    \
+    }                                                                          \
+  }                                                                            \
+  void sortDA##TYPE(dynArray *pDA);                                            \
+  size_t searchDA##TYPE(dynArray *pDA, TYPE value);
+
+/**
+ * @brief Typed array function definition macro
+ *
+ * Defines the sort and search functions declared by DECLARE_TYPED_DA(). The
+ * sort is a quicksort with a median of three pivot that finishes small ranges
+ * with an insertion sort, and orders elements the same as
+ * sortDA(pDA, compareDA<TYPE>).
+ *
+ * @param TYPE the element type
+ */
+#define DEFINE_TYPED_DA(TYPE)                                                  \
+  static void _sortDA##TYPE(TYPE *a, size_t low, size_t high) {               \
+    while (high - low > TYPED_SORT_CUTOFF) {                                   \
+      size_t mid = low + ((high - low) / 2);                                   \
+      TYPE t;                                                                  \
+      if (a[mid] < a[low]) {                                                   \
+        t = a[mid], a[mid] = a[low], a[low] = t;                               \
+      }                                                                        \
+      if (a[high] < a[low]) {                                                  \
+        t = a[high], a[high] = a[low], a[low] = t;                             \
+      }                                                                        \
+      if (a[high] < a[mid]) {                                                  \
+        t = a[high], a[high] = a[mid], a[mid] = t;                             \
+      }                                                                        \
+      TYPE pivot = a[mid];                                                     \
+      size_t i = low, j = high;                                                \
+      while (i <= j) {                                                         \
+        while (a[i] < pivot) {                                                 \
+          i++;                                                                 \
+        }                                                                      \
+        while (pivot < a[j]) {                                                 \
+          j--;                                                                 \
+        }                                                                      \
+        if (i <= j) {                                                          \
+          t = a[i], a[i] = a[j], a[j] = t;                                     \
+          i++;                                                                 \
+          j--;                                                                 \
+        }                                                                      \
+      }                                                                        \
+      /* recurse into the smaller side to bound the stack */                   \
+      if (j - low < high - i) {                                                \
+        _sortDA##TYPE(a, low, j);                                              \
+        low = i;                                                               \
+      } else {                                                                 \
+        _sortDA##TYPE(a, i, high);                                             \
+        high = j;                                                              \
+      }                                                                        \
+    }                                                                          \
+    for (size_t i = low + 1; i <= high; i++) {                                 \
+      TYPE value = a[i];                                                       \
+      size_t j = i;                                                            \
+      for (; j > low && value < a[j - 1]; j--) {                               \
+        a[j] = a[j - 1];                                                       \
+      }                                                                        \
+      a[j] = value;                                                            \
+    }                                                                          \
+  }                                                                            \
+  void sortDA##TYPE(dynArray *pDA) {                                           \
+    if (pDA->size > 1) {                                                       \
+      _sortDA##TYPE((TYPE *)pDA->array, 0, pDA->size - 1);                     \
+      logDA(pDA, 0, pDA->size);                                                \
+    }                                                                          \
+  }                                                                            \
+  size_t searchDA##TYPE(dynArray *pDA, TYPE value) {                          \
+    const TYPE *a = (const TYPE *)pDA->array;                                  \
+    size_t low = 1;                                                            \
+    /* sort only if not already in order */                                    \
+    for (; low < pDA->size && !(a[low] < a[low - 1]); low++) {                 \
+    }                                                                          \
+    if (low < pDA->size) {                                                     \
+      sortDA##TYPE(pDA);                                                       \
+    }                                                                          \
+    size_t high = pDA->size;                                                   \
+    low = 0;                                                                   \
+    while (low < high) {                                                       \
+      size_t mid = low + ((high - low) / 2);                                   \
+      if (a[mid] < value) {                                                    \
+        low = mid + 1;                                                         \
+      } else {                                                                 \
+        high = mid;                                                            \
+      }                                                                        \
+    }                                                                          \
+    return (low < pDA->size && !(value < a[low])) ? low : (size_t)-1;          \
+  }
+
 /**
  * @brief Dynamic array creation parameters
  */
@@ -112,11 +399,40 @@ typedef struct DynamicArrayParams {
   size_t capacity; ///< the initial reserved capacity for the array
   char
       *filename; ///< the filename for the memory mapped file if used, else NULL
+  dynArrayArena *arena; ///< the arena to carve the array from or NULL
+  bool inlineStorage;   ///< allocate the initial capacity with the array
+  bool noZeroInit; ///< leave the initial elements uninitialised
+  bool hugePages;  ///< map the array aligned for transparent huge pages
+  unsigned long numaNodes; ///< the NUMA node mask to place the array on or 0
+  bool numaInterleave;     ///< interleave across the nodes rather than bind
+  size_t alignment; ///< the element buffer alignment or 0 for the default,
+                    ///< DEFAULT_ALIGNMENT or for files CACHE_LINE_ALIGNMENT
+  size_t checksumBlock; ///< the file checksum block size in bytes or 0
+  size_t walBatch; ///< the write ahead log group commit size or 0 for no log
+  bool writeBack;  ///< keep the file image in memory, see flushDA()
+  bool directIO;   ///< bypass the page cache when writing back
+  bool snapshots;  ///< back the array with shared pages for snapshotDA()
 } dynArrayParams;
 
 /**
  * @brief Create a new dynamic array
  *
+ * Memory mapped arrays created with a walBatch write through a log. The file
+ * is mapped privately so uncommitted writes never reach it, and changes are
+ * only applied to the file once their batch is durable in the log. This
+ * removes the synchronous msync from the write path. Modified pages are held
+ * as private memory until their batch is committed, then mapped from the file
+ * again.
+ *
+ * Only marked writes are logged. The array functions mark their writes, but
+ * writes made through a pointer, such as one from getDA() or an iterator,
+ * must be marked with logDA(). Unmarked writes are lost when their page is
+ * next committed or the array is freed.
+ *
+ * Arrays created with writeBack hold the file image in memory instead of
+ * mapping the file, and write it with flushDA(). The log is not used for
+ * write back arrays.
+ *
  * @param elementSize the element size to reserve
  * @param compare the default comparator function
  * @param params a pointer to the dynamic array parameters or NULL for default
@@ -127,19 +443,71 @@ dynArray *createDA(size_t elementSize,
                    int compare(const void *a, const void *b),
                    dynArrayParams *params);
 
+/**
+ * @brief Create a new dynamic array arena
+ *
+ * @param capacity the initial region size in bytes
+ * @return An initialised arena that should be freed with freeArenaDA()
+ */
+dynArrayArena *createArenaDA(size_t capacity);
+
+/**
+ * @brief Release every array carved from the arena
+ *
+ * All arrays created with the arena become invalid. Any overflow regions are
+ * folded into a single region so the next cycle fits without chaining.
+ *
+ * @param arena the arena pointer to reset
+ */
+void resetArenaDA(dynArrayArena *arena);
+
+/**
+ * @brief Free an arena and every array carved from it
+ * @param arena the arena pointer to free
+ */
+void freeArenaDA(dynArrayArena *arena);
+
 /**
  * @brief Load a new dynamic array
  *
+ * Version 1, 2 and 3 files are accepted. The header is validated, including
+ * the magic number, byte order and header checksum for version 3 files, and
+ * the file length is checked against the header before it is mapped.
+ *
+ * Any write ahead log left by a crash is replayed first. Only complete
+ * commits are applied, so the array matches the last commit. Files written
+ * with a log continue to use one, with the group commit size they were
+ * written with, or WAL_BATCH if the file does not record one.
+ *
  * @param filename the filename to load from
  * @param compare the default comparator function
  * @return An initialised dynamic array that should be freed with
- * freeDA()
+ * freeDA(), or NULL if the file could not be opened or is invalid
  */
 dynArray *loadDA(const char *filename,
                  int compare(const void *a, const void *b));
 
+/**
+ * @brief Read a file into a new write back dynamic array
+ *
+ * The file is validated and replayed as for loadDA(), then read into memory
+ * rather than mapped. Changes are written back with flushDA() or
+ * syncDAMap().
+ *
+ * @param filename the filename to read from
+ * @param compare the default comparator function
+ * @param directIO 'true' to bypass the page cache when writing back
+ * @return An initialised dynamic array that should be freed with
+ * freeDA(), or NULL if the file could not be opened or is invalid
+ */
+dynArray *readDA(const char *filename,
+                 int compare(const void *a, const void *b), bool directIO);
+
 /**
  * @brief Free a dynamic array instance
+ *
+ * Arrays carved from an arena are only released by resetArenaDA().
+ *
  * @param pDA the dynamic array pointer to free
  */
 void freeDA(dynArray *pDA);
@@ -147,7 +515,8 @@ void freeDA(dynArray *pDA);
 /**
  * @brief Free extra allocated memory
  *
- * The memory is reallocated if capacity > size.
+ * The memory is reallocated if capacity > size. Arrays carved from an arena
+ * or using inline storage are left unchanged.
  *
  * @param pDA the dynamic array pointer to reduce
  */
@@ -162,6 +531,32 @@ void reduceMemDA(dynArray *pDA);
  */
 bool setDA(dynArray *pDA, const size_t index, const void *value);
 
+/**
+ * @brief Reserve capacity for the array
+ *
+ * The capacity is only ever increased and the new elements are not
+ * initialised. This will only reserve if the array is not a sub-array.
+ *
+ * @param pDA the array pointer to update
+ * @param capacity the minimum capacity to reserve
+ * @return 'true' if the capacity was reserved
+ */
+bool reserveDA(dynArray *pDA, size_t capacity);
+
+/**
+ * @brief Resize the array
+ *
+ * Growing the array follows the growth rate. New elements are set to the init
+ * value, or left uninitialised if init is NULL. This will only resize if the
+ * array is not a sub-array.
+ *
+ * @param pDA the array pointer to update
+ * @param size the new array size
+ * @param init the value to copy into new elements or NULL
+ * @return 'true' if the array was resized
+ */
+bool resizeDA(dynArray *pDA, size_t size, const void *init);
+
 /**
  * @brief Add a dynamic array value
  *
@@ -173,6 +568,31 @@ bool setDA(dynArray *pDA, const size_t index, const void *value);
  */
 void *addDA(dynArray *pDA, const void *value);
 
+/**
+ * @brief Add uninitialised values to be filled in place
+ *
+ * This avoids building a value only to copy it into the array. The slots are
+ * only valid until the array is next resized. With a write ahead log the
+ * slots are logged here, so fill them between beginWriteDA() and endWriteDA()
+ * for the log to commit the filled values. This will only add values if the
+ * array is not a sub-array.
+ *
+ * @param pDA the array pointer to update
+ * @param length the number of values to add
+ * @return a pointer to the first new value, or NULL for a sub-array
+ */
+void *emplaceArrayDA(dynArray *pDA, size_t length);
+
+/**
+ * @brief Add an uninitialised value to be filled in place
+ *
+ * See emplaceArrayDA().
+ *
+ * @param pDA the array pointer to update
+ * @return a pointer to the new value, or NULL for a sub-array
+ */
+void *emplaceDA(dynArray *pDA);
+
 /**
  * @brief Add a dynamic array of values
  *
@@ -185,6 +605,51 @@ void *addDA(dynArray *pDA, const void *value);
  */
 bool addArrayDA(dynArray *pDA, const void *src, size_t length);
 
+/**
+ * @brief Insert a dynamic array of values before an index
+ *
+ * The later elements are moved up in one pass. This will only insert values
+ * if the array is not a sub-array. The source must not point into the array,
+ * as the storage may move.
+ *
+ * @param pDA the array pointer to update
+ * @param index the index to insert at, up to the array size
+ * @param src the source value array to copy into the array
+ * @param length the number of elements to copy
+ * @return 'true' if the values were inserted
+ */
+bool insertArrayDA(dynArray *pDA, size_t index, const void *src,
+                   size_t length);
+
+/**
+ * @brief Remove a range of elements
+ *
+ * The later elements are moved down in one pass, keeping their order. The
+ * memory is not reclaimed, to do that call reduceMemDA(). This will only
+ * remove values if the array is not a sub-array.
+ *
+ * @param pDA the array pointer to update
+ * @param min the first index to remove
+ * @param max the last index to remove
+ * @return 'true' if the range was removed
+ */
+bool eraseRangeDA(dynArray *pDA, size_t min, size_t max);
+
+/**
+ * @brief Remove every element matching a predicate
+ *
+ * The kept elements are compacted in a single pass, keeping their order. The
+ * memory is not reclaimed, to do that call reduceMemDA(). This will only
+ * remove values if the array is not a sub-array.
+ *
+ * @param pDA the array pointer to update
+ * @param remove the predicate, returning 'true' to remove the entry
+ * @param ref the optional predicate reference, may be NULL
+ * @return the number of elements removed
+ */
+size_t removeIfDA(dynArray *pDA, bool remove(const void *entry, void *ref),
+                  void *ref);
+
 /**
  * @brief Append a source dynamic array
  *
@@ -221,13 +686,49 @@ void reverseDA(dynArray *pDA);
 /**
  * @brief Create a shallow copy of the array
  *
- * The created copy will need to be freeded with freeeDA()
+ * The copy keeps the capacity and growth of the array, see cloneDA(). The
+ * created copy will need to be freeded with freeeDA()
  *
  * @param pDA the array pointer to copy
  * @return the copied array
  */
 dynArray *copyDA(const dynArray *pDA);
 
+/**
+ * @brief Create a shallow copy of the array with new storage parameters
+ *
+ * Only the live elements are copied and the new storage is not zeroed first.
+ * The capacity is at least that of the array, and the growth is kept unless
+ * set in the parameters. When both arrays are memory mapped files, the
+ * elements are copied between the files with copy_file_range(), which the
+ * file system may do by sharing extents. For example, to back up an array:
+ *
+ * dynArray *backup = cloneDA(pDALng, &(dynArrayParams){.filename = "bak.dat"});
+ *
+ * @param pDA the array pointer to copy
+ * @param params a pointer to the parameters of the copy or NULL for the heap
+ * @return the copied array that should be freed with freeDA()
+ */
+dynArray *cloneDA(const dynArray *pDA, const dynArrayParams *params);
+
+/**
+ * @brief Take a copy on write snapshot of the array
+ *
+ * For arrays created with snapshots, the snapshot maps the same pages as the
+ * array, and a page is only copied when either side writes to it. Only the
+ * pages changed since the last snapshot are written to the shared pages, so
+ * the cost does not depend on the array size. Taking a snapshot while an
+ * older one is still in use copies the array once to new shared pages.
+ *
+ * The snapshot is an independent array that keeps the contents at the time
+ * it was taken, and may be read by other threads while the array is changed.
+ * Other arrays are copied with copyDA().
+ *
+ * @param pDA the array pointer to snapshot
+ * @return the snapshot that should be freed with freeDA()
+ */
+dynArray *snapshotDA(dynArray *pDA);
+
 /**
  * @brief Perform a binary search for the value
  *
@@ -256,6 +757,59 @@ size_t searchDA(dynArray *pDA, const void *value,
  */
 dynArray *subDA(dynArray *pDA, size_t min, size_t max);
 
+/**
+ * @brief Create a view of part of an array
+ *
+ * Unlike subDA(), nothing is allocated, so views are cheap to take and can
+ * live on the stack. A view is invalidated when the array storage moves,
+ * for example when it grows. Debug builds exit when a stale view is used.
+ *
+ * @param pDA the array or sub array to view
+ * @param min the min array index
+ * @param max the max array index
+ * @return the view, which is empty if the range is not valid
+ */
+dynArrayView viewDA(dynArray *pDA, size_t min, size_t max);
+
+/**
+ * @brief Check a view still refers to the array storage
+ * @param view the view to check
+ * @return 'true' if the storage has not moved and still holds the view
+ */
+bool validViewDA(const dynArrayView *view);
+
+/**
+ * @brief Get an element of a view
+ * @param view the view to read
+ * @param index the index within the view
+ * @return a pointer to the value or NULL if not found
+ */
+void *getViewDA(const dynArrayView *view, size_t index);
+
+/**
+ * @brief Sort the elements of a view, see sortDA()
+ * @param view the view to sort
+ * @param compare the comparative function to apply or NULL to use the default
+ */
+void sortViewDA(const dynArrayView *view,
+                int compare(const void *a, const void *b));
+
+/**
+ * @brief Perform a binary search on a view, see searchDA()
+ * @param view the view to search
+ * @param value the value to search for
+ * @param compare the compare function or NULL to use the default
+ * @return the index within the view if the value was found, else -1
+ */
+size_t searchViewDA(const dynArrayView *view, const void *value,
+                    int compare(const void *a, const void *b));
+
+/**
+ * @brief Reverse the elements of a view
+ * @param view the view to reverse
+ */
+void reverseViewDA(const dynArrayView *view);
+
 /**
  * @brief Compare two strings
  * @param a the first string
@@ -284,12 +838,113 @@ void clearDA(dynArray *pDA);
  */
 void forEachDA(dynArray *pDA, bool call(void *entry, void *ref), void *ref);
 
+/**
+ * @brief Call the function for each span of entries in the array
+ *
+ * The spans are contiguous and in order, so the callback can loop over the
+ * entries directly. Sub arrays from subDA() are traversed the same way. The
+ * method should return 'true' to continue traversing the array.
+ *
+ * @param pDA the array pointer to traverse
+ * @param call the callback method, given the first entry and the entry count
+ * @param ref the optional callback reference, may be NULL
+ * @param chunk the most entries per call, 0 for the whole array in one call
+ * @return 'false' if a call stopped the traversal
+ */
+bool forEachRangeDA(dynArray *pDA,
+                    bool call(void *begin, size_t count, void *ref), void *ref,
+                    size_t chunk);
+
 /**
  * @brief Sync the array with the file for memory mapped arrays
+ *
+ * Block checksums, if enabled, are written as part of the sync. For arrays
+ * with a write ahead log, the pending writes are committed and the log is
+ * truncated once the file is synced. Write back arrays are flushed and
+ * synced.
+ *
  * @param pDA the array pointer to sync
  */
 void syncDAMap(dynArray *pDA);
 
+/**
+ * @brief Mark elements as written for memory mapped arrays with a log
+ *
+ * Writes made through the array functions are marked automatically. Writes
+ * made through a pointer, such as one returned by getDA(), must be marked
+ * after they are made or they will not reach the file. The element bytes are
+ * read when the batch is committed.
+ *
+ * @param pDA the array pointer written to
+ * @param index the first element written
+ * @param count the number of elements written, 0 for a header only change
+ */
+void logDA(dynArray *pDA, size_t index, size_t count);
+
+/**
+ * @brief Start a group of writes that are committed together
+ *
+ * Groups nest, and no commit is made until the outermost group ends.
+ *
+ * @param pDA the array pointer to write to
+ */
+void beginWriteDA(dynArray *pDA);
+
+/**
+ * @brief End a group of writes
+ *
+ * The group counts as a single operation towards the group commit size.
+ *
+ * @param pDA the array pointer written to
+ */
+void endWriteDA(dynArray *pDA);
+
+/**
+ * @brief Commit the marked writes to the write ahead log
+ *
+ * The batch is appended to the log and synced before the writes are applied
+ * to the file, so a commit is durable once this returns. Commits are made
+ * automatically every walBatch operations.
+ *
+ * @param pDA the array pointer to commit
+ * @return 'true' if the array has a write ahead log
+ */
+bool commitDA(dynArray *pDA);
+
+/**
+ * @brief Verify the block checksums of a memory mapped array
+ *
+ * The checksums describe the data as of the last syncDAMap() or freeDA().
+ *
+ * @param pDA the array pointer to verify
+ * @return 'true' if the array has checksums and every block matches
+ */
+bool verifyDA(const dynArray *pDA);
+
+/**
+ * @brief The bytes of an array backed by transparent huge pages
+ *
+ * Huge pages are only a request, the kernel may back the map with small
+ * pages, or collapse them into huge pages later. This reads the current
+ * AnonHugePages of the map from /proc/self/smaps.
+ *
+ * @param pDA the array pointer
+ * @return the bytes backed by huge pages, 0 for arrays that are not mapped
+ */
+size_t hugePagesDA(const dynArray *pDA);
+
+/**
+ * @brief Generate a CRC32C value for a byte array
+ *
+ * The SSE4.2 crc32 instruction is used where the CPU supports it.
+ *
+ * @param input the byte array to checksum
+ * @param length the input length
+ * @param seed the starting value, 0 for a new checksum
+ * @return the checksum value
+ */
+uint32_t crc32c(const void *input, size_t length, uint32_t seed);
+
 /**
  * @brief Read the header file for the array
  * @param pDA the array to read from
@@ -311,11 +966,21 @@ bool saveHeaderBufferDA(dynArray *pDA, char buffer[]);
  */
 void *_safeCalloc(const size_t count, const size_t size);
 
+/**
+ * @private
+ */
+void *_arenaAllocDA(dynArrayArena *arena, const size_t bytes);
+
 /**
  * @private
  */
 void *_safeReallocarray(void *ptr, const size_t count, const size_t size);
 
+/**
+ * @private
+ */
+void _updateMMap(dynArray *pDA);
+
 /**
  * @private
  */
@@ -326,4 +991,8 @@ void _swap(dynArray *pDA, void *a, void *b);
  */
 void *_toPtr(const dynArray *pDA, size_t index);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
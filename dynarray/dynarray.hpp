@@ -0,0 +1,445 @@
+#ifndef DYNARRAY_HPP
+#define DYNARRAY_HPP
+
+#include "dynarray.h"
+#include "hashtree.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @file dynarray.hpp
+ *
+ * @brief Dynamic Array C++ header file
+ *
+ * Header only templates over the C arrays and hash trees, owning the handle
+ * and freeing it when they go out of scope. For example:
+ *
+ * dynarray::array<long> values;
+ * values.emplace_back(7);
+ * std::sort(values.begin(), values.end());
+ *
+ * Elements are stored in place in the array buffer, which is moved with
+ * memcpy when it grows, so the element type must be trivially copyable.
+ * Requires C++17.
+ */
+
+namespace dynarray {
+
+/**
+ * @private
+ */
+namespace detail {
+
+/**
+ * @private
+ */
+template <typename T, typename Less>
+int compare(const void *a, const void *b) {
+  const T &left = *static_cast<const T *>(a);
+  const T &right = *static_cast<const T *>(b);
+  return Less()(left, right) ? -1 : Less()(right, left) ? 1 : 0;
+}
+
+} // namespace detail
+
+/**
+ * @brief A dynamic array of trivially copyable elements
+ *
+ * The iterators are plain pointers into the buffer, so they work with the
+ * standard algorithms and are invalidated when the array grows. Writes made
+ * through them are not logged, so arrays with a write ahead log should call
+ * log() for the changed range.
+ *
+ * @param T the element type
+ * @param Less the default ordering, used by sort() and the C comparator
+ */
+template <typename T, typename Less = std::less<T>> class array {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "array elements are moved with memcpy");
+
+public:
+  using value_type = T;
+  using size_type = size_t;
+  using reference = T &;
+  using const_reference = const T &;
+  using iterator = T *;
+  using const_iterator = const T *;
+
+  array() : array(dynArrayParams{}) {}
+
+  /**
+   * @brief Create an array, see createDA()
+   * @param params the array parameters
+   */
+  explicit array(dynArrayParams params)
+      : pDA(createDA(sizeof(T), detail::compare<T, Less>, &params)) {}
+
+  /**
+   * @brief Take ownership of an existing array handle
+   * @param handle the array, which must hold elements of type T
+   */
+  explicit array(dynArray *handle) : pDA(handle) {}
+
+  array(const array &) = delete;
+  array &operator=(const array &) = delete;
+
+  array(array &&other) noexcept : pDA(other.pDA) { other.pDA = nullptr; }
+
+  array &operator=(array &&other) noexcept {
+    std::swap(pDA, other.pDA);
+    return *this;
+  }
+
+  ~array() { freeDA(pDA); }
+
+  /**
+   * @brief Copy the array into new storage, see cloneDA()
+   * @param params the parameters of the copy or NULL for the heap
+   * @return the copy
+   */
+  array clone(const dynArrayParams *params = nullptr) const {
+    return array(cloneDA(pDA, params));
+  }
+
+  /**
+   * @brief Construct an element in place at the end of the array
+   * @param args the constructor arguments
+   * @return the new element
+   */
+  template <typename... Args> T &emplace_back(Args &&...args) {
+    if (pDA->parent != nullptr) {
+      throw std::logic_error("sub arrays can not grow");
+    }
+    // the log commits the slot once it is constructed
+    beginWriteDA(pDA);
+    T *added;
+    try {
+      added = ::new (emplaceDA(pDA)) T(std::forward<Args>(args)...);
+    } catch (...) {
+      pDA->size--;
+      endWriteDA(pDA);
+      throw;
+    }
+    endWriteDA(pDA);
+    return *added;
+  }
+
+  void push_back(const T &value) { emplace_back(value); }
+
+  void push_back(T &&value) { emplace_back(std::move(value)); }
+
+  void pop_back() {
+    if (pDA->size > 0) {
+      eraseRangeDA(pDA, pDA->size - 1, pDA->size - 1);
+    }
+  }
+
+  /**
+   * @brief Remove a range of elements, see eraseRangeDA()
+   * @param first the first element to remove
+   * @param last the element after the last to remove
+   * @return an iterator to the element after the removed range
+   */
+  iterator erase(const_iterator first, const_iterator last) {
+    size_t from = first - begin();
+    if (last > first) {
+      eraseRangeDA(pDA, from, (last - begin()) - 1);
+    }
+    return begin() + from;
+  }
+
+  /**
+   * @brief Remove the elements matching a predicate, see removeIfDA()
+   * @param remove the predicate, returning 'true' to remove the element
+   * @return the number of elements removed
+   */
+  template <typename Predicate> size_t remove_if(Predicate remove) {
+    return removeIfDA(
+        pDA,
+        [](const void *entry, void *ref) {
+          return (*static_cast<Predicate *>(ref))(
+              *static_cast<const T *>(entry));
+        },
+        &remove);
+  }
+
+  /**
+   * @brief Sort the array with a comparator known at compile time
+   * @param less the ordering
+   */
+  template <typename Compare = Less> void sort(Compare less = Compare()) {
+    std::sort(begin(), end(), less);
+    logDA(pDA, 0, pDA->size);
+  }
+
+  /**
+   * @brief Find a value in a sorted array
+   * @param value the value to find
+   * @return an iterator to the value or end() if not found
+   */
+  const_iterator find_sorted(const T &value) const {
+    const_iterator found = std::lower_bound(begin(), end(), value, Less());
+    return (found != end() && !Less()(value, *found)) ? found : end();
+  }
+
+  T &operator[](size_t index) { return data()[index]; }
+
+  const T &operator[](size_t index) const { return data()[index]; }
+
+  T &at(size_t index) {
+    if (index >= pDA->size) {
+      throw std::out_of_range("dynarray::array index out of range");
+    }
+    return data()[index];
+  }
+
+  const T &at(size_t index) const {
+    return const_cast<array *>(this)->at(index);
+  }
+
+  T &front() { return data()[0]; }
+
+  T &back() { return data()[pDA->size - 1]; }
+
+  T *data() { return static_cast<T *>(pDA->array); }
+
+  const T *data() const { return static_cast<const T *>(pDA->array); }
+
+  iterator begin() { return data(); }
+
+  iterator end() { return data() + pDA->size; }
+
+  const_iterator begin() const { return data(); }
+
+  const_iterator end() const { return data() + pDA->size; }
+
+  size_t size() const { return pDA->size; }
+
+  size_t capacity() const { return pDA->capacity; }
+
+  bool empty() const { return pDA->size == 0; }
+
+  void reserve(size_t capacity) { reserveDA(pDA, capacity); }
+
+  void resize(size_t size, const T &value = T()) {
+    resizeDA(pDA, size, &value);
+  }
+
+  void clear() { clearDA(pDA); }
+
+  void shrink_to_fit() { reduceMemDA(pDA); }
+
+  /**
+   * @brief Record a change made through an iterator, see logDA()
+   * @param index the first element changed
+   * @param count the number of elements changed
+   */
+  void log(size_t index, size_t count) { logDA(pDA, index, count); }
+
+  /**
+   * @brief The C array handle, still owned by this object
+   */
+  dynArray *handle() const { return pDA; }
+
+  /**
+   * @brief Give up ownership of the C array handle
+   * @return the handle that should be freed with freeDA()
+   */
+  dynArray *release() {
+    dynArray *handle = pDA;
+    pDA = nullptr;
+    return handle;
+  }
+
+private:
+  dynArray *pDA; ///< the owned array
+};
+
+/**
+ * @brief How a hash tree key is hashed and compared
+ *
+ * Keys are hashed as their object bytes, so they must not contain padding.
+ * Specialise this for other key types.
+ *
+ * @param K the key type
+ */
+template <typename K> struct key_traits {
+  static_assert(std::has_unique_object_representations<K>::value,
+                "hash tree keys are hashed as their bytes");
+
+  static keyEntry entry(const K &key) { return keyEntry{&key, sizeof(K)}; }
+
+  static int compare(const void *a, const void *b) {
+    return detail::compare<K, std::less<K>>(a, b);
+  }
+};
+
+/**
+ * @brief String keys are hashed and compared by their characters, without
+ * embedded nulls
+ */
+template <> struct key_traits<std::string> {
+  static keyEntry entry(const std::string &key) {
+    return keyEntry{key.c_str(), key.size()};
+  }
+
+  static int compare(const void *a, const void *b) {
+    return std::strcmp(static_cast<const char *>(a),
+                       static_cast<const char *>(b));
+  }
+};
+
+/**
+ * @brief A hash tree owning its keys and values
+ *
+ * The C tree holds pointers, so each entry is a node allocated once and
+ * reused when the value is replaced. Only heap backed trees are supported,
+ * as the pointers are not valid across processes.
+ *
+ * @param K the key type
+ * @param V the value type
+ */
+template <typename K, typename V> class hash_tree {
+  struct node {
+    template <typename... Args>
+    node(K &&k, Args &&...args)
+        : key(std::move(k)), value(std::forward<Args>(args)...) {
+      entry = key_traits<K>::entry(key);
+    }
+    K key;          ///< the owned key
+    keyEntry entry; ///< the key bytes, pointing into key
+    V value;        ///< the owned value
+  };
+
+public:
+  hash_tree() : pHT(createHT(key_traits<K>::compare, nullptr)) {}
+
+  hash_tree(const hash_tree &) = delete;
+  hash_tree &operator=(const hash_tree &) = delete;
+
+  hash_tree(hash_tree &&other) noexcept : pHT(other.pHT) {
+    other.pHT = nullptr;
+  }
+
+  hash_tree &operator=(hash_tree &&other) noexcept {
+    std::swap(pHT, other.pHT);
+    return *this;
+  }
+
+  ~hash_tree() {
+    if (pHT != nullptr) {
+      _freeNodes();
+      freeHT(pHT);
+    }
+  }
+
+  /**
+   * @brief Construct a value in place for a key, unless the key is present
+   * @param key the key
+   * @param args the value constructor arguments
+   * @return the value for the key
+   */
+  template <typename... Args> V &emplace(K key, Args &&...args) {
+    V *found = find(key);
+    if (found == nullptr) {
+      node *added = new node(std::move(key), std::forward<Args>(args)...);
+      setHT(pHT, &added->entry, added);
+      found = &added->value;
+    }
+    return *found;
+  }
+
+  /**
+   * @brief Set the value for a key
+   * @param key the key
+   * @param value the value
+   * @return the value for the key
+   */
+  V &insert_or_assign(K key, V value) {
+    V *found = find(key);
+    if (found != nullptr) {
+      *found = std::move(value);
+    } else {
+      found = &emplace(std::move(key), std::move(value));
+    }
+    return *found;
+  }
+
+  V *find(const K &key) const {
+    keyEntry entry = key_traits<K>::entry(key);
+    hashEntry *found = getHT(pHT, &entry);
+    return (found != nullptr) ? &static_cast<node *>(found->value)->value
+                              : nullptr;
+  }
+
+  bool contains(const K &key) const { return find(key) != nullptr; }
+
+  /**
+   * @brief Remove a key and free its value
+   * @param key the key
+   */
+  void erase(const K &key) {
+    keyEntry entry = key_traits<K>::entry(key);
+    deleteCallbackHT(
+        pHT, &entry,
+        [](const hashTree *, const keyEntry *, void *value, void *) {
+          delete static_cast<node *>(value);
+        },
+        nullptr);
+  }
+
+  /**
+   * @brief Call a function for each key and value, depth first
+   * @param visit the function, returning 'false' to stop
+   */
+  template <typename Visit> void for_each(Visit visit) const {
+    visitNodesHT(
+        pHT,
+        [](const hashEntry *entry, const size_t, void *ref) {
+          node *n = static_cast<node *>(entry->value);
+          return static_cast<bool>((*static_cast<Visit *>(ref))(
+              static_cast<const K &>(n->key), n->value));
+        },
+        &visit);
+  }
+
+  size_t size() const { return sizeHT(pHT); }
+
+  bool empty() const { return sizeHT(pHT) == 0; }
+
+  void balance() { balanceHT(pHT); }
+
+  void clear() {
+    _freeNodes();
+    clearHT(pHT);
+  }
+
+  /**
+   * @brief The C tree handle, still owned by this object
+   */
+  hashTree *handle() const { return pHT; }
+
+private:
+  void _freeNodes() {
+    visitNodesHT(
+        pHT,
+        [](const hashEntry *entry, const size_t, void *) {
+          delete static_cast<node *>(entry->value);
+          return true;
+        },
+        nullptr);
+  }
+
+  hashTree *pHT; ///< the owned tree
+};
+
+} // namespace dynarray
+
+#endif
@@ -0,0 +1,243 @@
+#define _GNU_SOURCE
+#include "dyncolumn.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @private
+ */
+typedef struct ColumnOrder {
+  const dynArray *column;                    ///< the column to order by
+  int (*compare)(const void *a, const void *b); ///< the field comparator
+} columnOrder;
+
+/**
+ * @private
+ */
+static inline char *_columnFilenameDA(const char *filename,
+                                      const size_t column) {
+  size_t length = strlen(filename) + 24;
+  char *name = _safeCalloc(length, 1);
+  snprintf(name, length, "%s.%lu", filename, column);
+  return name;
+}
+
+/**
+ * @private
+ */
+dynColumns *_allocColumnsDA(const dynColumn *fields, const size_t count,
+                            const size_t rowSize) {
+  dynColumns *pCols = _safeCalloc(1, sizeof(dynColumns));
+  pCols->columns = _safeCalloc(count, sizeof(dynArray *));
+  pCols->fields = _safeCalloc(count, sizeof(dynColumn));
+  memcpy(pCols->fields, fields, count * sizeof(dynColumn));
+  pCols->count = count;
+  pCols->rowSize = rowSize;
+  return pCols;
+}
+
+dynColumns *createColumnsDA(const dynColumn *fields, const size_t count,
+                            const size_t rowSize,
+                            const dynArrayParams *params) {
+  dynColumns *pCols = _allocColumnsDA(fields, count, rowSize);
+  dynArrayParams columnParams =
+      (params != NULL) ? *params : (dynArrayParams){0};
+
+  for (size_t c = 0; c < count; c++) {
+    char *name = NULL;
+    if (params != NULL && params->filename != NULL) {
+      name = _columnFilenameDA(params->filename, c);
+      columnParams.filename = name;
+    }
+    pCols->columns[c] =
+        createDA(fields[c].size, fields[c].compare, &columnParams);
+    free(name);
+  }
+  pCols->size = (count > 0) ? pCols->columns[0]->size : 0;
+
+  return pCols;
+}
+
+dynColumns *loadColumnsDA(const char *filename, const dynColumn *fields,
+                          const size_t count, const size_t rowSize) {
+  dynColumns *pCols = _allocColumnsDA(fields, count, rowSize);
+  bool valid = true;
+
+  size_t rows = SIZE_MAX;
+
+  for (size_t c = 0; valid && c < count; c++) {
+    char *name = _columnFilenameDA(filename, c);
+    pCols->columns[c] = loadDA(name, fields[c].compare);
+    free(name);
+
+    dynArray *column = pCols->columns[c];
+    if (column == NULL || column->elementSize != fields[c].size) {
+      DEBUG_LOG("Error invalid column: %lu\n", c);
+      valid = false;
+    } else if (column->size < rows) {
+      rows = column->size;
+    }
+  }
+
+  if (valid) {
+    // each column commits its own log, so a crash while adding a row can
+    // leave some columns a row ahead, which is dropped
+    for (size_t c = 0; c < count; c++) {
+      if (pCols->columns[c]->size > rows) {
+        DEBUG_LOG("Truncating column %lu to %lu rows\n", c, rows);
+        resizeDA(pCols->columns[c], rows, NULL);
+      }
+    }
+    pCols->size = (count > 0) ? rows : 0;
+  } else {
+    freeColumnsDA(pCols);
+    pCols = NULL;
+  }
+
+  return pCols;
+}
+
+void freeColumnsDA(dynColumns *pCols) {
+  if (pCols != NULL) {
+    for (size_t c = 0; c < pCols->count; c++) {
+      freeDA(pCols->columns[c]);
+    }
+    free(pCols->columns);
+    free(pCols->fields);
+    free(pCols);
+  }
+}
+
+bool addRowDA(dynColumns *pCols, const void *row) {
+  // each field is written once, straight into its column
+  for (size_t c = 0; c < pCols->count; c++) {
+    dynArray *column = pCols->columns[c];
+    beginWriteDA(column);
+    memcpy(emplaceDA(column), row + pCols->fields[c].offset,
+           pCols->fields[c].size);
+    endWriteDA(column);
+  }
+  pCols->size++;
+  return true;
+}
+
+bool getRowDA(const dynColumns *pCols, const size_t index, void *row) {
+  bool found = index < pCols->size;
+  for (size_t c = 0; found && c < pCols->count; c++) {
+    memcpy(row + pCols->fields[c].offset, getDA(pCols->columns[c], index),
+           pCols->fields[c].size);
+  }
+  return found;
+}
+
+bool setRowDA(dynColumns *pCols, const size_t index, const void *row) {
+  bool found = index < pCols->size;
+  for (size_t c = 0; found && c < pCols->count; c++) {
+    setDA(pCols->columns[c], index, row + pCols->fields[c].offset);
+  }
+  return found;
+}
+
+bool reserveColumnsDA(dynColumns *pCols, const size_t capacity) {
+  bool extended = false;
+  for (size_t c = 0; c < pCols->count; c++) {
+    extended |= reserveDA(pCols->columns[c], capacity);
+  }
+  return extended;
+}
+
+void clearColumnsDA(dynColumns *pCols) {
+  for (size_t c = 0; c < pCols->count; c++) {
+    clearDA(pCols->columns[c]);
+  }
+  pCols->size = 0;
+}
+
+/**
+ * @private
+ */
+int _compareRowsDA(const void *a, const void *b, void *arg) {
+  const columnOrder *order = arg;
+  size_t left = *(const size_t *)a;
+  size_t right = *(const size_t *)b;
+  int comp = order->compare(_toPtr(order->column, left),
+                            _toPtr(order->column, right));
+
+  // break ties on the row index to keep equal rows in order
+  if (comp == 0) {
+    comp = (left < right) ? -1 : (left > right) ? 1 : 0;
+  }
+  return comp;
+}
+
+dynArray *sortPermutationDA(const dynColumns *pCols, const size_t column,
+                            int compare(const void *a, const void *b)) {
+  dynArray *permutation = NULL;
+  columnOrder order = (columnOrder){
+      .column = pCols->columns[column],
+      .compare = compare ? compare : pCols->fields[column].compare};
+
+  if (order.compare != NULL) {
+    permutation = createDA(sizeof(size_t), NULL,
+                           &(dynArrayParams){.capacity = pCols->size});
+    size_t *rows = emplaceArrayDA(permutation, pCols->size);
+    for (size_t i = 0; i < pCols->size; i++) {
+      rows[i] = i;
+    }
+    qsort_r(rows, pCols->size, sizeof(size_t), _compareRowsDA, &order);
+  } else {
+    DEBUG_LOG("No comparator for column: %lu\n", column);
+  }
+
+  return permutation;
+}
+
+bool permuteColumnsDA(dynColumns *pCols, const dynArray *permutation) {
+  bool valid = permutation->elementSize == sizeof(size_t) &&
+               permutation->size == pCols->size;
+  const size_t *rows = permutation->array;
+
+  if (valid) {
+    // every row must appear exactly once
+    bool *seen = _safeCalloc(pCols->size + 1, sizeof(bool));
+    for (size_t i = 0; valid && i < pCols->size; i++) {
+      valid = rows[i] < pCols->size && !seen[rows[i]];
+      if (valid) {
+        seen[rows[i]] = true;
+      }
+    }
+    free(seen);
+  }
+
+  if (valid && pCols->size > 0) {
+    size_t largest = 0;
+    for (size_t c = 0; c < pCols->count; c++) {
+      if (pCols->fields[c].size > largest) {
+        largest = pCols->fields[c].size;
+      }
+    }
+    void *buffer = _safeCalloc(pCols->size, largest);
+
+    for (size_t c = 0; c < pCols->count; c++) {
+      dynArray *column = pCols->columns[c];
+      size_t es = column->elementSize;
+      for (size_t i = 0; i < pCols->size; i++) {
+        memcpy(buffer + (i * es), _toPtr(column, rows[i]), es);
+      }
+      memcpy(column->array, buffer, pCols->size * es);
+      logDA(column, 0, pCols->size);
+    }
+    free(buffer);
+  } else if (!valid) {
+    DEBUG_LOG("Invalid permutation of %lu rows\n", pCols->size);
+  }
+
+  return valid;
+}
+
+bool scanColumnDA(dynColumns *pCols, const size_t column,
+                  bool call(void *begin, size_t count, void *ref), void *ref,
+                  const size_t chunk) {
+  return forEachRangeDA(pCols->columns[column], call, ref, chunk);
+}
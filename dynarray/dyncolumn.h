@@ -0,0 +1,175 @@
+#ifndef DYNCOLUMN_H
+#define DYNCOLUMN_H
+
+#include "dynarray.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file dyncolumn.h
+ *
+ * @brief Dynamic Array columnar storage header file
+ *
+ * Store each field of a record in its own array, so a scan over one field
+ * only reads that field. For example:
+ *
+ * dynColumn fields[] = {{offsetof(trade, price), sizeof(double), NULL},
+ *                       {offsetof(trade, volume), sizeof(long), NULL}};
+ * dynColumns *pCols = createColumnsDA(fields, 2, sizeof(trade), NULL);
+ * addRowDA(pCols, &(trade){.price = 1.5, .volume = 10});
+ * sumDA(pCols->columns[0], KernelDouble, &total);
+ *
+ * Rows are scattered into the columns when added and gathered back when read.
+ * Every column is created with the same parameters, so they grow together.
+ * The column arrays can be passed to the array functions for reading, such as
+ * the kernels in dynkernel.h, but changes to the row count must go through
+ * the column functions. Memory mapped columns are stored one file per column,
+ * named after the filename with the column number appended.
+ */
+
+/**
+ * @brief A field stored as a column
+ */
+typedef struct DynamicArrayColumn {
+  size_t offset; ///< the field offset in a row record
+  size_t size;   ///< the field size
+  int (*compare)(const void *a,
+                 const void *b); ///< the field comparator or NULL
+} dynColumn;
+
+/**
+ * @brief Columnar storage
+ */
+typedef struct DynamicArrayColumns {
+  dynArray **columns; ///< an array per field, in field order
+  dynColumn *fields;  ///< the fields stored in the columns
+  size_t count;       ///< the number of columns
+  size_t rowSize;     ///< the size of a row record
+  size_t size;        ///< the number of rows
+} dynColumns;
+
+/**
+ * @brief Create columnar storage
+ *
+ * The parameters apply to every column. The filename, if set, is the prefix
+ * for the column files, with ".0", ".1" and so on appended.
+ *
+ * @param fields the fields to store, one per column
+ * @param count the number of fields
+ * @param rowSize the size of a row record
+ * @param params a pointer to the array parameters or NULL for default
+ * @return the columns that should be freed with freeColumnsDA()
+ */
+dynColumns *createColumnsDA(const dynColumn *fields, size_t count,
+                            size_t rowSize, const dynArrayParams *params);
+
+/**
+ * @brief Load columnar storage from its column files
+ *
+ * Each column commits its own write ahead log, so a crash while adding a row
+ * can leave the columns with different sizes. They are truncated to the rows
+ * held by every column.
+ *
+ * @param filename the filename prefix the columns were created with
+ * @param fields the fields stored, one per column
+ * @param count the number of fields
+ * @param rowSize the size of a row record
+ * @return the columns that should be freed with freeColumnsDA(), or NULL if
+ * a column could not be loaded or the columns do not match the fields
+ */
+dynColumns *loadColumnsDA(const char *filename, const dynColumn *fields,
+                          size_t count, size_t rowSize);
+
+/**
+ * @brief Free columnar storage, syncing any memory mapped columns
+ * @param pCols the columns to free
+ */
+void freeColumnsDA(dynColumns *pCols);
+
+/**
+ * @brief Add a row
+ * @param pCols the columns to update
+ * @param row the row record to scatter into the columns
+ * @return 'true' if the row was added
+ */
+bool addRowDA(dynColumns *pCols, const void *row);
+
+/**
+ * @brief Read a row
+ * @param pCols the columns to read
+ * @param index the row index
+ * @param row the row record to gather the fields into
+ * @return 'true' if the index was in range
+ */
+bool getRowDA(const dynColumns *pCols, size_t index, void *row);
+
+/**
+ * @brief Replace a row
+ * @param pCols the columns to update
+ * @param index the row index
+ * @param row the row record to scatter into the columns
+ * @return 'true' if the index was in range
+ */
+bool setRowDA(dynColumns *pCols, size_t index, const void *row);
+
+/**
+ * @brief Reserve capacity for rows in every column
+ * @param pCols the columns to update
+ * @param capacity the rows to reserve
+ * @return 'true' if the columns were extended
+ */
+bool reserveColumnsDA(dynColumns *pCols, size_t capacity);
+
+/**
+ * @brief Remove all the rows
+ * @param pCols the columns to clear
+ */
+void clearColumnsDA(dynColumns *pCols);
+
+/**
+ * @brief Order the rows by a column, without moving them
+ *
+ * Rows with equal fields keep their order.
+ *
+ * @param pCols the columns to order
+ * @param column the column to order by
+ * @param compare the comparator or NULL for the field comparator
+ * @return an array of size_t row indices in order, that should be freed with
+ * freeDA(), or NULL if there is no comparator
+ */
+dynArray *sortPermutationDA(const dynColumns *pCols, size_t column,
+                            int compare(const void *a, const void *b));
+
+/**
+ * @brief Move the rows of every column into an order
+ *
+ * @param pCols the columns to reorder
+ * @param permutation the size_t row indices in their new order, for example
+ * from sortPermutationDA()
+ * @return 'true' if the permutation covers every row
+ */
+bool permuteColumnsDA(dynColumns *pCols, const dynArray *permutation);
+
+/**
+ * @brief Scan a column a range of fields at a time
+ *
+ * See forEachRangeDA().
+ *
+ * @param pCols the columns to scan
+ * @param column the column to scan
+ * @param call the callback method, given the first field and the field count
+ * @param ref the optional callback reference, may be NULL
+ * @param chunk the most fields per call, 0 for the whole column in one call
+ * @return 'false' if a call stopped the scan
+ */
+bool scanColumnDA(dynColumns *pCols, size_t column,
+                  bool call(void *begin, size_t count, void *ref), void *ref,
+                  size_t chunk);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,496 @@
+#include "dynexport.h"
+#include "dynparallel.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5
+#define LZ_MATCH_LIMIT 12
+#define LZ_MAX_OFFSET 65535
+#define BLOCK_STORED 0x80000000U
+
+/**
+ * @private
+ */
+typedef struct BlockHeader {
+  uint32_t raw;      ///< the raw block length
+  uint32_t encoded;  ///< the encoded length, BLOCK_STORED if not encoded
+  uint32_t checksum; ///< the CRC32C of the raw block
+} blockHeader;
+
+/**
+ * @private
+ */
+typedef struct ExportJob {
+  const dynArrayCodec *codec; ///< the codec to apply
+  size_t elementSize;         ///< the array element size
+  const void *src;            ///< the raw block
+  size_t length;              ///< the raw block length
+  void *dest;                 ///< the encode buffer
+  blockHeader header;         ///< the encoded block header
+} exportJob;
+
+/**
+ * @private
+ */
+static inline uint32_t _read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+/**
+ * @private
+ */
+static size_t _rawBound(const size_t length) { return length; }
+
+/**
+ * @private
+ */
+static size_t _rawEncode(const void *src, const size_t length, void *dest,
+                         const size_t elementSize) {
+  memcpy(dest, src, length);
+  return length;
+}
+
+/**
+ * @private
+ */
+static size_t _rawDecode(const void *src, const size_t length, void *dest,
+                         const size_t capacity, const size_t elementSize) {
+  size_t rtn = -1;
+  if (length <= capacity) {
+    memcpy(dest, src, length);
+    rtn = length;
+  }
+  return rtn;
+}
+
+/**
+ * @private
+ */
+static size_t _lzBound(const size_t length) {
+  return length + (length / 255) + 16;
+}
+
+/**
+ * @private
+ */
+static inline uint8_t *_lzLength(uint8_t *op, size_t length) {
+  while (length >= 255) {
+    *op++ = 255;
+    length -= 255;
+  }
+  *op++ = (uint8_t)length;
+  return op;
+}
+
+/**
+ * @private
+ */
+static uint8_t *_lzSequence(uint8_t *op, const uint8_t *literals,
+                            const size_t litLength, const size_t offset,
+                            const size_t matchLength) {
+  uint8_t *token = op++;
+  *token = (litLength >= 15 ? 15 : litLength) << 4;
+  if (litLength >= 15) {
+    op = _lzLength(op, litLength - 15);
+  }
+  memcpy(op, literals, litLength);
+  op += litLength;
+
+  if (matchLength > 0) {
+    size_t ml = matchLength - LZ_MIN_MATCH;
+    *op++ = offset & 0xFF;
+    *op++ = offset >> 8;
+    *token |= (ml >= 15 ? 15 : ml);
+    if (ml >= 15) {
+      op = _lzLength(op, ml - 15);
+    }
+  }
+  return op;
+}
+
+/**
+ * @private
+ */
+static size_t _lzEncode(const void *src, const size_t length, void *dest,
+                        const size_t elementSize) {
+  const uint8_t *in = src;
+  uint8_t *op = dest;
+  uint32_t table[1 << LZ_HASH_BITS] = {0};
+  size_t ip = 0, anchor = 0;
+
+  if (length > LZ_MATCH_LIMIT) {
+    size_t limit = length - LZ_MATCH_LIMIT;
+    while (ip < limit) {
+      uint32_t seq = _read32(in + ip);
+      uint32_t h = (seq * 2654435761U) >> (32 - LZ_HASH_BITS);
+      // positions are stored plus one so zero means empty
+      size_t ref = table[h];
+      table[h] = ip + 1;
+
+      if (ref > 0 && ip - (ref - 1) <= LZ_MAX_OFFSET &&
+          _read32(in + ref - 1) == seq) {
+        size_t match = ref - 1;
+        size_t len = LZ_MIN_MATCH;
+        while (ip + len < length - LZ_LAST_LITERALS &&
+               in[match + len] == in[ip + len]) {
+          len++;
+        }
+        op = _lzSequence(op, in + anchor, ip - anchor, ip - match, len);
+        ip += len;
+        anchor = ip;
+      } else {
+        ip++;
+      }
+    }
+  }
+
+  op = _lzSequence(op, in + anchor, length - anchor, 0, 0);
+  return op - (uint8_t *)dest;
+}
+
+/**
+ * @private
+ */
+static inline bool _lzReadLength(const uint8_t **ip, const uint8_t *end,
+                                 size_t *length) {
+  uint8_t b = 255;
+  while (b == 255 && *ip < end) {
+    b = *(*ip)++;
+    *length += b;
+  }
+  return b != 255;
+}
+
+/**
+ * @private
+ */
+static size_t _lzDecode(const void *src, const size_t length, void *dest,
+                        const size_t capacity, const size_t elementSize) {
+  const uint8_t *ip = src, *end = ip + length;
+  uint8_t *op = dest, *oend = op + capacity;
+  bool ok = true;
+
+  while (ok && ip < end) {
+    uint8_t token = *ip++;
+    size_t lit = token >> 4;
+    if (lit == 15) {
+      ok = _lzReadLength(&ip, end, &lit);
+    }
+    ok = ok && lit <= (size_t)(end - ip) && lit <= (size_t)(oend - op);
+    if (ok) {
+      memcpy(op, ip, lit);
+      op += lit;
+      ip += lit;
+    }
+
+    if (ok && ip < end) {
+      ok = end - ip >= 2;
+      size_t offset = ok ? ip[0] | (ip[1] << 8) : 0;
+      size_t ml = token & 15;
+      ip += 2;
+      if (ok && ml == 15) {
+        ok = _lzReadLength(&ip, end, &ml);
+      }
+      ml += LZ_MIN_MATCH;
+      ok = ok && offset > 0 && offset <= (size_t)(op - (uint8_t *)dest) &&
+           ml <= (size_t)(oend - op);
+      // byte copy as the match may overlap the output
+      for (size_t i = 0; ok && i < ml; i++, op++) {
+        *op = *(op - offset);
+      }
+    }
+  }
+
+  return ok ? (size_t)(op - (uint8_t *)dest) : (size_t)-1;
+}
+
+/**
+ * @private
+ */
+static size_t _deltaBound(const size_t length) { return length * 10 / 4 + 16; }
+
+/**
+ * @private
+ */
+static size_t _deltaEncode(const void *src, const size_t length, void *dest,
+                           const size_t elementSize) {
+  size_t rtn = -1;
+
+  if (elementSize == sizeof(int32_t) || elementSize == sizeof(int64_t)) {
+    uint8_t *op = dest;
+    int64_t prev = 0, value;
+    for (size_t i = 0; i < length; i += elementSize) {
+      if (elementSize == sizeof(int32_t)) {
+        int32_t v;
+        memcpy(&v, src + i, sizeof(v));
+        value = v;
+      } else {
+        memcpy(&value, src + i, sizeof(value));
+      }
+      // zig-zag the delta so small negative steps stay small
+      uint64_t delta = (uint64_t)value - (uint64_t)prev;
+      uint64_t zz = (delta << 1) ^ (uint64_t)((int64_t)delta >> 63);
+      while (zz >= 0x80) {
+        *op++ = (zz & 0x7F) | 0x80;
+        zz >>= 7;
+      }
+      *op++ = zz;
+      prev = value;
+    }
+    rtn = op - (uint8_t *)dest;
+  }
+
+  return rtn;
+}
+
+/**
+ * @private
+ */
+static size_t _deltaDecode(const void *src, const size_t length, void *dest,
+                           const size_t capacity, const size_t elementSize) {
+  const uint8_t *ip = src, *end = ip + length;
+  size_t out = 0;
+  int64_t prev = 0;
+  bool ok = elementSize == sizeof(int32_t) || elementSize == sizeof(int64_t);
+
+  while (ok && ip < end) {
+    uint64_t zz = 0;
+    int shift = 0;
+    uint8_t b = 0x80;
+    while ((b & 0x80) && ip < end && shift < 64) {
+      b = *ip++;
+      zz |= (uint64_t)(b & 0x7F) << shift;
+      shift += 7;
+    }
+    ok = !(b & 0x80) && out + elementSize <= capacity;
+    if (ok) {
+      uint64_t delta = (zz >> 1) ^ -(zz & 1);
+      prev = (int64_t)((uint64_t)prev + delta);
+      if (elementSize == sizeof(int32_t)) {
+        int32_t v = (int32_t)prev;
+        memcpy(dest + out, &v, sizeof(v));
+      } else {
+        memcpy(dest + out, &prev, sizeof(prev));
+      }
+      out += elementSize;
+    }
+  }
+
+  return ok ? out : (size_t)-1;
+}
+
+const dynArrayCodec CodecRaw = {
+    .id = 0, .bound = _rawBound, .encode = _rawEncode, .decode = _rawDecode};
+
+const dynArrayCodec CodecLZ = {
+    .id = 1, .bound = _lzBound, .encode = _lzEncode, .decode = _lzDecode};
+
+const dynArrayCodec CodecDelta = {.id = 2,
+                                  .bound = _deltaBound,
+                                  .encode = _deltaEncode,
+                                  .decode = _deltaDecode};
+
+/**
+ * @private
+ */
+static const dynArrayCodec *_codecById(const uint32_t id) {
+  const dynArrayCodec *codecs[] = {&CodecRaw, &CodecLZ, &CodecDelta};
+  return (id < sizeof(codecs) / sizeof(codecs[0])) ? codecs[id] : NULL;
+}
+
+/**
+ * @private
+ */
+static bool _writeAll(const int fd, const void *buffer, size_t length) {
+  ssize_t done = 0;
+  while (length > 0) {
+    done = write(fd, buffer, length);
+    if (done < 0 && errno == EINTR) {
+      continue;
+    }
+    if (done <= 0) {
+      break;
+    }
+    buffer += done;
+    length -= done;
+  }
+  return length == 0;
+}
+
+/**
+ * @private
+ */
+static bool _readAll(const int fd, void *buffer, size_t length) {
+  ssize_t done = 0;
+  while (length > 0) {
+    done = read(fd, buffer, length);
+    if (done < 0 && errno == EINTR) {
+      continue;
+    }
+    if (done <= 0) {
+      break;
+    }
+    buffer += done;
+    length -= done;
+  }
+  return length == 0;
+}
+
+/**
+ * @private
+ */
+static inline size_t _blockSize(const size_t elementSize) {
+  size_t block = (EXPORT_BLOCK_SIZE / elementSize) * elementSize;
+  return (block < elementSize) ? elementSize : block;
+}
+
+/**
+ * @private
+ */
+static bool _encodeJob(void *entry, void *ref) {
+  exportJob *job = entry;
+  size_t encoded =
+      job->codec->encode(job->src, job->length, job->dest, job->elementSize);
+
+  job->header.raw = job->length;
+  job->header.checksum = crc32c(job->src, job->length, 0);
+  // keep the raw block when the codec does not help
+  job->header.encoded =
+      (encoded < job->length) ? encoded : (job->length | BLOCK_STORED);
+  return true;
+}
+
+bool exportDA(const dynArray *pDA, const int fd, const dynArrayCodec *codec,
+              size_t threads) {
+  codec = (codec != NULL) ? codec : &CodecRaw;
+  threads = (threads < 1) ? 1 : threads;
+
+  size_t blockSize = _blockSize(pDA->elementSize);
+  size_t bytes = pDA->size * pDA->elementSize;
+  size_t blocks = (bytes + blockSize - 1) / blockSize;
+  size_t bound = codec->bound(blockSize);
+
+  // keep the header buffer, such as a hash tree root
+  fileHeader header = {0};
+  readHeaderDA((dynArray *)pDA, &header);
+  header.version = FILE_VERSION;
+  header.elementSize = pDA->elementSize;
+  header.size = pDA->size;
+  header.capacity = pDA->size;
+  header.growth = pDA->growth;
+  header.offset = sizeof(fileHeader);
+  header.alignment = pDA->alignment;
+  header.magic = FILE_MAGIC;
+  header.endian = FILE_ENDIAN;
+  header.flags = FILE_FLAG_STREAM | (codec->id << 8);
+  header.blockSize = blockSize;
+  header.blocks = blocks;
+  header.checksum = crc32c(&header, offsetof(fileHeader, checksum), 0);
+
+  bool ok = _writeAll(fd, &header, sizeof(fileHeader));
+
+  dynArray *jobs = createDA(sizeof(exportJob), NULL,
+                            &(dynArrayParams){.capacity = threads});
+  void *buffers = _safeReallocarray(NULL, threads, bound);
+
+  for (size_t b = 0; ok && b < blocks; b += threads) {
+    size_t batch = (blocks - b < threads) ? blocks - b : threads;
+
+    clearDA(jobs);
+    for (size_t t = 0; t < batch; t++) {
+      size_t from = (b + t) * blockSize;
+      exportJob *job = emplaceDA(jobs);
+      *job = (exportJob){
+          .codec = codec,
+          .elementSize = pDA->elementSize,
+          .src = pDA->array + from,
+          .length = (bytes - from < blockSize) ? bytes - from : blockSize,
+          .dest = buffers + (t * bound)};
+    }
+    // the blocks are encoded on the shared pool, one block per claim
+    parallelTasksDA(jobs, _encodeJob, NULL, threads);
+
+    // write the blocks back in order
+    for (size_t t = 0; ok && t < batch; t++) {
+      exportJob *job = getDA(jobs, t);
+      bool stored = job->header.encoded & BLOCK_STORED;
+      ok = _writeAll(fd, &job->header, sizeof(blockHeader)) &&
+           _writeAll(fd, stored ? job->src : job->dest,
+                     stored ? job->length : job->header.encoded);
+    }
+  }
+
+  freeDA(jobs);
+  free(buffers);
+  return ok;
+}
+
+dynArray *importDA(const int fd, int compare(const void *a, const void *b),
+                   dynArrayParams *params) {
+  dynArray *pDA = NULL;
+  fileHeader header = {0};
+  const dynArrayCodec *codec = NULL;
+
+  bool ok = _readAll(fd, &header, sizeof(fileHeader)) &&
+            header.version == FILE_VERSION && header.magic == FILE_MAGIC &&
+            header.endian == FILE_ENDIAN &&
+            header.checksum ==
+                crc32c(&header, offsetof(fileHeader, checksum), 0) &&
+            (header.flags & FILE_FLAG_STREAM) && header.elementSize > 0 &&
+            header.blockSize == _blockSize(header.elementSize) &&
+            (codec = _codecById((header.flags >> 8) & 0xFF)) != NULL;
+
+  if (ok) {
+    dynArrayParams local =
+        (params != NULL) ? *params : (dynArrayParams){.capacity = 10};
+    local.size = header.size;
+    local.growth = header.growth;
+    local.noZeroInit = true;
+    pDA = createDA(header.elementSize, compare, &local);
+    saveHeaderBufferDA(pDA, header.buffer);
+
+    size_t bytes = header.size * header.elementSize;
+    size_t pos = 0;
+    void *buffer =
+        _safeReallocarray(NULL, 1, codec->bound(header.blockSize));
+
+    // decode each block straight into the array
+    for (size_t b = 0; ok && b < header.blocks; b++) {
+      blockHeader block;
+      ok = _readAll(fd, &block, sizeof(blockHeader)) &&
+           block.raw <= header.blockSize && block.raw <= bytes - pos;
+      if (ok && (block.encoded & BLOCK_STORED)) {
+        ok = (block.encoded & ~BLOCK_STORED) == block.raw &&
+             _readAll(fd, pDA->array + pos, block.raw);
+      } else if (ok) {
+        ok = block.encoded <= codec->bound(header.blockSize) &&
+             _readAll(fd, buffer, block.encoded) &&
+             codec->decode(buffer, block.encoded, pDA->array + pos, block.raw,
+                           header.elementSize) == block.raw;
+      }
+      ok = ok && crc32c(pDA->array + pos, block.raw, 0) == block.checksum;
+      pos += ok ? block.raw : 0;
+    }
+    ok = ok && pos == bytes;
+
+    free(buffer);
+    if (!ok) {
+      DEBUG_LOG("Error invalid export stream block at: %lu\n", pos);
+      freeDA(pDA);
+      pDA = NULL;
+    } else {
+      // the elements were decoded in place so mark them for any log
+      logDA(pDA, 0, pDA->size);
+    }
+  } else {
+    DEBUG_LOG("Error invalid export stream header: %lu\n", header.version);
+  }
+
+  return pDA;
+}
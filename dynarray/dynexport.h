@@ -0,0 +1,100 @@
+#ifndef DYNEXPORT_H
+#define DYNEXPORT_H
+
+#include "dynarray.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file dynexport.h
+ *
+ * @brief Dynamic Array export header file
+ *
+ * Stream an array to a file descriptor in fixed size blocks, each passed
+ * through a codec. For example:
+ *
+ * exportDA(pDALng, fd, &CodecLZ, 4);
+ *
+ * The stream starts with the array file header, so an imported array can be
+ * written straight into a memory mapped file by setting the filename in the
+ * import parameters.
+ */
+
+/**
+ * @brief The raw bytes per export block, rounded down to whole elements
+ */
+#define EXPORT_BLOCK_SIZE (1024 * 1024)
+
+/**
+ * @brief File flag set for an exported stream, the codec id is in bits 8-15
+ */
+#define FILE_FLAG_STREAM 0x2U
+
+/**
+ * @brief Block codec
+ */
+typedef struct DynamicArrayCodec {
+  uint32_t id; ///< the codec id recorded in the stream
+  size_t (*bound)(size_t length); ///< the max encoded size for a block length
+  size_t (*encode)(const void *src, size_t length, void *dest,
+                   size_t elementSize); ///< encode a block, returns the size
+  size_t (*decode)(const void *src, size_t length, void *dest,
+                   size_t capacity,
+                   size_t elementSize); ///< decode a block, returns the size
+                                        ///< or -1 if the block is invalid
+} dynArrayCodec;
+
+/**
+ * @brief Codec that stores blocks unchanged
+ */
+extern const dynArrayCodec CodecRaw;
+
+/**
+ * @brief LZ4 block format codec for general data
+ */
+extern const dynArrayCodec CodecLZ;
+
+/**
+ * @brief Delta and zig-zag varint codec for sorted 4 or 8 byte integers
+ */
+extern const dynArrayCodec CodecDelta;
+
+/**
+ * @brief Export an array to a file descriptor
+ *
+ * Only the live elements are written. Memory use is bounded to one encode
+ * buffer per thread. The blocks are encoded on the parallelForEachDA()
+ * thread pool.
+ *
+ * @param pDA the array pointer to export
+ * @param fd the file descriptor to write to
+ * @param codec the codec to apply or NULL for CodecRaw
+ * @param threads the number of blocks to encode in parallel, 0 or 1 for none
+ * @return 'true' if the array was written
+ */
+bool exportDA(const dynArray *pDA, int fd, const dynArrayCodec *codec,
+              size_t threads);
+
+/**
+ * @brief Import an array from a file descriptor
+ *
+ * The element size, size and growth are read from the stream and override
+ * the parameters. Blocks are decoded straight into the new array.
+ *
+ * @param fd the file descriptor to read from
+ * @param compare the default comparator function
+ * @param params a pointer to the dynamic array parameters or NULL for default
+ * @return An initialised dynamic array that should be freed with freeDA(),
+ * or NULL if the stream is invalid
+ */
+dynArray *importDA(int fd, int compare(const void *a, const void *b),
+                   dynArrayParams *params);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
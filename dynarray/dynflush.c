@@ -0,0 +1,467 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "dynflush.h"
+
+#define FLUSH_MAX_WRITE (1UL << 30)
+
+/**
+ * @private
+ */
+typedef struct FlushJob {
+  struct DynamicArrayFlush *flush; ///< the flush the write belongs to
+  int fd;                          ///< the file descriptor to write to
+  const void *data;                ///< the bytes still to write
+  size_t length;                   ///< the length still to write
+  off_t offset;                    ///< the file offset still to write at
+} flushJob;
+
+/**
+ * @private
+ */
+typedef struct DynamicArrayFlusher {
+  int fd;                           ///< the buffered file descriptor
+  int directFd;                     ///< the O_DIRECT file descriptor or -1
+  size_t length;                    ///< the known file length
+  struct DynamicArrayFlush *active; ///< the flush in progress or NULL
+  int ring;                         ///< the io_uring descriptor or -1
+  size_t queued;                    ///< the writes queued but not submitted
+  void *sqRing;                     ///< the submission ring map
+  size_t sqBytes;                   ///< the submission ring map size
+  void *cqRing;                     ///< the completion ring map
+  size_t cqBytes;                   ///< the completion ring map size
+  struct io_uring_sqe *sqes;        ///< the submission entries map
+  size_t sqeBytes;                  ///< the submission entries map size
+  unsigned *sqTail;                 ///< the submission ring tail
+  unsigned *sqMask;                 ///< the submission ring mask
+  unsigned *sqArray;                ///< the submission ring index array
+  unsigned *cqHead;                 ///< the completion ring head
+  unsigned *cqTail;                 ///< the completion ring tail
+  unsigned *cqMask;                 ///< the completion ring mask
+  struct io_uring_cqe *cqes;        ///< the completion entries
+} dynArrayFlusher;
+
+/**
+ * @private
+ */
+struct DynamicArrayFlush {
+  dynArrayFlusher *flusher;       ///< the engine the flush was submitted to
+  flushJob jobs[FLUSH_QUEUE + 2]; ///< the data writes then the header write
+  size_t count;                   ///< the number of data writes
+  size_t next;                    ///< the next data write for the threads
+  size_t pending;                 ///< the data writes not yet completed
+  bool done;                      ///< 'true' once the header is written
+  bool failed;                    ///< 'true' if any write failed
+  bool joined;                    ///< 'true' once the threads are joined
+  bool active;                    ///< 'true' while the engine tracks it
+  size_t threads;                 ///< the number of threads started
+  pthread_t thread[FLUSH_THREADS]; ///< the write threads
+};
+
+/**
+ * @private
+ */
+void _freeRingDA(dynArrayFlusher *flusher) {
+  if (flusher->sqes != MAP_FAILED) {
+    munmap(flusher->sqes, flusher->sqeBytes);
+  }
+  if (flusher->cqRing != MAP_FAILED && flusher->cqRing != flusher->sqRing) {
+    munmap(flusher->cqRing, flusher->cqBytes);
+  }
+  if (flusher->sqRing != MAP_FAILED) {
+    munmap(flusher->sqRing, flusher->sqBytes);
+  }
+  if (flusher->ring >= 0) {
+    close(flusher->ring);
+  }
+  flusher->ring = -1;
+}
+
+/**
+ * @private
+ */
+void _setupRingDA(dynArrayFlusher *flusher) {
+  struct io_uring_params params = {0};
+  flusher->sqRing = flusher->cqRing = flusher->sqes = MAP_FAILED;
+  flusher->ring = syscall(__NR_io_uring_setup, FLUSH_QUEUE * 2, &params);
+
+  if (flusher->ring >= 0) {
+    flusher->sqBytes =
+        params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+    flusher->cqBytes =
+        params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+    flusher->sqeBytes = params.sq_entries * sizeof(struct io_uring_sqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single && flusher->cqBytes > flusher->sqBytes) {
+      flusher->sqBytes = flusher->cqBytes;
+    }
+
+    flusher->sqRing = mmap(NULL, flusher->sqBytes, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, flusher->ring,
+                           IORING_OFF_SQ_RING);
+    flusher->cqRing =
+        single ? flusher->sqRing
+               : mmap(NULL, flusher->cqBytes, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, flusher->ring,
+                      IORING_OFF_CQ_RING);
+    flusher->sqes = mmap(NULL, flusher->sqeBytes, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, flusher->ring,
+                         IORING_OFF_SQES);
+
+    if (flusher->sqRing != MAP_FAILED && flusher->cqRing != MAP_FAILED &&
+        flusher->sqes != MAP_FAILED) {
+      flusher->sqTail = flusher->sqRing + params.sq_off.tail;
+      flusher->sqMask = flusher->sqRing + params.sq_off.ring_mask;
+      flusher->sqArray = flusher->sqRing + params.sq_off.array;
+      flusher->cqHead = flusher->cqRing + params.cq_off.head;
+      flusher->cqTail = flusher->cqRing + params.cq_off.tail;
+      flusher->cqMask = flusher->cqRing + params.cq_off.ring_mask;
+      flusher->cqes = flusher->cqRing + params.cq_off.cqes;
+    } else {
+      DEBUG_LOG("Error mapping io_uring, using threads: %d\n", errno);
+      _freeRingDA(flusher);
+    }
+  } else {
+    DEBUG_LOG("Error creating io_uring, using threads: %d\n", errno);
+  }
+}
+
+/**
+ * @private
+ */
+void _queueRingDA(dynArrayFlusher *flusher, flushJob *job) {
+  unsigned tail = *flusher->sqTail;
+  unsigned index = tail & *flusher->sqMask;
+  struct io_uring_sqe *sqe = &flusher->sqes[index];
+
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  sqe->opcode = IORING_OP_WRITE;
+  sqe->fd = job->fd;
+  sqe->addr = (uintptr_t)job->data;
+  // longer writes complete short and are queued again for the rest
+  sqe->len = (job->length < FLUSH_MAX_WRITE) ? job->length : FLUSH_MAX_WRITE;
+  sqe->off = job->offset;
+  sqe->user_data = (uintptr_t)job;
+  flusher->sqArray[index] = index;
+
+  __atomic_store_n(flusher->sqTail, tail + 1, __ATOMIC_RELEASE);
+  flusher->queued++;
+}
+
+/**
+ * @private
+ */
+void _enterRingDA(dynArrayFlusher *flusher, const bool wait) {
+  int rtn;
+  do {
+    rtn = syscall(__NR_io_uring_enter, flusher->ring, flusher->queued,
+                  wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+  } while (rtn < 0 && errno == EINTR);
+
+  if (rtn < 0) {
+    EXIT_ERROR("Error submitting to io_uring: %d\n", errno);
+  }
+  flusher->queued = 0;
+}
+
+/**
+ * @private
+ */
+void _completeRingJobDA(dynArrayFlusher *flusher, flushJob *job,
+                        const int result) {
+  dynArrayFlush *flush = job->flush;
+
+  if (result <= 0) {
+    DEBUG_LOG("Error writing flush at: %ld\n", job->offset);
+    flush->failed = true;
+    job->length = 0;
+  } else {
+    job->data += result;
+    job->length -= result;
+    job->offset += result;
+  }
+
+  if (job->length > 0) {
+    _queueRingDA(flusher, job);
+  } else if (job == &flush->jobs[flush->count]) {
+    flush->done = true;
+  } else if (--flush->pending == 0 && !flush->failed) {
+    // the header is only written once the data is in place
+    _queueRingDA(flusher, &flush->jobs[flush->count]);
+  } else if (flush->pending == 0) {
+    flush->done = true;
+  }
+}
+
+/**
+ * @private
+ */
+void _reapRingDA(dynArrayFlusher *flusher) {
+  unsigned head = *flusher->cqHead;
+
+  while (head != __atomic_load_n(flusher->cqTail, __ATOMIC_ACQUIRE)) {
+    struct io_uring_cqe *cqe = &flusher->cqes[head & *flusher->cqMask];
+    _completeRingJobDA(flusher, (flushJob *)(uintptr_t)cqe->user_data,
+                       cqe->res);
+    head++;
+  }
+  __atomic_store_n(flusher->cqHead, head, __ATOMIC_RELEASE);
+
+  if (flusher->queued > 0) {
+    _enterRingDA(flusher, false);
+  }
+}
+
+/**
+ * @private
+ */
+bool _writeJobDA(flushJob *job) {
+  bool written = true;
+
+  while (written && job->length > 0) {
+    ssize_t rtn = pwrite(job->fd, job->data, job->length, job->offset);
+    if (rtn > 0) {
+      job->data += rtn;
+      job->length -= rtn;
+      job->offset += rtn;
+    } else if (rtn == 0 || errno != EINTR) {
+      DEBUG_LOG("Error writing flush at: %ld\n", job->offset);
+      written = false;
+    }
+  }
+
+  return written;
+}
+
+/**
+ * @private
+ */
+void *_flushWorkerDA(void *ref) {
+  dynArrayFlush *flush = ref;
+  size_t index;
+
+  while ((index = __atomic_fetch_add(&flush->next, 1, __ATOMIC_RELAXED)) <
+         flush->count) {
+    if (!_writeJobDA(&flush->jobs[index])) {
+      __atomic_store_n(&flush->failed, true, __ATOMIC_RELAXED);
+    }
+    if (__atomic_sub_fetch(&flush->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+      // the last data write to finish writes the header
+      if (!__atomic_load_n(&flush->failed, __ATOMIC_RELAXED) &&
+          !_writeJobDA(&flush->jobs[flush->count])) {
+        __atomic_store_n(&flush->failed, true, __ATOMIC_RELAXED);
+      }
+      __atomic_store_n(&flush->done, true, __ATOMIC_RELEASE);
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @private
+ */
+static inline void _addJobDA(dynArrayFlush *flush, const size_t index,
+                             const int fd, const void *image,
+                             const size_t from, const size_t to) {
+  flush->jobs[index] = (flushJob){.flush = flush,
+                                  .fd = fd,
+                                  .data = image + from,
+                                  .length = to - from,
+                                  .offset = from};
+}
+
+/**
+ * @private
+ */
+void _planFlushDA(dynArrayFlush *flush, const void *image, const size_t end) {
+  dynArrayFlusher *flusher = flush->flusher;
+  bool direct = flusher->directFd != -1;
+  size_t head = (end < FLUSH_PAGE) ? end : FLUSH_PAGE;
+
+  // split the data into at most FLUSH_QUEUE page aligned writes
+  size_t chunk = (end - head + FLUSH_QUEUE - 1) / FLUSH_QUEUE;
+  chunk = ((chunk + FLUSH_PAGE - 1) / FLUSH_PAGE) * FLUSH_PAGE;
+  chunk = (chunk < FLUSH_CHUNK) ? FLUSH_CHUNK : chunk;
+
+  for (size_t from = head; from < end; from += chunk) {
+    size_t to = (end - from < chunk) ? end : from + chunk;
+    // direct writes must cover whole pages, so the tail is buffered
+    size_t aligned = direct ? (to / FLUSH_PAGE) * FLUSH_PAGE : to;
+    if (aligned > from) {
+      _addJobDA(flush, flush->count++, direct ? flusher->directFd : flusher->fd,
+                image, from, aligned);
+    }
+    if (to > aligned) {
+      _addJobDA(flush, flush->count++, flusher->fd, image, aligned, to);
+    }
+  }
+
+  _addJobDA(flush, flush->count,
+            (direct && head == FLUSH_PAGE) ? flusher->directFd : flusher->fd,
+            image, 0, head);
+  flush->pending = flush->count;
+}
+
+/**
+ * @private
+ */
+void _startFlushDA(dynArrayFlush *flush) {
+  dynArrayFlusher *flusher = flush->flusher;
+
+  if (flusher->ring >= 0) {
+    flush->joined = true;
+    if (flush->count == 0) {
+      _queueRingDA(flusher, &flush->jobs[0]);
+    }
+    for (size_t i = 0; i < flush->count; i++) {
+      _queueRingDA(flusher, &flush->jobs[i]);
+    }
+    _enterRingDA(flusher, false);
+  } else if (flush->count == 0) {
+    flush->failed = !_writeJobDA(&flush->jobs[0]);
+    flush->done = true;
+    flush->joined = true;
+  } else {
+    size_t threads = (flush->count < FLUSH_THREADS) ? flush->count
+                                                    : FLUSH_THREADS;
+    for (; flush->threads < threads; flush->threads++) {
+      if (pthread_create(&flush->thread[flush->threads], NULL, _flushWorkerDA,
+                         flush) != 0) {
+        break;
+      }
+    }
+    if (flush->threads == 0) {
+      _flushWorkerDA(flush);
+    }
+  }
+}
+
+/**
+ * @private
+ */
+void _progressFlushDA(dynArrayFlush *flush, const bool wait) {
+  if (!__atomic_load_n(&flush->done, __ATOMIC_ACQUIRE) &&
+      flush->flusher->ring >= 0) {
+    _reapRingDA(flush->flusher);
+    while (wait && !flush->done) {
+      _enterRingDA(flush->flusher, true);
+      _reapRingDA(flush->flusher);
+    }
+  }
+
+  if (wait && !flush->joined) {
+    for (size_t i = 0; i < flush->threads; i++) {
+      pthread_join(flush->thread[i], NULL);
+    }
+    flush->joined = true;
+  }
+}
+
+/**
+ * @private
+ */
+dynArrayFlusher *_createFlusherDA(FILE *fp, const char *filename,
+                                  const bool directIO) {
+  dynArrayFlusher *flusher = _safeCalloc(1, sizeof(dynArrayFlusher));
+  struct stat st;
+
+  flusher->fd = fileno(fp);
+  flusher->length = (fstat(flusher->fd, &st) == 0) ? st.st_size : 0;
+  flusher->directFd = directIO ? open(filename, O_WRONLY | O_DIRECT) : -1;
+  if (directIO && flusher->directFd == -1) {
+    DEBUG_LOG("Error opening for direct I/O, using buffered: %s\n", filename);
+  }
+
+#ifdef NO_URING
+  flusher->sqRing = flusher->cqRing = flusher->sqes = MAP_FAILED;
+  flusher->ring = -1;
+#else
+  _setupRingDA(flusher);
+#endif // NO_URING
+
+  return flusher;
+}
+
+/**
+ * @private
+ */
+void _drainFlusherDA(dynArrayFlusher *flusher) {
+  if (flusher->active != NULL) {
+    _progressFlushDA(flusher->active, true);
+    flusher->active->active = false;
+    flusher->active = NULL;
+  }
+}
+
+/**
+ * @private
+ */
+void _freeFlusherDA(dynArrayFlusher *flusher) {
+  _drainFlusherDA(flusher);
+  _freeRingDA(flusher);
+  if (flusher->directFd != -1) {
+    close(flusher->directFd);
+  }
+  free(flusher);
+}
+
+dynArrayFlush *flushDA(dynArray *pDA) {
+  dynArrayFlush *flush = NULL;
+
+  if (pDA->flusher != NULL) {
+    dynArrayFlusher *flusher = pDA->flusher;
+    _drainFlusherDA(flusher);
+    _updateMMap(pDA);
+
+    // keep the file as long as a mapped file, so either mode can load it
+    size_t length = pDA->offset + (pDA->capacity * pDA->elementSize);
+    if (flusher->length < length) {
+      if (ftruncate(flusher->fd, length) != 0) {
+        EXIT_ERROR("Error extending write back file. Length: %lu\n", length);
+      }
+      flusher->length = length;
+    }
+
+    flush = _safeCalloc(1, sizeof(dynArrayFlush));
+    flush->flusher = flusher;
+    _planFlushDA(flush, pDA->array - pDA->offset,
+                 pDA->offset + (pDA->size * pDA->elementSize));
+    flusher->active = flush;
+    flush->active = true;
+    _startFlushDA(flush);
+  }
+
+  return flush;
+}
+
+bool pollFlushDA(dynArrayFlush *flush) {
+  _progressFlushDA(flush, false);
+  return __atomic_load_n(&flush->done, __ATOMIC_ACQUIRE);
+}
+
+bool waitFlushDA(dynArrayFlush *flush) {
+  bool written = false;
+
+  if (flush != NULL) {
+    _progressFlushDA(flush, true);
+    if (flush->active) {
+      flush->flusher->active = NULL;
+    }
+    written = !flush->failed;
+    free(flush);
+  }
+
+  return written;
+}
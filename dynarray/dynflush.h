@@ -0,0 +1,105 @@
+#ifndef DYNFLUSH_H
+#define DYNFLUSH_H
+
+#include "dynarray.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file dynflush.h
+ *
+ * @brief Dynamic Array write back header file
+ *
+ * Write back arrays keep the file image in memory and write it to the file
+ * on request, rather than mapping the file. For example:
+ *
+ * dynArrayFlush *flush = flushDA(pDALng);
+ * ...
+ * waitFlushDA(flush);
+ *
+ * Writes are submitted through io_uring where the kernel allows it, falling
+ * back to a pool of pwrite threads. The file layout is the same as for memory
+ * mapped arrays, so either mode can load the file.
+ */
+
+/**
+ * @brief The page size used to align write back images and direct writes
+ */
+#define FLUSH_PAGE 4096
+
+/**
+ * @brief The smallest write submitted for a flush
+ */
+#define FLUSH_CHUNK (1024 * 1024)
+
+/**
+ * @brief The most writes submitted for a single flush
+ */
+#define FLUSH_QUEUE 64
+
+/**
+ * @brief The number of threads used when io_uring is not available
+ */
+#define FLUSH_THREADS 4
+
+/**
+ * @brief A flush completion handle
+ */
+typedef struct DynamicArrayFlush dynArrayFlush;
+
+/**
+ * @brief Start writing a write back array to its file
+ *
+ * The header is written once all of the data writes have completed. The
+ * array must not be changed until the flush completes. Only one flush is in
+ * progress at a time, so any earlier flush is completed first.
+ *
+ * @param pDA the write back array pointer to flush
+ * @return a handle that should be passed to waitFlushDA(), or NULL if the
+ * array is not a write back array
+ */
+dynArrayFlush *flushDA(dynArray *pDA);
+
+/**
+ * @brief Check if a flush has completed
+ *
+ * This also moves the flush on, so it should be called while polling.
+ *
+ * @param flush the flush handle
+ * @return 'true' if every write has completed
+ */
+bool pollFlushDA(dynArrayFlush *flush);
+
+/**
+ * @brief Wait for a flush to complete and free the handle
+ *
+ * The writes are not synced, call syncDAMap() for that.
+ *
+ * @param flush the flush handle or NULL
+ * @return 'true' if every write succeeded
+ */
+bool waitFlushDA(dynArrayFlush *flush);
+
+/**
+ * @private
+ */
+struct DynamicArrayFlusher *_createFlusherDA(FILE *fp, const char *filename,
+                                             bool directIO);
+
+/**
+ * @private
+ */
+void _drainFlusherDA(struct DynamicArrayFlusher *flusher);
+
+/**
+ * @private
+ */
+void _freeFlusherDA(struct DynamicArrayFlusher *flusher);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
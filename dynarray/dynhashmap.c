@@ -0,0 +1,271 @@
+#include "dynhashmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @private
+ */
+#define HM_EMPTY 0
+
+/**
+ * @private
+ */
+static inline hashMapNode *_nodeHM(const hashMap *pHM, const uint32_t link) {
+  return (hashMapNode *)pHM->nodes->array + (link - 1);
+}
+
+/**
+ * @private
+ */
+static inline uint32_t *_bucketHM(const hashMap *pHM, const uint32_t hash) {
+  // keys stay in the old table until their old bucket has been moved
+  if (pHM->old != NULL) {
+    size_t bucket = hash & (pHM->old->size - 1);
+    if (bucket >= pHM->migrated) {
+      return (uint32_t *)pHM->old->array + bucket;
+    }
+  }
+  return (uint32_t *)pHM->buckets->array + (hash & (pHM->buckets->size - 1));
+}
+
+/**
+ * @private
+ */
+static inline dynArrayParams _arrayParamsHM(const size_t count,
+                                            const size_t size) {
+  // a mapping takes at least a huge page, so only large tables are mapped
+  return (dynArrayParams){.capacity = count,
+                          .hugePages = count * size >= HUGE_PAGE_SIZE};
+}
+
+/**
+ * @private
+ */
+dynArray *_createBucketsHM(const size_t count) {
+  // both mapped pages and heap arrays start zero, so the buckets start empty
+  // without a fill
+  dynArrayParams params = _arrayParamsHM(count, sizeof(uint32_t));
+  dynArray *buckets = createDA(sizeof(uint32_t), NULL, &params);
+  emplaceArrayDA(buckets, count);
+  return buckets;
+}
+
+/**
+ * @private
+ */
+void _migrateHM(hashMap *pHM, size_t buckets) {
+  uint32_t *old = pHM->old->array;
+  uint32_t *heads = pHM->buckets->array;
+  size_t mask = pHM->buckets->size - 1;
+
+  for (; buckets > 0 && pHM->migrated < pHM->old->size; buckets--) {
+    // the chain is relinked node by node into the new buckets
+    uint32_t link = old[pHM->migrated];
+    while (link != HM_EMPTY) {
+      hashMapNode *node = _nodeHM(pHM, link);
+      uint32_t next = node->next;
+      node->next = heads[node->hash & mask];
+      heads[node->hash & mask] = link;
+      link = next;
+    }
+    old[pHM->migrated++] = HM_EMPTY;
+  }
+
+  if (pHM->migrated == pHM->old->size) {
+    freeDA(pHM->old);
+    pHM->old = NULL;
+    pHM->migrated = 0;
+  }
+}
+
+/**
+ * @private
+ */
+void _growHM(hashMap *pHM) {
+  if (pHM->old != NULL) {
+    // only one resize at a time, so the last must finish first
+    _migrateHM(pHM, pHM->old->size);
+  }
+
+  size_t count = pHM->buckets->size * 2;
+  if (count > UINT32_MAX) {
+    EXIT_ERROR("Hash map full. Buckets: %lu\n", pHM->buckets->size);
+  }
+  pHM->old = pHM->buckets;
+  pHM->buckets = _createBucketsHM(count);
+  pHM->migrated = 0;
+}
+
+/**
+ * @private
+ */
+static inline uint32_t *_findHM(const hashMap *pHM, const keyEntry *kEntry,
+                                const uint32_t hash) {
+  uint32_t *link = _bucketHM(pHM, hash);
+
+  // the link to the matching node, or the end of the chain
+  while (*link != HM_EMPTY) {
+    hashMapNode *node = _nodeHM(pHM, *link);
+    if (node->hash == hash &&
+        pHM->compare(kEntry->key, node->kEntry->key) == 0) {
+      break;
+    }
+    link = &node->next;
+  }
+
+  return link;
+}
+
+/**
+ * @private
+ */
+static inline void _stepHM(hashMap *pHM) {
+  if (pHM->old != NULL) {
+    _migrateHM(pHM, pHM->migrate);
+  }
+}
+
+hashMap *createHM(int compare(const void *a, const void *b),
+                  const hashMapParams *params) {
+  hashMapParams defaults =
+      (hashMapParams){.capacity = 16, .loadFactor = 1.0, .migrate = 4};
+  hashMap *pHM = _safeCalloc(1, sizeof(hashMap));
+
+  if (params == NULL) {
+    params = &defaults;
+  }
+
+  size_t count = 1;
+  while (count < params->capacity) {
+    count *= 2;
+  }
+
+  pHM->compare = compare;
+  pHM->loadFactor =
+      (params->loadFactor > 0) ? params->loadFactor : defaults.loadFactor;
+  pHM->migrate = (params->migrate > 0) ? params->migrate : defaults.migrate;
+  // the nodes are mapped only when the initial capacity fills a huge page,
+  // otherwise they stay on the heap and grow with realloc()
+  dynArrayParams nodeParams = _arrayParamsHM(count, sizeof(hashMapNode));
+  pHM->nodes = createDA(sizeof(hashMapNode), NULL, &nodeParams);
+  pHM->buckets = _createBucketsHM(count);
+
+  return pHM;
+}
+
+void freeHM(hashMap *pHM) {
+  if (pHM) {
+    freeDA(pHM->nodes);
+    freeDA(pHM->buckets);
+    freeDA(pHM->old);
+    free(pHM);
+  }
+}
+
+void setHM(hashMap *pHM, const keyEntry *kEntry, void *value) {
+  uint32_t hash = hashKey(kEntry, 0);
+  _stepHM(pHM);
+
+  uint32_t *link = _findHM(pHM, kEntry, hash);
+  if (*link != HM_EMPTY) {
+    // key matches so replace value
+    _nodeHM(pHM, *link)->value = value;
+    return;
+  }
+
+  uint32_t added;
+  if (pHM->freeNode != HM_EMPTY) {
+    added = pHM->freeNode;
+    pHM->freeNode = _nodeHM(pHM, added)->next;
+  } else if (pHM->nodes->size < UINT32_MAX) {
+    emplaceDA(pHM->nodes);
+    added = pHM->nodes->size;
+  } else {
+    EXIT_ERROR("Hash map full. Entries: %lu\n", pHM->count);
+  }
+
+  // new nodes go at the head of their bucket
+  uint32_t *head = _bucketHM(pHM, hash);
+  *_nodeHM(pHM, added) = (hashMapNode){
+      .hash = hash, .next = *head, .kEntry = kEntry, .value = value};
+  *head = added;
+  pHM->count++;
+
+  if (pHM->count > pHM->buckets->size * pHM->loadFactor) {
+    _growHM(pHM);
+  }
+}
+
+hashMapNode *getHM(hashMap *pHM, const keyEntry *kEntry) {
+  _stepHM(pHM);
+  uint32_t link = *_findHM(pHM, kEntry, hashKey(kEntry, 0));
+  return (link != HM_EMPTY) ? _nodeHM(pHM, link) : NULL;
+}
+
+bool hasEntryHM(hashMap *pHM, const keyEntry *kEntry) {
+  return getHM(pHM, kEntry) != NULL;
+}
+
+bool deleteHM(hashMap *pHM, const keyEntry *kEntry) {
+  return deleteCallbackHM(pHM, kEntry, NULL, NULL);
+}
+
+bool deleteCallbackHM(hashMap *pHM, const keyEntry *kEntry,
+                      void deleted(const hashMap *pHM, const keyEntry *kEntry,
+                                   void *value, void *ref),
+                      void *ref) {
+  _stepHM(pHM);
+  uint32_t *link = _findHM(pHM, kEntry, hashKey(kEntry, 0));
+  uint32_t found = *link;
+
+  if (found != HM_EMPTY) {
+    hashMapNode *node = _nodeHM(pHM, found);
+    if (deleted != NULL) {
+      deleted(pHM, node->kEntry, node->value, ref);
+    }
+
+    // unlink the node and keep it for reuse
+    *link = node->next;
+    node->next = pHM->freeNode;
+    node->kEntry = NULL;
+    node->value = NULL;
+    pHM->freeNode = found;
+    pHM->count--;
+  }
+
+  return found != HM_EMPTY;
+}
+
+bool rehashHM(hashMap *pHM, size_t buckets) {
+  if (pHM->old != NULL) {
+    _migrateHM(pHM, buckets);
+  }
+  return pHM->old != NULL;
+}
+
+void visitHM(const hashMap *pHM,
+             bool visit(const hashMapNode *node, void *ref), void *ref) {
+  bool cont = true;
+
+  // free nodes have no key, so the node array is read in order
+  for (size_t i = 0; cont && i < pHM->nodes->size; i++) {
+    hashMapNode *node = (hashMapNode *)pHM->nodes->array + i;
+    if (node->kEntry != NULL) {
+      cont = visit(node, ref);
+    }
+  }
+}
+
+size_t sizeHM(const hashMap *pHM) { return pHM->count; }
+
+void clearHM(hashMap *pHM) {
+  if (pHM) {
+    clearDA(pHM->nodes);
+    memset(pHM->buckets->array, 0, pHM->buckets->size * sizeof(uint32_t));
+    freeDA(pHM->old);
+    pHM->old = NULL;
+    pHM->migrated = 0;
+    pHM->count = 0;
+    pHM->freeNode = HM_EMPTY;
+  }
+}
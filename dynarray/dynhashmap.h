@@ -0,0 +1,176 @@
+#ifndef DYNHASHMAP_H
+#define DYNHASHMAP_H
+
+#include "dynarray.h"
+#include "hashtree.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file dynhashmap.h
+ *
+ * @brief Dynamic Array hash map header file
+ *
+ * A hash table of chained buckets, for keys that are only looked up and never
+ * scanned in order. For example:
+ *
+ * hashMap *pHM = createHM(compareString, NULL);
+ * setHM(pHM, &(keyEntry){.key = "key", .length = 3}, value);
+ * hashMapNode *found = getHM(pHM, &(keyEntry){.key = "key", .length = 3});
+ *
+ * The map grows by doubling its buckets once the entries reach the load
+ * factor. Rather than moving every entry at once, the old buckets are kept and
+ * each setHM(), getHM() and deleteHM() moves a few of them into the new
+ * table, so no single call pays for the whole resize. Until then both tables
+ * are searched, each key in the one its old bucket has reached. Entries are
+ * relinked rather than copied, as they live in a separate node array.
+ *
+ * Bucket tables of a huge page or more are anonymous mappings and smaller
+ * ones stay on the heap. Either way new buckets need no initial fill. The node
+ * array is placed once from the initial capacity, so unless createHM() is
+ * given a capacity that fills a huge page the nodes stay on the heap and grow
+ * with realloc().
+ * Keys and values are held by pointer, as with the hash tree.
+ */
+
+/**
+ * @brief A hash map entry
+ */
+typedef struct HashMapNode {
+  uint32_t hash;          ///< the hash
+  uint32_t next;          ///< the next node in the bucket, see hashMap
+  const keyEntry *kEntry; ///< the key
+  void *value;            ///< the value
+} hashMapNode;
+
+/**
+ * @brief Hash map entity
+ *
+ * Nodes are linked by their index plus one, so a zero link is the end of a
+ * bucket.
+ */
+typedef struct HashMap {
+  dynArray *nodes;   ///< the hashMapNode entries
+  dynArray *buckets; ///< the first node of each bucket, a power of two
+  dynArray *old;     ///< the buckets being moved from while resizing, else NULL
+  size_t migrated;   ///< the old buckets moved so far
+  size_t count;      ///< the number of entries
+  uint32_t freeNode; ///< the first free node or 0
+  float loadFactor;  ///< the entries per bucket that start a resize
+  size_t migrate;    ///< the old buckets moved by each call
+  int (*compare)(const void *a, const void *b); ///< the key comparator
+} hashMap;
+
+/**
+ * @brief Hash map creation parameters
+ */
+typedef struct HashMapParams {
+  size_t capacity;  ///< the initial buckets, rounded up to a power of two
+  float loadFactor; ///< the entries per bucket that start a resize
+  size_t migrate;   ///< the old buckets moved by each call while resizing
+} hashMapParams;
+
+/**
+ * @brief Create a hash map
+ * @param compare the key comparator function
+ * @param params a pointer to the map parameters or NULL for default
+ * @return the map that should be freed with freeHM()
+ */
+hashMap *createHM(int compare(const void *a, const void *b),
+                  const hashMapParams *params);
+
+/**
+ * @brief Free a hash map
+ * @param pHM the map to free
+ */
+void freeHM(hashMap *pHM);
+
+/**
+ * @brief Set the value for a key
+ * @param pHM the map to update
+ * @param kEntry the key entry, which must outlive the map entry
+ * @param value the value
+ */
+void setHM(hashMap *pHM, const keyEntry *kEntry, void *value);
+
+/**
+ * @brief Find the entry for a key
+ * @param pHM the map to search
+ * @param kEntry the key entry
+ * @return the entry, valid until the map is next changed, or NULL if not found
+ */
+hashMapNode *getHM(hashMap *pHM, const keyEntry *kEntry);
+
+/**
+ * @brief Check for a key
+ * @param pHM the map to search
+ * @param kEntry the key entry
+ * @return 'true' if the key is in the map
+ */
+bool hasEntryHM(hashMap *pHM, const keyEntry *kEntry);
+
+/**
+ * @brief Delete a key
+ * @param pHM the map to update
+ * @param kEntry the key entry to delete
+ * @return 'true' if the key was found
+ */
+bool deleteHM(hashMap *pHM, const keyEntry *kEntry);
+
+/**
+ * @brief Delete a key, calling a method with the entry before removing it
+ * @param pHM the map to update
+ * @param kEntry the key entry to delete
+ * @param deleted the method called with the deleted entry, may be NULL
+ * @param ref optional value to pass to the deleted method, maybe NULL
+ * @return 'true' if the key was found
+ */
+bool deleteCallbackHM(hashMap *pHM, const keyEntry *kEntry,
+                      void deleted(const hashMap *pHM, const keyEntry *kEntry,
+                                   void *value, void *ref),
+                      void *ref);
+
+/**
+ * @brief Move old buckets into the resized table
+ *
+ * Calls move a few buckets as they go, this moves more, for example while
+ * the map is idle.
+ *
+ * @param pHM the map to update
+ * @param buckets the most old buckets to move
+ * @return 'true' if old buckets remain
+ */
+bool rehashHM(hashMap *pHM, size_t buckets);
+
+/**
+ * @brief Vist each entry in no particular order
+ *
+ * If the visitor method returns false then the visit will stop.
+ *
+ * @param pHM the map to visit
+ * @param visit the function to call for each entry
+ * @param ref optional value to pass to visit method, maybe NULL
+ */
+void visitHM(const hashMap *pHM,
+             bool visit(const hashMapNode *node, void *ref), void *ref);
+
+/**
+ * @brief The number of entries in the map
+ * @param pHM the map
+ * @return the number of entries
+ */
+size_t sizeHM(const hashMap *pHM);
+
+/**
+ * @brief Remove all the entries, keeping the buckets
+ * @param pHM the map to clear
+ */
+void clearHM(hashMap *pHM);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
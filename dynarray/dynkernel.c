@@ -0,0 +1,647 @@
+#include "dynkernel.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNEL_X86
+#define KERNEL_AVX2 __attribute__((target("avx2")))
+#define KERNEL_SSE2 __attribute__((target("sse2")))
+#endif
+
+/**
+ * @private
+ */
+static dynKernelLevel _kernelMaxDA = KernelAVX2;
+
+/**
+ * @private
+ */
+static inline size_t _kernelSizeDA(const dynKernelType type) {
+  return (type == KernelInt32 || type == KernelFloat) ? 4 : 8;
+}
+
+/**
+ * @private
+ */
+dynKernelLevel _kernelLevelDA(void) {
+  static int detected = -1;
+  if (detected == -1) {
+    dynKernelLevel level = KernelScalar;
+#ifdef KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      level = KernelAVX2;
+    } else if (__builtin_cpu_supports("sse2")) {
+      level = KernelSSE2;
+    }
+#endif
+    detected = level;
+  }
+  return ((dynKernelLevel)detected < _kernelMaxDA) ? (dynKernelLevel)detected
+                                                   : _kernelMaxDA;
+}
+
+/**
+ * @private
+ */
+#define KERNEL_CASES(type, CASE)                                               \
+  switch (type) {                                                              \
+  case KernelInt32:                                                            \
+    CASE(int32_t);                                                             \
+    break;                                                                     \
+  case KernelInt64:                                                            \
+    CASE(int64_t);                                                             \
+    break;                                                                     \
+  case KernelFloat:                                                            \
+    CASE(float);                                                               \
+    break;                                                                     \
+  case KernelDouble:                                                           \
+    CASE(double);                                                              \
+    break;                                                                     \
+  }
+
+/**
+ * @private
+ */
+size_t _findScalarDA(const dynKernelType type, const void *array, size_t from,
+                     const size_t size, const void *value) {
+#define FIND_SCALAR(T)                                                         \
+  for (; from < size && ((const T *)array)[from] != *(const T *)value;         \
+       from++) {                                                               \
+  }
+  KERNEL_CASES(type, FIND_SCALAR)
+#undef FIND_SCALAR
+  return from;
+}
+
+/**
+ * @private
+ */
+size_t _countScalarDA(const dynKernelType type, const void *array,
+                      size_t from, const size_t size, const void *value) {
+  size_t count = 0;
+#define COUNT_SCALAR(T)                                                        \
+  for (; from < size; from++) {                                                \
+    count += ((const T *)array)[from] == *(const T *)value;                    \
+  }
+  KERNEL_CASES(type, COUNT_SCALAR)
+#undef COUNT_SCALAR
+  return count;
+}
+
+/**
+ * @private
+ */
+void _minMaxScalarDA(const dynKernelType type, const void *array, size_t from,
+                     const size_t size, void *min, void *max) {
+#define MINMAX_SCALAR(T)                                                       \
+  for (; from < size; from++) {                                                \
+    T value = ((const T *)array)[from];                                        \
+    if (value < *(T *)min) {                                                   \
+      *(T *)min = value;                                                       \
+    }                                                                          \
+    if (value > *(T *)max) {                                                   \
+      *(T *)max = value;                                                       \
+    }                                                                          \
+  }
+  KERNEL_CASES(type, MINMAX_SCALAR)
+#undef MINMAX_SCALAR
+}
+
+/**
+ * @private
+ */
+void _sumScalarDA(const dynKernelType type, const void *array, size_t from,
+                  const size_t size, void *sum) {
+  // integers wrap rather than overflow
+#define SUM_INTEGER(T)                                                         \
+  for (; from < size; from++) {                                                \
+    *(int64_t *)sum = (int64_t)((uint64_t) * (int64_t *)sum +                  \
+                                (uint64_t)(int64_t)((const T *)array)[from]);  \
+  }
+#define SUM_FLOAT(T)                                                           \
+  for (; from < size; from++) {                                                \
+    *(double *)sum += ((const T *)array)[from];                                \
+  }
+  switch (type) {
+  case KernelInt32:
+    SUM_INTEGER(int32_t);
+    break;
+  case KernelInt64:
+    SUM_INTEGER(int64_t);
+    break;
+  case KernelFloat:
+    SUM_FLOAT(float);
+    break;
+  case KernelDouble:
+    SUM_FLOAT(double);
+    break;
+  }
+#undef SUM_INTEGER
+#undef SUM_FLOAT
+}
+
+#ifdef KERNEL_X86
+/**
+ * @private
+ */
+KERNEL_AVX2 static inline int _equalAvx2DA(const dynKernelType type,
+                                           const void *p, const void *value) {
+  int mask = 0;
+  switch (type) {
+  case KernelInt32:
+    mask = _mm256_movemask_ps(_mm256_castsi256_ps(
+        _mm256_cmpeq_epi32(_mm256_loadu_si256(p),
+                           _mm256_set1_epi32(*(const int32_t *)value))));
+    break;
+  case KernelInt64:
+    mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+        _mm256_cmpeq_epi64(_mm256_loadu_si256(p),
+                           _mm256_set1_epi64x(*(const int64_t *)value))));
+    break;
+  case KernelFloat:
+    mask = _mm256_movemask_ps(_mm256_cmp_ps(
+        _mm256_loadu_ps(p), _mm256_set1_ps(*(const float *)value), _CMP_EQ_OQ));
+    break;
+  case KernelDouble:
+    mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(p),
+                                            _mm256_set1_pd(*(const double *)value),
+                                            _CMP_EQ_OQ));
+    break;
+  }
+  return mask;
+}
+
+/**
+ * @private
+ */
+KERNEL_SSE2 static inline int _equalSse2DA(const dynKernelType type,
+                                           const void *p, const void *value) {
+  int mask = 0;
+  __m128i equal;
+  switch (type) {
+  case KernelInt32:
+    mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(
+        _mm_loadu_si128(p), _mm_set1_epi32(*(const int32_t *)value))));
+    break;
+  case KernelInt64:
+    // both halves of a lane must match
+    equal = _mm_cmpeq_epi32(_mm_loadu_si128(p),
+                            _mm_set1_epi64x(*(const int64_t *)value));
+    equal = _mm_and_si128(equal, _mm_shuffle_epi32(equal, 0xB1));
+    mask = _mm_movemask_pd(_mm_castsi128_pd(equal));
+    break;
+  case KernelFloat:
+    mask = _mm_movemask_ps(
+        _mm_cmpeq_ps(_mm_loadu_ps(p), _mm_set1_ps(*(const float *)value)));
+    break;
+  case KernelDouble:
+    mask = _mm_movemask_pd(
+        _mm_cmpeq_pd(_mm_loadu_pd(p), _mm_set1_pd(*(const double *)value)));
+    break;
+  }
+  return mask;
+}
+
+/**
+ * @private
+ */
+KERNEL_AVX2 size_t _findAvx2DA(const dynKernelType type, const void *array,
+                               const size_t size, const void *value) {
+  size_t es = _kernelSizeDA(type);
+  size_t lanes = 32 / es;
+  size_t i = 0;
+  int mask = 0;
+
+  for (; i + lanes <= size && !(mask = _equalAvx2DA(type, array + (i * es),
+                                                     value));
+       i += lanes) {
+  }
+  return (mask != 0) ? i + __builtin_ctz(mask) : i;
+}
+
+/**
+ * @private
+ */
+KERNEL_SSE2 size_t _findSse2DA(const dynKernelType type, const void *array,
+                               const size_t size, const void *value) {
+  size_t es = _kernelSizeDA(type);
+  size_t lanes = 16 / es;
+  size_t i = 0;
+  int mask = 0;
+
+  for (; i + lanes <= size && !(mask = _equalSse2DA(type, array + (i * es),
+                                                     value));
+       i += lanes) {
+  }
+  return (mask != 0) ? i + __builtin_ctz(mask) : i;
+}
+
+/**
+ * @private
+ */
+KERNEL_AVX2 size_t _countAvx2DA(const dynKernelType type, const void *array,
+                                const size_t size, const void *value,
+                                size_t *count) {
+  size_t es = _kernelSizeDA(type);
+  size_t lanes = 32 / es;
+  size_t i = 0;
+
+  for (; i + lanes <= size; i += lanes) {
+    *count += __builtin_popcount(_equalAvx2DA(type, array + (i * es), value));
+  }
+  return i;
+}
+
+/**
+ * @private
+ */
+KERNEL_SSE2 size_t _countSse2DA(const dynKernelType type, const void *array,
+                                const size_t size, const void *value,
+                                size_t *count) {
+  size_t es = _kernelSizeDA(type);
+  size_t lanes = 16 / es;
+  size_t i = 0;
+
+  for (; i + lanes <= size; i += lanes) {
+    *count += __builtin_popcount(_equalSse2DA(type, array + (i * es), value));
+  }
+  return i;
+}
+
+/**
+ * @private
+ */
+KERNEL_AVX2 size_t _minMaxAvx2DA(const dynKernelType type, const void *array,
+                                 const size_t size, void *min, void *max) {
+  size_t es = _kernelSizeDA(type);
+  size_t lanes = 32 / es;
+  size_t i = 0;
+  __m256i low, high;
+  __m256 lowF, highF;
+  __m256d lowD, highD;
+  uint8_t lows[32], highs[32];
+
+  if (size < lanes) {
+    return 0;
+  }
+  switch (type) {
+  case KernelInt32:
+    low = high = _mm256_loadu_si256(array);
+    for (i = lanes; i + lanes <= size; i += lanes) {
+      __m256i next = _mm256_loadu_si256(array + (i * es));
+      low = _mm256_min_epi32(low, next);
+      high = _mm256_max_epi32(high, next);
+    }
+    _mm256_storeu_si256((void *)lows, low);
+    _mm256_storeu_si256((void *)highs, high);
+    break;
+  case KernelInt64:
+    low = high = _mm256_loadu_si256(array);
+    for (i = lanes; i + lanes <= size; i += lanes) {
+      __m256i next = _mm256_loadu_si256(array + (i * es));
+      low = _mm256_blendv_epi8(low, next, _mm256_cmpgt_epi64(low, next));
+      high = _mm256_blendv_epi8(high, next, _mm256_cmpgt_epi64(next, high));
+    }
+    _mm256_storeu_si256((void *)lows, low);
+    _mm256_storeu_si256((void *)highs, high);
+    break;
+  case KernelFloat:
+    lowF = highF = _mm256_loadu_ps(array);
+    for (i = lanes; i + lanes <= size; i += lanes) {
+      __m256 next = _mm256_loadu_ps(array + (i * es));
+      lowF = _mm256_min_ps(next, lowF);
+      highF = _mm256_max_ps(next, highF);
+    }
+    _mm256_storeu_ps((void *)lows, lowF);
+    _mm256_storeu_ps((void *)highs, highF);
+    break;
+  case KernelDouble:
+    lowD = highD = _mm256_loadu_pd(array);
+    for (i = lanes; i + lanes <= size; i += lanes) {
+      __m256d next = _mm256_loadu_pd(array + (i * es));
+      lowD = _mm256_min_pd(next, lowD);
+      highD = _mm256_max_pd(next, highD);
+    }
+    _mm256_storeu_pd((void *)lows, lowD);
+    _mm256_storeu_pd((void *)highs, highD);
+    break;
+  }
+  _minMaxScalarDA(type, lows, 0, lanes, min, max);
+  _minMaxScalarDA(type, highs, 0, lanes, min, max);
+  return i;
+}
+
+/**
+ * @private
+ */
+KERNEL_SSE2 size_t _minMaxSse2DA(const dynKernelType type, const void *array,
+                                 const size_t size, void *min, void *max) {
+  size_t es = _kernelSizeDA(type);
+  size_t lanes = 16 / es;
+  size_t i = 0;
+  __m128i low, high;
+  __m128 lowF, highF;
+  __m128d lowD, highD;
+  uint8_t lows[16], highs[16];
+
+  // SSE2 has no 64 bit integer compare, so those are left to the scalar loop
+  if (size < lanes || type == KernelInt64) {
+    return 0;
+  }
+  switch (type) {
+  case KernelInt32:
+    low = high = _mm_loadu_si128(array);
+    for (i = lanes; i + lanes <= size; i += lanes) {
+      __m128i next = _mm_loadu_si128(array + (i * es));
+      __m128i less = _mm_cmplt_epi32(next, low);
+      __m128i more = _mm_cmpgt_epi32(next, high);
+      low = _mm_or_si128(_mm_and_si128(less, next), _mm_andnot_si128(less, low));
+      high =
+          _mm_or_si128(_mm_and_si128(more, next), _mm_andnot_si128(more, high));
+    }
+    _mm_storeu_si128((void *)lows, low);
+    _mm_storeu_si128((void *)highs, high);
+    break;
+  case KernelFloat:
+    lowF = highF = _mm_loadu_ps(array);
+    for (i = lanes; i + lanes <= size; i += lanes) {
+      __m128 next = _mm_loadu_ps(array + (i * es));
+      lowF = _mm_min_ps(next, lowF);
+      highF = _mm_max_ps(next, highF);
+    }
+    _mm_storeu_ps((void *)lows, lowF);
+    _mm_storeu_ps((void *)highs, highF);
+    break;
+  case KernelDouble:
+    lowD = highD = _mm_loadu_pd(array);
+    for (i = lanes; i + lanes <= size; i += lanes) {
+      __m128d next = _mm_loadu_pd(array + (i * es));
+      lowD = _mm_min_pd(next, lowD);
+      highD = _mm_max_pd(next, highD);
+    }
+    _mm_storeu_pd((void *)lows, lowD);
+    _mm_storeu_pd((void *)highs, highD);
+    break;
+  case KernelInt64:
+    break;
+  }
+  _minMaxScalarDA(type, lows, 0, lanes, min, max);
+  _minMaxScalarDA(type, highs, 0, lanes, min, max);
+  return i;
+}
+
+/**
+ * @private
+ */
+KERNEL_AVX2 size_t _sumAvx2DA(const dynKernelType type, const void *array,
+                              const size_t size, void *sum) {
+  size_t i = 0;
+  __m256i total = _mm256_setzero_si256();
+  __m256d totalD = _mm256_setzero_pd();
+  uint8_t lanes[32];
+
+  // four 64 bit sums at a time
+  switch (type) {
+  case KernelInt32:
+    for (; i + 4 <= size; i += 4) {
+      total = _mm256_add_epi64(
+          total, _mm256_cvtepi32_epi64(_mm_loadu_si128(array + (i * 4))));
+    }
+    break;
+  case KernelInt64:
+    for (; i + 4 <= size; i += 4) {
+      total = _mm256_add_epi64(total, _mm256_loadu_si256(array + (i * 8)));
+    }
+    break;
+  case KernelFloat:
+    for (; i + 4 <= size; i += 4) {
+      totalD = _mm256_add_pd(totalD,
+                             _mm256_cvtps_pd(_mm_loadu_ps(array + (i * 4))));
+    }
+    break;
+  case KernelDouble:
+    for (; i + 4 <= size; i += 4) {
+      totalD = _mm256_add_pd(totalD, _mm256_loadu_pd(array + (i * 8)));
+    }
+    break;
+  }
+  if (type == KernelInt32 || type == KernelInt64) {
+    _mm256_storeu_si256((void *)lanes, total);
+    _sumScalarDA(KernelInt64, lanes, 0, 4, sum);
+  } else {
+    _mm256_storeu_pd((void *)lanes, totalD);
+    _sumScalarDA(KernelDouble, lanes, 0, 4, sum);
+  }
+  return i;
+}
+
+/**
+ * @private
+ */
+KERNEL_SSE2 size_t _sumSse2DA(const dynKernelType type, const void *array,
+                              const size_t size, void *sum) {
+  size_t i = 0;
+  __m128i total = _mm_setzero_si128();
+  __m128d totalD = _mm_setzero_pd();
+  uint8_t lanes[16];
+
+  // two 64 bit sums at a time
+  switch (type) {
+  case KernelInt32:
+    for (; i + 4 <= size; i += 4) {
+      __m128i next = _mm_loadu_si128(array + (i * 4));
+      __m128i sign = _mm_cmpgt_epi32(_mm_setzero_si128(), next);
+      total = _mm_add_epi64(total, _mm_unpacklo_epi32(next, sign));
+      total = _mm_add_epi64(total, _mm_unpackhi_epi32(next, sign));
+    }
+    break;
+  case KernelInt64:
+    for (; i + 2 <= size; i += 2) {
+      total = _mm_add_epi64(total, _mm_loadu_si128(array + (i * 8)));
+    }
+    break;
+  case KernelFloat:
+    for (; i + 4 <= size; i += 4) {
+      __m128 next = _mm_loadu_ps(array + (i * 4));
+      totalD = _mm_add_pd(totalD, _mm_cvtps_pd(next));
+      totalD = _mm_add_pd(totalD, _mm_cvtps_pd(_mm_movehl_ps(next, next)));
+    }
+    break;
+  case KernelDouble:
+    for (; i + 2 <= size; i += 2) {
+      totalD = _mm_add_pd(totalD, _mm_loadu_pd(array + (i * 8)));
+    }
+    break;
+  }
+  if (type == KernelInt32 || type == KernelInt64) {
+    _mm_storeu_si128((void *)lanes, total);
+    _sumScalarDA(KernelInt64, lanes, 0, 2, sum);
+  } else {
+    _mm_storeu_pd((void *)lanes, totalD);
+    _sumScalarDA(KernelDouble, lanes, 0, 2, sum);
+  }
+  return i;
+}
+
+/**
+ * @private
+ */
+KERNEL_AVX2 size_t _fillAvx2DA(const dynKernelType type, void *array,
+                               const size_t size, const void *value) {
+  size_t es = _kernelSizeDA(type);
+  size_t lanes = 32 / es;
+  size_t i = 0;
+  __m256i pattern = (es == 4)
+                        ? _mm256_set1_epi32(*(const int32_t *)value)
+                        : _mm256_set1_epi64x(*(const int64_t *)value);
+
+  for (; i + lanes <= size; i += lanes) {
+    _mm256_storeu_si256(array + (i * es), pattern);
+  }
+  return i;
+}
+
+/**
+ * @private
+ */
+KERNEL_SSE2 size_t _fillSse2DA(const dynKernelType type, void *array,
+                               const size_t size, const void *value) {
+  size_t es = _kernelSizeDA(type);
+  size_t lanes = 16 / es;
+  size_t i = 0;
+  __m128i pattern = (es == 4) ? _mm_set1_epi32(*(const int32_t *)value)
+                              : _mm_set1_epi64x(*(const int64_t *)value);
+
+  for (; i + lanes <= size; i += lanes) {
+    _mm_storeu_si128(array + (i * es), pattern);
+  }
+  return i;
+}
+#endif // KERNEL_X86
+
+dynKernelLevel kernelLevelDA(dynKernelLevel max) {
+  _kernelMaxDA = max;
+  return _kernelLevelDA();
+}
+
+size_t findDA(const dynArray *pDA, dynKernelType type, const void *value) {
+  size_t from = 0;
+
+  if (pDA->elementSize != _kernelSizeDA(type)) {
+    return -1;
+  }
+#ifdef KERNEL_X86
+  switch (_kernelLevelDA()) {
+  case KernelAVX2:
+    from = _findAvx2DA(type, pDA->array, pDA->size, value);
+    break;
+  case KernelSSE2:
+    from = _findSse2DA(type, pDA->array, pDA->size, value);
+    break;
+  case KernelScalar:
+    break;
+  }
+#endif
+  // the vector loops stop at a match or before the last partial vector
+  from = _findScalarDA(type, pDA->array, from, pDA->size, value);
+  return (from < pDA->size) ? from : (size_t)-1;
+}
+
+size_t countDA(const dynArray *pDA, dynKernelType type, const void *value) {
+  size_t count = 0;
+  size_t from = 0;
+
+  if (pDA->elementSize != _kernelSizeDA(type)) {
+    return 0;
+  }
+#ifdef KERNEL_X86
+  switch (_kernelLevelDA()) {
+  case KernelAVX2:
+    from = _countAvx2DA(type, pDA->array, pDA->size, value, &count);
+    break;
+  case KernelSSE2:
+    from = _countSse2DA(type, pDA->array, pDA->size, value, &count);
+    break;
+  case KernelScalar:
+    break;
+  }
+#endif
+  return count + _countScalarDA(type, pDA->array, from, pDA->size, value);
+}
+
+bool minMaxDA(const dynArray *pDA, dynKernelType type, void *min, void *max) {
+  bool rtn = pDA->size > 0 && pDA->elementSize == _kernelSizeDA(type);
+  size_t from = 1;
+
+  if (rtn) {
+    memcpy(min, pDA->array, pDA->elementSize);
+    memcpy(max, pDA->array, pDA->elementSize);
+#ifdef KERNEL_X86
+    switch (_kernelLevelDA()) {
+    case KernelAVX2:
+      from = _minMaxAvx2DA(type, pDA->array, pDA->size, min, max);
+      break;
+    case KernelSSE2:
+      from = _minMaxSse2DA(type, pDA->array, pDA->size, min, max);
+      break;
+    case KernelScalar:
+      break;
+    }
+#endif
+    _minMaxScalarDA(type, pDA->array, from, pDA->size, min, max);
+  }
+  return rtn;
+}
+
+bool sumDA(const dynArray *pDA, dynKernelType type, void *sum) {
+  bool rtn = pDA->elementSize == _kernelSizeDA(type);
+  size_t from = 0;
+
+  if (rtn) {
+    if (type == KernelInt32 || type == KernelInt64) {
+      *(int64_t *)sum = 0;
+    } else {
+      *(double *)sum = 0;
+    }
+#ifdef KERNEL_X86
+    switch (_kernelLevelDA()) {
+    case KernelAVX2:
+      from = _sumAvx2DA(type, pDA->array, pDA->size, sum);
+      break;
+    case KernelSSE2:
+      from = _sumSse2DA(type, pDA->array, pDA->size, sum);
+      break;
+    case KernelScalar:
+      break;
+    }
+#endif
+    _sumScalarDA(type, pDA->array, from, pDA->size, sum);
+  }
+  return rtn;
+}
+
+bool fillDA(dynArray *pDA, dynKernelType type, const void *value) {
+  bool rtn = pDA->elementSize == _kernelSizeDA(type);
+  size_t from = 0;
+
+  if (rtn) {
+#ifdef KERNEL_X86
+    switch (_kernelLevelDA()) {
+    case KernelAVX2:
+      from = _fillAvx2DA(type, pDA->array, pDA->size, value);
+      break;
+    case KernelSSE2:
+      from = _fillSse2DA(type, pDA->array, pDA->size, value);
+      break;
+    case KernelScalar:
+      break;
+    }
+#endif
+    for (; from < pDA->size; from++) {
+      memcpy(pDA->array + (from * pDA->elementSize), value, pDA->elementSize);
+    }
+    logDA(pDA, 0, pDA->size);
+  }
+  return rtn;
+}
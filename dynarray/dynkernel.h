@@ -0,0 +1,114 @@
+#ifndef DYNKERNEL_H
+#define DYNKERNEL_H
+
+#include "dynarray.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file dynkernel.h
+ *
+ * @brief Dynamic Array bulk kernel header file
+ *
+ * Scan and fill numeric arrays without a callback per element. For example:
+ *
+ * size_t count = countDA(pDAInt, KernelInt32, &(int32_t){7});
+ *
+ * The kernels work on the array elements directly, so they also apply to sub
+ * arrays from subDA(). AVX2 or SSE2 is selected at run time where the CPU
+ * supports it, with a scalar fallback.
+ */
+
+/**
+ * @brief The element type of the array
+ */
+typedef enum DynamicArrayKernelType {
+  KernelInt32,  ///< int32_t elements
+  KernelInt64,  ///< int64_t elements
+  KernelFloat,  ///< float elements
+  KernelDouble, ///< double elements
+} dynKernelType;
+
+/**
+ * @brief The instruction set used by the kernels
+ */
+typedef enum DynamicArrayKernelLevel {
+  KernelScalar, ///< plain C
+  KernelSSE2,   ///< 128 bit vectors
+  KernelAVX2,   ///< 256 bit vectors
+} dynKernelLevel;
+
+/**
+ * @brief Limit the instruction set used by the kernels
+ *
+ * @param max the highest level to use, KernelAVX2 for the best available
+ * @return the level used from now on
+ */
+dynKernelLevel kernelLevelDA(dynKernelLevel max);
+
+/**
+ * @brief Find the first element equal to a value
+ *
+ * Floating point elements are compared as numbers, so NaN is never found.
+ *
+ * @param pDA the array pointer to search
+ * @param type the element type
+ * @param value a pointer to the value to find
+ * @return the index if the value was found, else -1
+ */
+size_t findDA(const dynArray *pDA, dynKernelType type, const void *value);
+
+/**
+ * @brief Count the elements equal to a value
+ *
+ * @param pDA the array pointer to search
+ * @param type the element type
+ * @param value a pointer to the value to count
+ * @return the number of matching elements, 0 if the type does not match
+ */
+size_t countDA(const dynArray *pDA, dynKernelType type, const void *value);
+
+/**
+ * @brief Find the smallest and largest elements
+ *
+ * The result is unspecified if the array holds NaN.
+ *
+ * @param pDA the array pointer to scan
+ * @param type the element type
+ * @param min a pointer to store the smallest element
+ * @param max a pointer to store the largest element
+ * @return 'true' if the array is not empty and the type matches
+ */
+bool minMaxDA(const dynArray *pDA, dynKernelType type, void *min, void *max);
+
+/**
+ * @brief Add up the elements
+ *
+ * Integer elements are summed into an int64_t, wrapping on overflow, and
+ * floating point elements into a double. The order of floating point
+ * additions depends on the instruction set.
+ *
+ * @param pDA the array pointer to sum
+ * @param type the element type
+ * @param sum a pointer to store the int64_t or double total
+ * @return 'true' if the type matches
+ */
+bool sumDA(const dynArray *pDA, dynKernelType type, void *sum);
+
+/**
+ * @brief Set every element to a value
+ *
+ * @param pDA the array pointer to fill
+ * @param type the element type
+ * @param value a pointer to the value to store
+ * @return 'true' if the type matches
+ */
+bool fillDA(dynArray *pDA, dynKernelType type, const void *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
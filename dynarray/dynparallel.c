@@ -0,0 +1,255 @@
+#include "dynparallel.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @private
+ */
+typedef struct ParallelSpan {
+  size_t next; ///< the next chunk to claim, shared with stealing threads
+  size_t end;  ///< the chunk after the span
+} __attribute__((aligned(PARALLEL_LINE))) parallelSpan;
+
+/**
+ * @private
+ */
+typedef struct ParallelJob {
+  const dynArray *pDA;                   ///< the array to traverse
+  size_t chunk;                          ///< the elements per chunk
+  size_t participants;                   ///< the threads taking part
+  parallelSpan *spans;                   ///< a span per thread
+  bool (*call)(void *entry, void *ref);  ///< the for each callback or NULL
+  void *ref;                             ///< the callback reference
+  bool stopped;                          ///< set when a callback stops
+  void (*map)(void *result, const void *entry); ///< the reduce map
+  void *results;                         ///< a result per thread
+  size_t stride;                         ///< the padded result size
+} parallelJob;
+
+/**
+ * @private
+ */
+typedef struct ParallelPool {
+  pthread_mutex_t lock;  ///< guards the job hand over
+  pthread_cond_t start;  ///< signalled when a job is posted
+  pthread_cond_t done;   ///< signalled when the last worker finishes
+  pthread_mutex_t busy;  ///< held by the thread using the pool
+  size_t threads;        ///< the worker threads
+  size_t ready;          ///< the workers waiting for jobs
+  parallelJob *job;      ///< the current job
+  size_t generation;     ///< incremented for each job
+  size_t active;         ///< the workers holding a reference to the job
+} parallelPool;
+
+/**
+ * @private
+ */
+static parallelPool _poolDA = {.lock = PTHREAD_MUTEX_INITIALIZER,
+                               .start = PTHREAD_COND_INITIALIZER,
+                               .done = PTHREAD_COND_INITIALIZER,
+                               .busy = PTHREAD_MUTEX_INITIALIZER};
+
+/**
+ * @private
+ */
+static __thread bool _inPoolDA = false;
+
+/**
+ * @private
+ */
+void _runJobDA(parallelJob *job, const size_t id) {
+  size_t size = job->pDA->size;
+  size_t es = job->pDA->elementSize;
+  void *result = job->results + (id * job->stride);
+
+  // start with our own span, then steal from the others
+  for (size_t s = 0; s < job->participants; s++) {
+    parallelSpan *span = &job->spans[(id + s) % job->participants];
+    size_t chunk;
+    while (!__atomic_load_n(&job->stopped, __ATOMIC_RELAXED) &&
+           (chunk = __atomic_fetch_add(&span->next, 1, __ATOMIC_RELAXED)) <
+               span->end) {
+      size_t from = chunk * job->chunk;
+      size_t to = (from + job->chunk < size) ? from + job->chunk : size;
+      for (size_t i = from; i < to; i++) {
+        if (job->call == NULL) {
+          job->map(result, job->pDA->array + (i * es));
+        } else if (!job->call(job->pDA->array + (i * es), job->ref) ||
+                   __atomic_load_n(&job->stopped, __ATOMIC_RELAXED)) {
+          __atomic_store_n(&job->stopped, true, __ATOMIC_RELAXED);
+          break;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @private
+ */
+void *_poolWorkerDA(void *arg) {
+  size_t id = (size_t)arg;
+  size_t seen = 0;
+
+  _inPoolDA = true;
+  pthread_mutex_lock(&_poolDA.lock);
+  seen = _poolDA.generation;
+  _poolDA.ready++;
+  pthread_cond_signal(&_poolDA.done);
+  for (;;) {
+    while (_poolDA.generation == seen) {
+      pthread_cond_wait(&_poolDA.start, &_poolDA.lock);
+    }
+    seen = _poolDA.generation;
+    parallelJob *job = _poolDA.job;
+    // a worker waking after the job has finished finds it cleared, and the
+    // caller waits for every reference taken before clearing it
+    if (job != NULL && id < job->participants) {
+      _poolDA.active++;
+      pthread_mutex_unlock(&_poolDA.lock);
+      _runJobDA(job, id);
+      pthread_mutex_lock(&_poolDA.lock);
+      if (--_poolDA.active == 0) {
+        pthread_cond_signal(&_poolDA.done);
+      }
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @private
+ */
+void _growPoolDA(const size_t workers) {
+  pthread_attr_t attr;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  while (_poolDA.threads < workers) {
+    pthread_t thread;
+    if (pthread_create(&thread, &attr, _poolWorkerDA,
+                       (void *)(_poolDA.threads + 1)) != 0) {
+      DEBUG_LOG("Pool limited to %lu threads\n", _poolDA.threads + 1);
+      break;
+    }
+    _poolDA.threads++;
+  }
+  pthread_attr_destroy(&attr);
+
+  // a worker must see the generation before the next job is posted
+  pthread_mutex_lock(&_poolDA.lock);
+  while (_poolDA.ready < _poolDA.threads) {
+    pthread_cond_wait(&_poolDA.done, &_poolDA.lock);
+  }
+  pthread_mutex_unlock(&_poolDA.lock);
+}
+
+/**
+ * @private
+ */
+void _parallelDA(parallelJob *job, size_t threads) {
+  size_t chunks = (job->pDA->size + job->chunk - 1) / job->chunk;
+
+  if (threads > chunks) {
+    threads = chunks;
+  }
+  // nested or concurrent calls run on this thread
+  bool pooled = threads > 1 && !_inPoolDA &&
+                pthread_mutex_trylock(&_poolDA.busy) == 0;
+  if (pooled) {
+    // the calling thread makes up the last one
+    _growPoolDA(threads - 1);
+    threads = (threads > _poolDA.threads + 1) ? _poolDA.threads + 1 : threads;
+  }
+  job->participants = (pooled && threads > 1) ? threads : 1;
+
+  parallelSpan spans[job->participants];
+  for (size_t s = 0; s < job->participants; s++) {
+    spans[s].next = (s * chunks) / job->participants;
+    spans[s].end = ((s + 1) * chunks) / job->participants;
+  }
+  job->spans = spans;
+
+  if (job->participants > 1) {
+    pthread_mutex_lock(&_poolDA.lock);
+    _poolDA.job = job;
+    _poolDA.generation++;
+    pthread_cond_broadcast(&_poolDA.start);
+    pthread_mutex_unlock(&_poolDA.lock);
+
+    // the caller steals every span left, so late workers are not waited for
+    _runJobDA(job, 0);
+
+    pthread_mutex_lock(&_poolDA.lock);
+    while (_poolDA.active > 0) {
+      pthread_cond_wait(&_poolDA.done, &_poolDA.lock);
+    }
+    _poolDA.job = NULL;
+    pthread_mutex_unlock(&_poolDA.lock);
+  } else {
+    _runJobDA(job, 0);
+  }
+  if (pooled) {
+    pthread_mutex_unlock(&_poolDA.busy);
+  }
+}
+
+/**
+ * @private
+ */
+static inline size_t _chunkDA(const dynArray *pDA) {
+  size_t chunk = PARALLEL_CHUNK / pDA->elementSize;
+  return (chunk > 0) ? chunk : 1;
+}
+
+/**
+ * @private
+ */
+static inline size_t _threadsDA(const size_t threads) {
+  return (threads > 0) ? threads : (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+bool parallelForEachDA(dynArray *pDA, bool call(void *entry, void *ref),
+                       void *ref, size_t threads) {
+  parallelJob job = (parallelJob){
+      .pDA = pDA, .chunk = _chunkDA(pDA), .call = call, .ref = ref};
+  _parallelDA(&job, _threadsDA(threads));
+  return !job.stopped;
+}
+
+bool parallelTasksDA(dynArray *pDA, bool call(void *entry, void *ref),
+                     void *ref, size_t threads) {
+  parallelJob job =
+      (parallelJob){.pDA = pDA, .chunk = 1, .call = call, .ref = ref};
+  _parallelDA(&job, _threadsDA(threads));
+  return !job.stopped;
+}
+
+void reduceDA(const dynArray *pDA, void map(void *result, const void *entry),
+              void combine(void *result, const void *other), void *result,
+              size_t resultSize, size_t threads) {
+  size_t stride =
+      ((resultSize + PARALLEL_LINE - 1) / PARALLEL_LINE) * PARALLEL_LINE;
+  size_t slots = _threadsDA(threads);
+  void *buffer = _safeCalloc(slots + 1, stride);
+  void *results = (void *)((((size_t)buffer + PARALLEL_LINE - 1) /
+                            PARALLEL_LINE) *
+                           PARALLEL_LINE);
+  parallelJob job = (parallelJob){.pDA = pDA,
+                                  .chunk = _chunkDA(pDA),
+                                  .map = map,
+                                  .results = results,
+                                  .stride = stride};
+
+  // each thread maps into its own copy of the initial result
+  for (size_t s = 0; s < slots; s++) {
+    memcpy(results + (s * stride), result, resultSize);
+  }
+  _parallelDA(&job, slots);
+  for (size_t s = 0; s < job.participants; s++) {
+    combine(result, results + (s * stride));
+  }
+  free(buffer);
+}
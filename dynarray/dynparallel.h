@@ -0,0 +1,93 @@
+#ifndef DYNPARALLEL_H
+#define DYNPARALLEL_H
+
+#include "dynarray.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file dynparallel.h
+ *
+ * @brief Dynamic Array parallel traversal header file
+ *
+ * Traverse an array on a shared pool of threads. For example:
+ *
+ * parallelForEachDA(pDALng, call, NULL, 0);
+ *
+ * The array is split into one span per thread, claimed a chunk at a time.
+ * A thread that finishes its span steals chunks from the others, so uneven
+ * callbacks still keep every thread busy. The pool grows to the most threads
+ * asked for and is reused for every later call. A call made from inside a
+ * callback, or while another thread is using the pool, runs on the calling
+ * thread.
+ */
+
+/**
+ * @brief The bytes of elements claimed at a time
+ */
+#define PARALLEL_CHUNK (16 * 1024)
+
+/**
+ * @brief The size reduction state is padded to, to keep threads off each
+ * other's cache lines
+ */
+#define PARALLEL_LINE 64
+
+/**
+ * @brief Call the function for each entry in the array on several threads
+ *
+ * The method should return 'true' to continue traversing the array. Once a
+ * call returns 'false', the other threads stop at their next entry. Entries
+ * are visited in no particular order.
+ *
+ * @param pDA the array pointer to traverse
+ * @param call the callback method, which must be thread safe
+ * @param ref the optional callback reference, may be NULL
+ * @param threads the most threads to use, 0 for one per processor
+ * @return 'false' if a call stopped the traversal
+ */
+bool parallelForEachDA(dynArray *pDA, bool call(void *entry, void *ref),
+                       void *ref, size_t threads);
+
+/**
+ * @brief Call the function for each entry on several threads, claiming one
+ * entry at a time
+ *
+ * As parallelForEachDA(), for arrays of a few costly entries, such as blocks
+ * to compress, that a chunk would hand to a single thread.
+ *
+ * @param pDA the array pointer to traverse
+ * @param call the callback method, which must be thread safe
+ * @param ref the optional callback reference, may be NULL
+ * @param threads the most threads to use, 0 for one per processor
+ * @return 'false' if a call stopped the traversal
+ */
+bool parallelTasksDA(dynArray *pDA, bool call(void *entry, void *ref),
+                     void *ref, size_t threads);
+
+/**
+ * @brief Map each entry into a result and combine the results
+ *
+ * Each thread starts from a copy of the initial result and maps its entries
+ * into it, then the thread results are combined into the initial result. As
+ * threads steal work from each other, combine must be associative and
+ * commutative, and the initial result must not change a combine.
+ *
+ * @param pDA the array pointer to reduce
+ * @param map add an entry to a result
+ * @param combine add another result to a result
+ * @param result the initial result, updated with the final result
+ * @param resultSize the size of the result
+ * @param threads the most threads to use, 0 for one per processor
+ */
+void reduceDA(const dynArray *pDA, void map(void *result, const void *entry),
+              void combine(void *result, const void *other), void *result,
+              size_t resultSize, size_t threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -79,17 +79,212 @@ uint32_t hashKey(const keyEntry *kEntry, const uint32_t seed) {
   return hash(kEntry->key, kEntry->length, seed);
 }
 
+/**
+ * @private
+ */
+static __thread hashEntry _foundHT;
+
+/**
+ * @private
+ */
+static inline bool _compactHT(const hashTree *pHT) { return pHT->cold != NULL; }
+
+/**
+ * @private
+ */
+static inline hashEntry *_getIndexNodeHT(const hashTree *pHT,
+                                         const size_t nodeIndex) {
+  return getDA(pHT->da, nodeIndex);
+}
+
+/**
+ * @private
+ */
+static inline hashEntry *_getWriteNodeHT(const hashTree *pHT,
+                                         const size_t nodeIndex) {
+  // writes through the node pointer are marked for any write ahead log
+  logDA(pHT->da, nodeIndex, 1);
+  return getDA(pHT->da, nodeIndex);
+}
+
+/**
+ * @private
+ */
+static inline hashNode *_getHotNodeHT(const hashTree *pHT,
+                                      const size_t nodeIndex) {
+  return (hashNode *)pHT->da->array + nodeIndex;
+}
+
+/**
+ * @private
+ */
+static inline hashNodeData *_getColdNodeHT(const hashTree *pHT,
+                                           const size_t nodeIndex) {
+  return (hashNodeData *)pHT->cold->array + nodeIndex;
+}
+
+/**
+ * @private
+ */
+static inline hashCacheEntry *_cacheHT(const hashTree *pHT,
+                                       const size_t nodeIndex) {
+  return (hashCacheEntry *)pHT->cache->array + nodeIndex;
+}
+
+/**
+ * @private
+ */
+static inline size_t _fromCompactHT(const uint32_t index) {
+  return (index == UINT32_MAX) ? (size_t)-1 : index;
+}
+
+/**
+ * @private
+ */
+static inline uint32_t _hashHT(const hashTree *pHT, const size_t nodeIndex) {
+  return _compactHT(pHT) ? _getHotNodeHT(pHT, nodeIndex)->hash
+                         : _getIndexNodeHT(pHT, nodeIndex)->hash;
+}
+
+/**
+ * @private
+ */
+static inline size_t _leftHT(const hashTree *pHT, const size_t nodeIndex) {
+  return _compactHT(pHT)
+             ? _fromCompactHT(_getHotNodeHT(pHT, nodeIndex)->left)
+             : _getIndexNodeHT(pHT, nodeIndex)->left;
+}
+
+/**
+ * @private
+ */
+static inline size_t _rightHT(const hashTree *pHT, const size_t nodeIndex) {
+  return _compactHT(pHT)
+             ? _fromCompactHT(_getHotNodeHT(pHT, nodeIndex)->right)
+             : _getIndexNodeHT(pHT, nodeIndex)->right;
+}
+
+/**
+ * @private
+ */
+static inline size_t _parentHT(const hashTree *pHT, const size_t nodeIndex) {
+  return _compactHT(pHT) ? _getColdNodeHT(pHT, nodeIndex)->parent
+                         : _getIndexNodeHT(pHT, nodeIndex)->parent;
+}
+
+/**
+ * @private
+ */
+static inline const keyEntry *_keyHT(const hashTree *pHT,
+                                     const size_t nodeIndex) {
+  return _compactHT(pHT) ? _getColdNodeHT(pHT, nodeIndex)->kEntry
+                         : _getIndexNodeHT(pHT, nodeIndex)->kEntry;
+}
+
+/**
+ * @private
+ */
+static inline void *_valueHT(const hashTree *pHT, const size_t nodeIndex) {
+  return _compactHT(pHT) ? _getColdNodeHT(pHT, nodeIndex)->value
+                         : _getIndexNodeHT(pHT, nodeIndex)->value;
+}
+
+/**
+ * @private
+ */
+static inline void _setLeftHT(const hashTree *pHT, const size_t nodeIndex,
+                              const size_t left) {
+  if (_compactHT(pHT)) {
+    logDA(pHT->da, nodeIndex, 1);
+    _getHotNodeHT(pHT, nodeIndex)->left = (uint32_t)left;
+  } else {
+    _getWriteNodeHT(pHT, nodeIndex)->left = left;
+  }
+}
+
+/**
+ * @private
+ */
+static inline void _setRightHT(const hashTree *pHT, const size_t nodeIndex,
+                               const size_t right) {
+  if (_compactHT(pHT)) {
+    logDA(pHT->da, nodeIndex, 1);
+    _getHotNodeHT(pHT, nodeIndex)->right = (uint32_t)right;
+  } else {
+    _getWriteNodeHT(pHT, nodeIndex)->right = right;
+  }
+}
+
+/**
+ * @private
+ */
+static inline void _setParentHT(const hashTree *pHT, const size_t nodeIndex,
+                                const size_t parent) {
+  if (_compactHT(pHT)) {
+    logDA(pHT->cold, nodeIndex, 1);
+    _getColdNodeHT(pHT, nodeIndex)->parent = parent;
+  } else {
+    _getWriteNodeHT(pHT, nodeIndex)->parent = parent;
+  }
+}
+
+/**
+ * @private
+ */
+static inline void _setValueHT(const hashTree *pHT, const size_t nodeIndex,
+                               void *value) {
+  if (_compactHT(pHT)) {
+    logDA(pHT->cold, nodeIndex, 1);
+    _getColdNodeHT(pHT, nodeIndex)->value = value;
+  } else {
+    _getWriteNodeHT(pHT, nodeIndex)->value = value;
+  }
+}
+
+/**
+ * @private
+ */
+static inline hashEntry _probeHT(const hashTree *pHT, const size_t nodeIndex) {
+  return (hashEntry){.kEntry = _keyHT(pHT, nodeIndex),
+                     .value = _valueHT(pHT, nodeIndex),
+                     .hash = _hashHT(pHT, nodeIndex),
+                     .parent = _parentHT(pHT, nodeIndex),
+                     .left = _leftHT(pHT, nodeIndex),
+                     .right = _rightHT(pHT, nodeIndex)};
+}
+
+/**
+ * @private
+ */
+static inline void _beginWriteHT(hashTree *pHT) {
+  beginWriteDA(pHT->da);
+  if (_compactHT(pHT)) {
+    beginWriteDA(pHT->cold);
+  }
+}
+
+/**
+ * @private
+ */
+static inline void _endWriteHT(hashTree *pHT) {
+  endWriteDA(pHT->da);
+  if (_compactHT(pHT)) {
+    endWriteDA(pHT->cold);
+  }
+}
+
 /**
  * @private
  */
 static inline int _compareHashElement(const hashTree *pHD,
                                       const hashEntry *entry,
-                                      const hashEntry *node) {
-
-  int comp = entry->hash < node->hash ? -1 : entry->hash > node->hash ? 1 : 0;
+                                      const size_t nodeIndex) {
+  uint32_t nodeHash = _hashHT(pHD, nodeIndex);
+  int comp = entry->hash < nodeHash ? -1 : entry->hash > nodeHash ? 1 : 0;
 
   if (comp == 0) {
-    comp = pHD->da->compare(entry->kEntry->key, node->kEntry->key);
+    // only a matching hash reads the key
+    comp = pHD->da->compare(entry->kEntry->key, _keyHT(pHD, nodeIndex)->key);
   }
 
   return comp;
@@ -98,352 +293,1300 @@ static inline int _compareHashElement(const hashTree *pHD,
 /**
  * @private
  */
-static inline hashEntry *_getIndexNodeHT(const hashTree *pHT,
-                                         const size_t nodeIndex) {
-  return getDA(pHT->da, nodeIndex);
+static inline size_t _getRootIndexHT(const hashTree *pHT) { return pHT->root; }
+
+/**
+ * @private
+ */
+static inline void _saveHeaderHT(hashTree *pHT) {
+  if (pHT->da->fp) {
+    char buffer[FILE_BUFFER] = {0};
+    memcpy(buffer, &pHT->root, sizeof(pHT->root));
+    memcpy(buffer + sizeof(pHT->root), &pHT->freePage, sizeof(pHT->freePage));
+    memcpy(buffer + sizeof(pHT->root) + sizeof(pHT->freePage), &pHT->ordered,
+           sizeof(pHT->ordered));
+    saveHeaderBufferDA(pHT->da, buffer);
+  }
+}
+
+/**
+ * @private
+ */
+static inline void _setRootIndexHT(hashTree *pHT, const size_t root) {
+  pHT->root = root;
+  _saveHeaderHT(pHT);
+}
+
+/**
+ * @private
+ */
+void _drawNode(const hashTree *pHT, const size_t nodeIdx, const char *topPrefix,
+               const char *botPrefix, FILE *file) {
+  char nextTopPrefix[strlen(topPrefix) + 3];
+  char nextBotPrefix[strlen(botPrefix) + 3];
+
+  if (_rightHT(pHT, nodeIdx) != -1) {
+    strcpy(nextTopPrefix, topPrefix);
+    strcat(nextTopPrefix, "   ");
+    strcpy(nextBotPrefix, topPrefix);
+    strcat(nextBotPrefix, "  |");
+    _drawNode(pHT, _rightHT(pHT, nodeIdx), nextTopPrefix, nextBotPrefix, file);
+  } else {
+    fprintf(file, "%s   .\n", topPrefix);
+  }
+  fprintf(file, "%s  /\n", topPrefix);
+
+  fprintf(file, "%s+%02lu[%02lu] %s [%u]\n", topPrefix, nodeIdx,
+          _parentHT(pHT, nodeIdx), (char *)_keyHT(pHT, nodeIdx)->key,
+          _hashHT(pHT, nodeIdx));
+  fprintf(file, "%s  \\\n", botPrefix);
+
+  if (_leftHT(pHT, nodeIdx) != -1) {
+    strcpy(nextTopPrefix, botPrefix);
+    strcat(nextTopPrefix, "  |");
+    strcpy(nextBotPrefix, botPrefix);
+    strcat(nextBotPrefix, "   ");
+    _drawNode(pHT, _leftHT(pHT, nodeIdx), nextTopPrefix, nextBotPrefix, file);
+  } else {
+    fprintf(file, "%s   .\n", botPrefix);
+  }
+}
+
+/**
+ * @private
+ */
+static inline void _emplaceNodeHT(hashTree *pHT, const hashEntry *entry,
+                                  const size_t parent) {
+  // fill the new slot in place rather than copying a built node into it
+  if (_compactHT(pHT)) {
+    if (pHT->da->size >= UINT32_MAX - 1) {
+      EXIT_ERROR("Compact hash tree full. Size: %lu\n", pHT->da->size);
+    }
+    hashNode *hot = emplaceDA(pHT->da);
+    hot->hash = entry->hash;
+    hot->left = UINT32_MAX;
+    hot->right = UINT32_MAX;
+    hashNodeData *cold = emplaceDA(pHT->cold);
+    cold->kEntry = entry->kEntry;
+    cold->value = entry->value;
+    cold->parent = parent;
+  } else {
+    hashEntry *node = emplaceDA(pHT->da);
+    *(uint32_t *)&node->hash = entry->hash;
+    node->kEntry = entry->kEntry;
+    node->parent = parent;
+    node->left = -1;
+    node->right = -1;
+    node->value = entry->value;
+  }
+}
+
+/**
+ * @private
+ */
+void _addToNodeHT(hashTree *pHT, const hashEntry *entry,
+                  const size_t nodeIndex) {
+  int comp = _compareHashElement(pHT, entry, nodeIndex);
+
+  if (comp == 0) {
+    // key matches node so replace value
+    _setValueHT(pHT, nodeIndex, entry->value);
+  } else if (comp < 0 && _leftHT(pHT, nodeIndex) == -1) {
+    // add left node
+    _emplaceNodeHT(pHT, entry, nodeIndex);
+    _setLeftHT(pHT, nodeIndex, pHT->da->size - 1);
+  } else if (comp > 0 && _rightHT(pHT, nodeIndex) == -1) {
+    // add right node
+    _emplaceNodeHT(pHT, entry, nodeIndex);
+    _setRightHT(pHT, nodeIndex, pHT->da->size - 1);
+  } else if (comp < 0) {
+    // handle left node addition
+    _addToNodeHT(pHT, entry, _leftHT(pHT, nodeIndex));
+  } else {
+    // handle right node addition
+    _addToNodeHT(pHT, entry, _rightHT(pHT, nodeIndex));
+  }
+}
+
+/**
+ * @private
+ */
+size_t _findNodeIndexHT(const hashTree *pHT, const hashEntry *entry,
+                        size_t nodeIndex) {
+  while (nodeIndex != -1) {
+    int comp = _compareHashElement(pHT, entry, nodeIndex);
+    if (comp == 0) {
+      // key matches node so return node
+      break;
+    }
+    nodeIndex = (comp < 0) ? _leftHT(pHT, nodeIndex) : _rightHT(pHT, nodeIndex);
+  }
+
+  return nodeIndex;
+}
+
+/**
+ * @private
+ */
+void _balanceNodeHT(hashTree *pHT, const size_t nodeIndex, const int side) {
+  if (_leftHT(pHT, nodeIndex) != -1) {
+    _balanceNodeHT(pHT, _leftHT(pHT, nodeIndex), -1);
+  }
+
+  if (_rightHT(pHT, nodeIndex) != -1) {
+    _balanceNodeHT(pHT, _rightHT(pHT, nodeIndex), 1);
+  }
+
+  size_t left = _leftHT(pHT, nodeIndex);
+  size_t right = _rightHT(pHT, nodeIndex);
+  unsigned int depthLeft = (left != -1) ? maxDepthHT(pHT, left) : 0;
+  unsigned int depthRight = (right != -1) ? maxDepthHT(pHT, right) : 0;
+  int diff = depthLeft - depthRight;
+
+  if (diff < -1 || diff > 1) {
+    size_t childIdx;
+    size_t innerIdx;
+
+    if (diff < -1) {
+      // need to rotate left
+      childIdx = right;
+      innerIdx = _leftHT(pHT, childIdx);
+
+      // rotate the nodes
+      _setRightHT(pHT, nodeIndex, innerIdx);
+      _setLeftHT(pHT, childIdx, nodeIndex);
+    } else {
+      // need to rotate right
+      childIdx = left;
+      innerIdx = _rightHT(pHT, childIdx);
+
+      // rotate the nodes
+      _setLeftHT(pHT, nodeIndex, innerIdx);
+      _setRightHT(pHT, childIdx, nodeIndex);
+    }
+    if (innerIdx != -1) {
+      _setParentHT(pHT, innerIdx, nodeIndex);
+    }
+
+    if (_getRootIndexHT(pHT) != nodeIndex) {
+      // if not root node
+      size_t parentIdx = _parentHT(pHT, nodeIndex);
+
+      // update the parent link
+      _setParentHT(pHT, childIdx, parentIdx);
+      if (side < 0) {
+        _setLeftHT(pHT, parentIdx, childIdx);
+      } else if (side > 0) {
+        _setRightHT(pHT, parentIdx, childIdx);
+      }
+    } else {
+      // if root node
+      _setRootIndexHT(pHT, childIdx);
+
+      // update the parent link
+      _setParentHT(pHT, childIdx, childIdx);
+    }
+
+    _setParentHT(pHT, nodeIndex, childIdx);
+  }
 }
 
 /**
  * @private
  */
-static inline size_t _getRootIndexHT(const hashTree *pHT) { return pHT->root; }
+bool _visitNodeHT(const hashTree *pHT, const size_t nodeIndex,
+                  bool visit(const hashEntry *entry, const size_t nodeIndex,
+                             void *ref),
+                  void *ref) {
+  bool cont = true;
+  if (nodeIndex != -1) {
+    if (_leftHT(pHT, nodeIndex) != -1) {
+      cont = _visitNodeHT(pHT, _leftHT(pHT, nodeIndex), visit, ref);
+    }
+    if (_rightHT(pHT, nodeIndex) != -1 && cont) {
+      cont = _visitNodeHT(pHT, _rightHT(pHT, nodeIndex), visit, ref);
+    }
+
+    if (cont && _compactHT(pHT)) {
+      // compact nodes are gathered into an entry for the visitor
+      hashEntry entry = _probeHT(pHT, nodeIndex);
+      cont = visit(&entry, nodeIndex, ref);
+    } else if (cont) {
+      cont = visit(_getIndexNodeHT(pHT, nodeIndex), nodeIndex, ref);
+    }
+  }
+
+  return cont;
+}
+
+/**
+ * @private
+ */
+void _insertNodeHT(hashTree *pHT, const hashEntry *entry,
+                   const size_t entryIndex, const size_t nodeIndex) {
+  int comp = _compareHashElement(pHT, entry, nodeIndex);
+
+  if (comp < 0) {
+    if (_leftHT(pHT, nodeIndex) == -1) {
+      _setLeftHT(pHT, nodeIndex, entryIndex);
+      _setParentHT(pHT, entryIndex, nodeIndex);
+    } else {
+      _insertNodeHT(pHT, entry, entryIndex, _leftHT(pHT, nodeIndex));
+    }
+  } else if (comp > 0) {
+    if (_rightHT(pHT, nodeIndex) == -1) {
+      _setRightHT(pHT, nodeIndex, entryIndex);
+      _setParentHT(pHT, entryIndex, nodeIndex);
+    } else {
+      _insertNodeHT(pHT, entry, entryIndex, _rightHT(pHT, nodeIndex));
+    }
+  }
+}
+
+/**
+ * @private
+ */
+void _reinsertHT(hashTree *pHT, const size_t entryIndex) {
+  if (entryIndex != -1) {
+    hashEntry entry = _probeHT(pHT, entryIndex);
+    _insertNodeHT(pHT, &entry, entryIndex, _getRootIndexHT(pHT));
+  }
+}
+
+/**
+ * @private
+ */
+void _moveNodeHT(hashTree *pHT, const size_t from, const size_t to) {
+  logDA(pHT->da, to, 1);
+  memcpy(_toPtr(pHT->da, to), _toPtr(pHT->da, from), pHT->da->elementSize);
+  if (_compactHT(pHT)) {
+    logDA(pHT->cold, to, 1);
+    memcpy(_getColdNodeHT(pHT, to), _getColdNodeHT(pHT, from),
+           sizeof(hashNodeData));
+  }
+  if (pHT->cache != NULL) {
+    *_cacheHT(pHT, to) = *_cacheHT(pHT, from);
+  }
+}
+
+/**
+ * @private
+ */
+void _deleteHT(hashTree *pHT, hashEntry *entry, const size_t nodeIndex,
+               void deleted(const hashTree *pHT, const keyEntry *kEntry,
+                            void *value, void *ref),
+               void *ref) {
+
+  size_t found = _findNodeIndexHT(pHT, entry, _getRootIndexHT(pHT));
+
+  if (found != -1) {
+    size_t left = _leftHT(pHT, found);
+    size_t right = _rightHT(pHT, found);
+
+    if (_getRootIndexHT(pHT) != found) {
+      size_t parent = _parentHT(pHT, found);
+
+      if (_leftHT(pHT, parent) == found) {
+        _setLeftHT(pHT, parent, -1);
+      }
+      if (_rightHT(pHT, parent) == found) {
+        _setRightHT(pHT, parent, -1);
+      }
+    } else {
+      size_t root = (left != -1) ? left : right;
+      _setRootIndexHT(pHT, root);
+      if (root != -1) {
+        _setParentHT(pHT, root, root);
+      }
+    }
+
+    _reinsertHT(pHT, left);
+    _reinsertHT(pHT, right);
+
+    if (deleted) {
+      deleted(pHT, _keyHT(pHT, found), _valueHT(pHT, found), ref);
+    }
+    if (pHT->cache != NULL) {
+      pHT->bytes -= _cacheHT(pHT, found)->bytes;
+    }
+
+    // fill the gap with the last node
+    size_t lastIndex = pHT->da->size - 1;
+    if (found != lastIndex) {
+      size_t lastParent = _parentHT(pHT, lastIndex);
+      _moveNodeHT(pHT, lastIndex, found);
+      if (_getRootIndexHT(pHT) == lastIndex) {
+        _setRootIndexHT(pHT, found);
+        _setParentHT(pHT, found, found);
+      } else if (_leftHT(pHT, lastParent) == lastIndex) {
+        _setLeftHT(pHT, lastParent, found);
+      } else if (_rightHT(pHT, lastParent) == lastIndex) {
+        _setRightHT(pHT, lastParent, found);
+      }
+      if (_leftHT(pHT, found) != -1) {
+        _setParentHT(pHT, _leftHT(pHT, found), found);
+      }
+      if (_rightHT(pHT, found) != -1) {
+        _setParentHT(pHT, _rightHT(pHT, found), found);
+      }
+    }
+    pHT->da->size--;
+    logDA(pHT->da, 0, 0);
+    if (_compactHT(pHT)) {
+      pHT->cold->size--;
+      logDA(pHT->cold, 0, 0);
+    }
+    if (pHT->cache != NULL) {
+      pHT->cache->size--;
+    }
+  }
+}
+
+/**
+ * @private
+ */
+void _evictHT(hashTree *pHT) {
+  while ((pHT->maxEntries != 0 && pHT->da->size > pHT->maxEntries) ||
+         (pHT->maxBytes != 0 && pHT->bytes > pHT->maxBytes)) {
+    if (pHT->hand >= pHT->da->size) {
+      pHT->hand = 0;
+    }
+
+    hashCacheEntry *slot = _cacheHT(pHT, pHT->hand);
+    if (slot->referenced) {
+      // a second chance, until the hand comes round again
+      slot->referenced = false;
+      pHT->hand++;
+    } else {
+      // the last node, often the one just added, moves into the gap and is
+      // passed over as a new entry would be in the evicted frame
+      hashEntry entry = (hashEntry){.kEntry = _keyHT(pHT, pHT->hand),
+                                    .hash = _hashHT(pHT, pHT->hand)};
+      _deleteHT(pHT, &entry, _getRootIndexHT(pHT), pHT->evicted,
+                pHT->evictedRef);
+      pHT->hand++;
+    }
+  }
+}
+
+/**
+ * @private
+ */
+static inline char *_coldFilenameHT(const char *filename) {
+  char *name = _safeCalloc(strlen(filename) + sizeof(HT_COLD_SUFFIX), 1);
+  strcpy(name, filename);
+  strcat(name, HT_COLD_SUFFIX);
+  return name;
+}
+
+/////////////////////////////////
+// B-tree pages
+/////////////////////////////////
+
+/**
+ * @private
+ */
+static inline bool _btreeHT(const hashTree *pHT) {
+  return pHT->da->elementSize == sizeof(hashPage);
+}
+
+/**
+ * @private
+ */
+static inline hashPage *_pageBT(const hashTree *pHT, const size_t page) {
+  return (hashPage *)pHT->da->array + page;
+}
+
+/**
+ * @private
+ */
+static inline hashPage *_writePageBT(const hashTree *pHT, const size_t page) {
+  logDA(pHT->da, page, 1);
+  return _pageBT(pHT, page);
+}
+
+/**
+ * @private
+ */
+size_t _allocPageBT(hashTree *pHT, const bool leaf) {
+  size_t page = pHT->freePage;
+
+  if (page != -1) {
+    // reuse a page freed by a merge
+    pHT->freePage = _fromCompactHT(_pageBT(pHT, page)->children[0]);
+    _saveHeaderHT(pHT);
+  } else {
+    if (pHT->da->size >= UINT32_MAX - 1) {
+      EXIT_ERROR("B-tree full. Pages: %lu\n", pHT->da->size);
+    }
+    emplaceDA(pHT->da);
+    page = pHT->da->size - 1;
+  }
+
+  hashPage *pPage = _writePageBT(pHT, page);
+  pPage->count = 0;
+  pPage->leaf = leaf;
+  return page;
+}
+
+/**
+ * @private
+ */
+void _freePageBT(hashTree *pHT, const size_t page) {
+  _writePageBT(pHT, page)->children[0] = (uint32_t)pHT->freePage;
+  pHT->freePage = page;
+  _saveHeaderHT(pHT);
+}
+
+/**
+ * @private
+ */
+static inline void _copySlotBT(hashPage *dst, const int to,
+                               const hashPage *src, const int from) {
+  dst->hashes[to] = src->hashes[from];
+  dst->kEntries[to] = src->kEntries[from];
+  dst->values[to] = src->values[from];
+}
+
+/**
+ * @private
+ */
+static inline void _shiftSlotsBT(hashPage *pPage, const int from,
+                                 const int by) {
+  // move the entries from a slot to the end of the page, left or right
+  int moved = pPage->count - from;
+  memmove(&pPage->hashes[from + by], &pPage->hashes[from],
+          moved * sizeof(uint32_t));
+  memmove(&pPage->kEntries[from + by], &pPage->kEntries[from],
+          moved * sizeof(keyEntry *));
+  memmove(&pPage->values[from + by], &pPage->values[from],
+          moved * sizeof(void *));
+}
+
+/**
+ * @private
+ */
+static inline void _shiftChildrenBT(hashPage *pPage, const int from,
+                                    const int by) {
+  memmove(&pPage->children[from + by], &pPage->children[from],
+          (pPage->count - from + 1) * sizeof(uint32_t));
+}
+
+/**
+ * @private
+ */
+static inline int _compareSlotBT(const hashTree *pHT, const hashEntry *entry,
+                                 const hashPage *pPage, const int slot) {
+  int comp = 0;
+  if (!pHT->ordered) {
+    comp = (entry->hash < pPage->hashes[slot])   ? -1
+           : (entry->hash > pPage->hashes[slot]) ? 1
+                                                 : 0;
+  }
+  if (comp == 0) {
+    comp = pHT->da->compare(entry->kEntry->key, pPage->kEntries[slot]->key);
+  }
+  return comp;
+}
+
+/**
+ * @private
+ */
+static inline int _slotBT(const hashTree *pHT, const hashPage *pPage,
+                          const hashEntry *entry, bool *found) {
+  int slot = 0;
+  int comp = 1;
+
+  if (pHT->ordered) {
+    // ordered pages are searched by key alone, for the first slot not less
+    int high = pPage->count;
+    while (slot < high) {
+      int middle = (slot + high) / 2;
+      if (_compareSlotBT(pHT, entry, pPage, middle) > 0) {
+        slot = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    *found = slot < pPage->count &&
+             _compareSlotBT(pHT, entry, pPage, slot) == 0;
+    return slot;
+  }
+
+  // the hashes fill one cache line, so only a matching hash reads a key
+  while (slot < pPage->count && pPage->hashes[slot] < entry->hash) {
+    slot++;
+  }
+  while (slot < pPage->count && pPage->hashes[slot] == entry->hash &&
+         (comp = pHT->da->compare(entry->kEntry->key,
+                                  pPage->kEntries[slot]->key)) > 0) {
+    slot++;
+  }
+  *found = slot < pPage->count && pPage->hashes[slot] == entry->hash &&
+           comp == 0;
+  return slot;
+}
+
+/**
+ * @private
+ */
+bool _findBT(const hashTree *pHT, const hashEntry *entry, size_t *page,
+             int *slot) {
+  bool found = false;
+  size_t index = pHT->root;
+
+  while (index != -1 && !found) {
+    hashPage *pPage = _pageBT(pHT, index);
+    *slot = _slotBT(pHT, pPage, entry, &found);
+    *page = index;
+    index = (found || pPage->leaf) ? (size_t)-1 : pPage->children[*slot];
+  }
+
+  return found;
+}
+
+/**
+ * @private
+ */
+void _splitChildBT(hashTree *pHT, const size_t parent, const int slot) {
+  size_t child = _pageBT(pHT, parent)->children[slot];
+  size_t sibling = _allocPageBT(pHT, _pageBT(pHT, child)->leaf);
+
+  // pointers are taken after the allocation, which may move the pages
+  hashPage *pParent = _writePageBT(pHT, parent);
+  hashPage *pChild = _writePageBT(pHT, child);
+  hashPage *pSibling = _pageBT(pHT, sibling);
+
+  // the upper half moves to the new sibling
+  for (int i = 0; i < BT_DEGREE - 1; i++) {
+    _copySlotBT(pSibling, i, pChild, i + BT_DEGREE);
+  }
+  if (!pChild->leaf) {
+    memcpy(pSibling->children, &pChild->children[BT_DEGREE],
+           BT_DEGREE * sizeof(uint32_t));
+  }
+  pSibling->count = BT_DEGREE - 1;
+  pChild->count = BT_DEGREE - 1;
+
+  // and the median moves up into the parent
+  _shiftChildrenBT(pParent, slot + 1, 1);
+  _shiftSlotsBT(pParent, slot, 1);
+  _copySlotBT(pParent, slot, pChild, BT_DEGREE - 1);
+  pParent->children[slot + 1] = sibling;
+  pParent->count++;
+}
+
+/**
+ * @private
+ */
+bool _insertBT(hashTree *pHT, const hashEntry *entry) {
+  if (pHT->root == -1) {
+    pHT->root = _allocPageBT(pHT, true);
+    _saveHeaderHT(pHT);
+  } else if (_pageBT(pHT, pHT->root)->count == BT_KEYS) {
+    // split a full root on the way down, growing the tree by a level
+    size_t root = _allocPageBT(pHT, false);
+    _writePageBT(pHT, root)->children[0] = pHT->root;
+    pHT->root = root;
+    _saveHeaderHT(pHT);
+    _splitChildBT(pHT, root, 0);
+  }
+
+  size_t page = pHT->root;
+  for (;;) {
+    bool found;
+    hashPage *pPage = _pageBT(pHT, page);
+    int slot = _slotBT(pHT, pPage, entry, &found);
+
+    if (found) {
+      // key matches so replace value
+      _writePageBT(pHT, page)->values[slot] = entry->value;
+      return false;
+    } else if (pPage->leaf) {
+      pPage = _writePageBT(pHT, page);
+      _shiftSlotsBT(pPage, slot, 1);
+      pPage->hashes[slot] = entry->hash;
+      pPage->kEntries[slot] = entry->kEntry;
+      pPage->values[slot] = entry->value;
+      pPage->count++;
+      return true;
+    }
+
+    // full pages are split before stepping into them
+    if (_pageBT(pHT, pPage->children[slot])->count == BT_KEYS) {
+      _splitChildBT(pHT, page, slot);
+      pPage = _pageBT(pHT, page);
+      int comp = _compareSlotBT(pHT, entry, pPage, slot);
+      if (comp == 0) {
+        _writePageBT(pHT, page)->values[slot] = entry->value;
+        return false;
+      }
+      slot += comp > 0;
+    }
+    page = pPage->children[slot];
+  }
+}
+
+/**
+ * @private
+ */
+void _mergeChildrenBT(hashTree *pHT, const size_t parent, const int slot) {
+  hashPage *pParent = _writePageBT(pHT, parent);
+  size_t sibling = pParent->children[slot + 1];
+  hashPage *pChild = _writePageBT(pHT, pParent->children[slot]);
+  hashPage *pSibling = _pageBT(pHT, sibling);
+
+  // the separator and the right sibling are appended to the left child
+  _copySlotBT(pChild, pChild->count, pParent, slot);
+  for (int i = 0; i < pSibling->count; i++) {
+    _copySlotBT(pChild, pChild->count + 1 + i, pSibling, i);
+  }
+  if (!pChild->leaf) {
+    memcpy(&pChild->children[pChild->count + 1], pSibling->children,
+           (pSibling->count + 1) * sizeof(uint32_t));
+  }
+  pChild->count += 1 + pSibling->count;
+
+  _shiftChildrenBT(pParent, slot + 2, -1);
+  _shiftSlotsBT(pParent, slot + 1, -1);
+  pParent->count--;
+  _freePageBT(pHT, sibling);
+}
+
+/**
+ * @private
+ */
+int _fillChildBT(hashTree *pHT, const size_t parent, int slot) {
+  hashPage *pParent = _writePageBT(pHT, parent);
+  hashPage *pChild = _writePageBT(pHT, pParent->children[slot]);
+  hashPage *pLeft =
+      (slot > 0) ? _pageBT(pHT, pParent->children[slot - 1]) : NULL;
+  hashPage *pRight = (slot < pParent->count)
+                         ? _pageBT(pHT, pParent->children[slot + 1])
+                         : NULL;
+
+  if (pLeft != NULL && pLeft->count >= BT_DEGREE) {
+    // borrow through the parent from the left sibling
+    logDA(pHT->da, pParent->children[slot - 1], 1);
+    if (!pChild->leaf) {
+      _shiftChildrenBT(pChild, 0, 1);
+      pChild->children[0] = pLeft->children[pLeft->count];
+    }
+    _shiftSlotsBT(pChild, 0, 1);
+    _copySlotBT(pChild, 0, pParent, slot - 1);
+    _copySlotBT(pParent, slot - 1, pLeft, pLeft->count - 1);
+    pLeft->count--;
+    pChild->count++;
+  } else if (pRight != NULL && pRight->count >= BT_DEGREE) {
+    // borrow through the parent from the right sibling
+    logDA(pHT->da, pParent->children[slot + 1], 1);
+    _copySlotBT(pChild, pChild->count, pParent, slot);
+    if (!pChild->leaf) {
+      pChild->children[pChild->count + 1] = pRight->children[0];
+    }
+    _copySlotBT(pParent, slot, pRight, 0);
+    if (!pRight->leaf) {
+      _shiftChildrenBT(pRight, 1, -1);
+    }
+    _shiftSlotsBT(pRight, 1, -1);
+    pRight->count--;
+    pChild->count++;
+  } else if (pRight != NULL) {
+    _mergeChildrenBT(pHT, parent, slot);
+  } else {
+    _mergeChildrenBT(pHT, parent, --slot);
+  }
+
+  return slot;
+}
+
+/**
+ * @private
+ */
+static inline void _gatherBT(const hashPage *pPage, const int slot,
+                             hashEntry *entry) {
+  // page slots are gathered into an entry for the caller
+  hashEntry gathered = (hashEntry){.hash = pPage->hashes[slot],
+                                   .kEntry = pPage->kEntries[slot],
+                                   .parent = -1,
+                                   .left = -1,
+                                   .right = -1,
+                                   .value = pPage->values[slot]};
+  memcpy(entry, &gathered, sizeof(hashEntry));
+}
+
+/**
+ * @private
+ */
+bool _deleteBT(hashTree *pHT, size_t page, const hashEntry *entry,
+               hashEntry *removed) {
+  hashEntry target = *entry;
+  bool first = true;
+
+  for (;;) {
+    bool found;
+    hashPage *pPage = _pageBT(pHT, page);
+    int slot = _slotBT(pHT, pPage, &target, &found);
+
+    if (found && first) {
+      // the entry is kept for the callback, which may free its key, until
+      // it has left the tree
+      _gatherBT(pPage, slot, removed);
+      first = false;
+    }
+
+    if (found && pPage->leaf) {
+      pPage = _writePageBT(pHT, page);
+      _shiftSlotsBT(pPage, slot + 1, -1);
+      pPage->count--;
+      return true;
+    } else if (pPage->leaf) {
+      return false;
+    } else if (found) {
+      hashPage *pLeft = _pageBT(pHT, pPage->children[slot]);
+      hashPage *pRight = _pageBT(pHT, pPage->children[slot + 1]);
+
+      if (pLeft->count >= BT_DEGREE || pRight->count >= BT_DEGREE) {
+        // replace with the neighbouring entry, then delete that instead
+        bool left = pLeft->count >= BT_DEGREE;
+        size_t next = pPage->children[slot + !left];
+        hashPage *pNext = _pageBT(pHT, next);
+        while (!pNext->leaf) {
+          next = pNext->children[left ? pNext->count : 0];
+          pNext = _pageBT(pHT, next);
+        }
+        _copySlotBT(_writePageBT(pHT, page), slot, pNext,
+                    left ? pNext->count - 1 : 0);
+        pPage = _pageBT(pHT, page);
+        hashEntry moved = (hashEntry){.hash = pPage->hashes[slot],
+                                      .kEntry = pPage->kEntries[slot]};
+        memcpy(&target, &moved, sizeof(hashEntry));
+        page = pPage->children[slot + !left];
+      } else {
+        // both neighbours are minimal, so merge them around the entry
+        _mergeChildrenBT(pHT, page, slot);
+        page = _pageBT(pHT, page)->children[slot];
+      }
+    } else {
+      // make sure the next page can lose an entry
+      if (_pageBT(pHT, pPage->children[slot])->count < BT_DEGREE) {
+        slot = _fillChildBT(pHT, page, slot);
+        pPage = _pageBT(pHT, page);
+      }
+      page = pPage->children[slot];
+    }
+  }
+}
+
+/**
+ * @private
+ */
+void _deleteRootBT(hashTree *pHT, const hashEntry *entry,
+                   void deleted(const hashTree *pHT, const keyEntry *kEntry,
+                                void *value, void *ref),
+                   void *ref) {
+  hashEntry removed;
+  bool found = pHT->root != -1 && _deleteBT(pHT, pHT->root, entry, &removed);
+  if (found) {
+    pHT->count--;
+  }
+
+  hashPage *pRoot = (pHT->root != -1) ? _pageBT(pHT, pHT->root) : NULL;
+  if (pRoot != NULL && pRoot->count == 0) {
+    // an empty root gives way to its only child, shrinking the tree
+    size_t root = pHT->root;
+    pHT->root = pRoot->leaf ? (size_t)-1 : pRoot->children[0];
+    _freePageBT(pHT, root);
+  }
+
+  if (found && deleted != NULL) {
+    deleted(pHT, removed.kEntry, removed.value, ref);
+  }
+}
+
+/**
+ * @private
+ */
+bool _visitPageBT(const hashTree *pHT, const size_t page,
+                  bool visit(const hashEntry *entry, const size_t entryIndex,
+                             void *ref),
+                  void *ref) {
+  bool cont = true;
+  hashPage *pPage = _pageBT(pHT, page);
+
+  for (int slot = 0; cont && slot <= pPage->count; slot++) {
+    if (!pPage->leaf) {
+      cont = _visitPageBT(pHT, pPage->children[slot], visit, ref);
+    }
+    if (cont && slot < pPage->count) {
+      hashEntry entry;
+      _gatherBT(pPage, slot, &entry);
+      cont = visit(&entry, (page * BT_KEYS) + slot, ref);
+    }
+  }
+
+  return cont;
+}
+
+/**
+ * @private
+ */
+size_t _countPageBT(const hashTree *pHT, const size_t page) {
+  hashPage *pPage = _pageBT(pHT, page);
+  size_t count = pPage->count;
+
+  for (int slot = 0; !pPage->leaf && slot <= pPage->count; slot++) {
+    count += _countPageBT(pHT, pPage->children[slot]);
+  }
+
+  return count;
+}
+
+/**
+ * @private
+ */
+void _drawPageBT(const hashTree *pHT, const size_t page, const int depth,
+                 FILE *file) {
+  hashPage *pPage = _pageBT(pHT, page);
+
+  fprintf(file, "%*s[%lu]", depth * 2, "", page);
+  for (int slot = 0; slot < pPage->count; slot++) {
+    fprintf(file, " %u", pPage->hashes[slot]);
+  }
+  fprintf(file, "\n");
+
+  for (int slot = 0; !pPage->leaf && slot <= pPage->count; slot++) {
+    _drawPageBT(pHT, pPage->children[slot], depth + 1, file);
+  }
+}
+
+/**
+ * @private
+ */
+void _descendBT(hashCursor *cursor, size_t page) {
+  // the path down the left edge of a sub tree leads to its first entry
+  for (;;) {
+    hashPage *pPage = _pageBT(cursor->pHT, page);
+    cursor->pages[cursor->depth] = page;
+    cursor->slots[cursor->depth++] = 0;
+    if (pPage->leaf) {
+      break;
+    }
+    page = pPage->children[0];
+  }
+}
+
+/**
+ * @private
+ */
+hashEntry *_nextBT(hashCursor *cursor, size_t *entryIndex) {
+  hashEntry *entry = NULL;
+
+  // pages with no slots left have been read, resume in their parent
+  while (cursor->depth > 0 &&
+         cursor->slots[cursor->depth - 1] >=
+             _pageBT(cursor->pHT, cursor->pages[cursor->depth - 1])->count) {
+    cursor->depth--;
+  }
+
+  if (cursor->depth > 0) {
+    size_t page = cursor->pages[cursor->depth - 1];
+    int slot = cursor->slots[cursor->depth - 1]++;
+    hashPage *pPage = _pageBT(cursor->pHT, page);
+
+    _gatherBT(pPage, slot, &cursor->entry);
+    *entryIndex = (page * BT_KEYS) + slot;
+    entry = &cursor->entry;
+
+    if (!pPage->leaf) {
+      _descendBT(cursor, pPage->children[slot + 1]);
+    }
+  }
+
+  return entry;
+}
+
+/////////////////////////////////
+// Set algebra
+/////////////////////////////////
+
+/**
+ * @private
+ */
+typedef struct HashOrder {
+  const hashTree *pHT; ///< the tree being read
+  size_t node;         ///< the next binary tree node or -1
+  hashCursor cursor;   ///< the position in a B-tree
+  hashEntry entry;     ///< the last entry read
+} hashOrder;
+
+/**
+ * @private
+ */
+#define MERGE_LEFT 1
+/**
+ * @private
+ */
+#define MERGE_BOTH 2
+/**
+ * @private
+ */
+#define MERGE_RIGHT 4
+/**
+ * @private
+ */
+#define MERGE_RIGHT_VALUE 8
 
 /**
  * @private
  */
-static inline void _setRootIndexHT(hashTree *pHT, const size_t root) {
-  pHT->root = root;
-
-  if (pHT->da->fp) {
-    char buffer[FILE_BUFFER];
-    *((size_t *)buffer) = pHT->root;
-    saveHeaderBufferDA(pHT->da, buffer);
-  }
-}
+typedef struct HashMerge {
+  dynArray *entries; ///< the hashEntry copies kept, in order
+  int keep;          ///< the MERGE_ flags of the entries to keep
+} hashMerge;
 
 /**
  * @private
  */
-static inline hashEntry *_getRootNodeHT(const hashTree *pHT,
-                                        const size_t nodeIndex) {
-  return _getIndexNodeHT(pHT, _getRootIndexHT(pHT));
+void _firstOrderHT(hashOrder *order, const hashTree *pHT) {
+  order->pHT = pHT;
+  order->node = -1;
+
+  if (_btreeHT(pHT)) {
+    seekHT(&order->cursor, pHT, NULL);
+  } else if (_getRootIndexHT(pHT) != -1) {
+    size_t node = _getRootIndexHT(pHT);
+    while (_leftHT(pHT, node) != -1) {
+      node = _leftHT(pHT, node);
+    }
+    order->node = node;
+  }
 }
 
 /**
  * @private
  */
-void _drawNode(const hashTree *pHT, const size_t nodeIdx, const char *topPrefix,
-               const char *botPrefix, FILE *file) {
-  char nextTopPrefix[strlen(topPrefix) + 3];
-  char nextBotPrefix[strlen(botPrefix) + 3];
-  hashEntry *entry = getDA(pHT->da, nodeIdx);
-
-  if (entry->right != -1) {
-    strcpy(nextTopPrefix, topPrefix);
-    strcat(nextTopPrefix, "   ");
-    strcpy(nextBotPrefix, topPrefix);
-    strcat(nextBotPrefix, "  |");
-    _drawNode(pHT, entry->right, nextTopPrefix, nextBotPrefix, file);
-  } else {
-    fprintf(file, "%s   .\n", topPrefix);
+hashEntry *_nextOrderHT(hashOrder *order) {
+  const hashTree *pHT = order->pHT;
+  size_t node = order->node;
+
+  if (_btreeHT(pHT)) {
+    return nextHT(&order->cursor);
+  } else if (node == -1) {
+    return NULL;
   }
-  fprintf(file, "%s  /\n", topPrefix);
 
-  fprintf(file, "%s+%02lu[%02lu] %s [%u]\n", topPrefix, nodeIdx, entry->parent,
-          (char *)entry->kEntry->key, entry->hash);
-  fprintf(file, "%s  \\\n", botPrefix);
+  hashEntry entry = _probeHT(pHT, node);
+  memcpy(&order->entry, &entry, sizeof(hashEntry));
 
-  if (entry->left != -1) {
-    strcpy(nextTopPrefix, botPrefix);
-    strcat(nextTopPrefix, "  |");
-    strcpy(nextBotPrefix, botPrefix);
-    strcat(nextBotPrefix, "   ");
-    _drawNode(pHT, entry->left, nextTopPrefix, nextBotPrefix, file);
+  // the next node in order is the first of the right sub tree, or else the
+  // nearest parent this node is left of
+  if (_rightHT(pHT, node) != -1) {
+    node = _rightHT(pHT, node);
+    while (_leftHT(pHT, node) != -1) {
+      node = _leftHT(pHT, node);
+    }
   } else {
-    fprintf(file, "%s   .\n", botPrefix);
+    size_t parent = _parentHT(pHT, node);
+    while (parent != node && _rightHT(pHT, parent) == node) {
+      node = parent;
+      parent = _parentHT(pHT, node);
+    }
+    node = (parent == node) ? (size_t)-1 : parent;
   }
+  order->node = node;
+
+  return &order->entry;
 }
 
 /**
  * @private
  */
-void _addToNodeHT(hashTree *pHT, hashEntry *entry, const size_t nodeIndex) {
-  hashEntry *node = _getIndexNodeHT(pHT, nodeIndex);
-  int comp = _compareHashElement(pHT, entry, node);
-
+static inline int _compareOrderHT(const hashTree *pHT, const hashEntry *left,
+                                  const hashEntry *right) {
+  int comp = 0;
+  if (!pHT->ordered) {
+    comp = (left->hash < right->hash) ? -1 : (left->hash > right->hash) ? 1 : 0;
+  }
   if (comp == 0) {
-    // key matches node so replace value
-    node->value = entry->value;
-  } else if (comp < 0 && node->left == -1) {
-    // add left node
-    entry = addDA(pHT->da, entry);
-    entry->parent = nodeIndex;
-    // get new node as may have reallocated
-    node = _getIndexNodeHT(pHT, nodeIndex);
-    node->left = pHT->da->size - 1;
-  } else if (comp > 0 && node->right == -1) {
-    // add right node
-    entry = addDA(pHT->da, entry);
-    entry->parent = nodeIndex;
-    // get new node as may have reallocated
-    node = _getIndexNodeHT(pHT, nodeIndex);
-    node->right = pHT->da->size - 1;
-  } else if (comp < 0) {
-    // handle left node addition
-    _addToNodeHT(pHT, entry, node->left);
-  } else {
-    // handle right node addition
-    _addToNodeHT(pHT, entry, node->right);
+    comp = pHT->da->compare(left->kEntry->key, right->kEntry->key);
   }
+  return comp;
 }
 
 /**
  * @private
  */
-hashEntry *_findNodeHT(const hashTree *pHT, const hashEntry *entry,
-                       const size_t nodeIndex) {
-  hashEntry *node = NULL;
-
-  if (nodeIndex != -1) {
-    node = _getIndexNodeHT(pHT, nodeIndex);
-    int comp = _compareHashElement(pHT, entry, node);
-
-    if (comp < 0) {
-      node = (node->left != -1) ? _findNodeHT(pHT, entry, node->left) : NULL;
-    } else if (comp > 0) {
-      node = (node->right != -1) ? _findNodeHT(pHT, entry, node->right) : NULL;
+bool _lookupHT(const hashTree *pHT, const keyEntry *kEntry, hashEntry *found) {
+  // a lookup that leaves the cache state alone
+  hashEntry entry = (hashEntry){.kEntry = kEntry, .hash = hashKey(kEntry, 0)};
+  bool has;
+
+  if (_btreeHT(pHT)) {
+    size_t page;
+    int slot;
+    has = _findBT(pHT, &entry, &page, &slot);
+    if (has) {
+      _gatherBT(_pageBT(pHT, page), slot, found);
+    }
+  } else {
+    size_t node = _findNodeIndexHT(pHT, &entry, _getRootIndexHT(pHT));
+    has = node != -1;
+    if (has) {
+      hashEntry gathered = _probeHT(pHT, node);
+      memcpy(found, &gathered, sizeof(hashEntry));
     }
-    // key matches node so return node
   }
 
-  return node;
+  return has;
 }
 
 /**
  * @private
  */
-size_t _findNodeIndexHT(const hashTree *pHT, const hashEntry *entry,
-                        const size_t nodeIndex) {
-  size_t found = -1;
-  hashEntry *node = _getIndexNodeHT(pHT, nodeIndex);
-  int comp = _compareHashElement(pHT, entry, node);
+static inline bool _mergeableHT(const hashTree *pHT, const hashTree *pOther) {
+  return pHT->ordered == pOther->ordered;
+}
 
-  if (comp == 0) {
-    found = nodeIndex;
-  } else if (comp < 0) {
-    found = (node->left != -1) ? _findNodeIndexHT(pHT, entry, node->left) : -1;
-  } else if (comp > 0) {
-    found =
-        (node->right != -1) ? _findNodeIndexHT(pHT, entry, node->right) : -1;
+/**
+ * @private
+ */
+bool _mergeHT(const hashTree *pHT, const hashTree *pOther,
+              const bool rightOnly,
+              bool emit(const hashEntry *left, const hashEntry *right,
+                        void *ref),
+              void *ref) {
+  bool cont = true;
+  hashOrder leftOrder, rightOrder;
+  _firstOrderHT(&leftOrder, pHT);
+
+  if (_mergeableHT(pHT, pOther)) {
+    // both trees are read once, side by side in their shared order
+    _firstOrderHT(&rightOrder, pOther);
+    hashEntry *left = _nextOrderHT(&leftOrder);
+    hashEntry *right = _nextOrderHT(&rightOrder);
+
+    while (cont && (left != NULL || (rightOnly && right != NULL))) {
+      int comp = (left == NULL)    ? 1
+                 : (right == NULL) ? -1
+                                   : _compareOrderHT(pHT, left, right);
+      if (comp < 0) {
+        cont = emit(left, NULL, ref);
+        left = _nextOrderHT(&leftOrder);
+      } else if (comp > 0) {
+        cont = !rightOnly || emit(NULL, right, ref);
+        right = _nextOrderHT(&rightOrder);
+      } else {
+        cont = emit(left, right, ref);
+        left = _nextOrderHT(&leftOrder);
+        right = _nextOrderHT(&rightOrder);
+      }
+    }
+  } else {
+    // trees in different orders fall back to a lookup per entry
+    hashEntry found;
+    hashEntry *entry;
+    while (cont && (entry = _nextOrderHT(&leftOrder)) != NULL) {
+      cont = emit(entry, _lookupHT(pOther, entry->kEntry, &found) ? &found
+                                                                  : NULL,
+                  ref);
+    }
+    _firstOrderHT(&rightOrder, pOther);
+    while (cont && rightOnly && (entry = _nextOrderHT(&rightOrder)) != NULL) {
+      if (!_lookupHT(pHT, entry->kEntry, &found)) {
+        cont = emit(NULL, entry, ref);
+      }
+    }
   }
-  // key matches node so return node
 
-  return found;
+  return cont;
 }
 
 /**
  * @private
  */
-void _balanceNodeHT(hashTree *pHT, const size_t nodeIndex, const int side) {
-  hashEntry *node = _getIndexNodeHT(pHT, nodeIndex);
-
-  if (node->left != -1) {
-    _balanceNodeHT(pHT, node->left, -1);
+bool _keepMergedHT(const hashEntry *left, const hashEntry *right, void *ref) {
+  hashMerge *merge = ref;
+  const hashEntry *kept = NULL;
+
+  if (left != NULL && right != NULL && (merge->keep & MERGE_RIGHT_VALUE)) {
+    // as with setHT(), the key already held stays and only the value changes
+    hashEntry replaced = (hashEntry){
+        .hash = left->hash, .kEntry = left->kEntry, .value = right->value};
+    addDA(merge->entries, &replaced);
+  } else if (left != NULL && right != NULL && (merge->keep & MERGE_BOTH)) {
+    kept = left;
+  } else if (right == NULL && (merge->keep & MERGE_LEFT)) {
+    kept = left;
+  } else if (left == NULL && (merge->keep & MERGE_RIGHT)) {
+    kept = right;
   }
-
-  if (node->right != -1) {
-    _balanceNodeHT(pHT, node->right, 1);
+  if (kept != NULL) {
+    addDA(merge->entries, kept);
   }
 
-  unsigned int depthLeft = (node->left != -1) ? maxDepthHT(pHT, node->left) : 0;
-  unsigned int depthRight =
-      (node->right != -1) ? maxDepthHT(pHT, node->right) : 0;
-  int diff = depthLeft - depthRight;
-
-  if (diff < -1 || diff > 1) {
-
-    size_t childIdx;
-    hashEntry *childNode;
-
-    if (diff < -1) {
-      // need to rotate left
-      childIdx = node->right;
-      childNode = _getIndexNodeHT(pHT, childIdx);
-
-      // rotate the nodes
-      node->right = childNode->left;
-      childNode->left = nodeIndex;
-      _getIndexNodeHT(pHT, node->right)->parent = nodeIndex;
-
-    } else if (diff > 1) {
-      // need to rotate right
-      childIdx = node->left;
-      childNode = _getIndexNodeHT(pHT, childIdx);
-
-      // rotate the nodes
-      node->left = childNode->right;
-      childNode->right = nodeIndex;
-      _getIndexNodeHT(pHT, node->left)->parent = nodeIndex;
-    }
-
-    if (_getRootIndexHT(pHT) != nodeIndex) {
-      // if not root node
-      size_t parentIdx = node->parent;
-
-      // update the parent link
-      childNode->parent = node->parent;
-      if (side < 0) {
-        _getIndexNodeHT(pHT, parentIdx)->left = childIdx;
-      } else if (side > 0) {
-        _getIndexNodeHT(pHT, parentIdx)->right = childIdx;
-      }
-    } else {
-      // if root node
-      _setRootIndexHT(pHT, childIdx);
-
-      // update the parent link
-      childNode->parent = childIdx;
-    }
-
-    node->parent = childIdx;
-  }
+  return true;
 }
 
 /**
  * @private
  */
-bool _visitNodeHT(const hashTree *pHT, const size_t nodeIndex,
-                  bool visit(const hashEntry *entry, const size_t nodeIndex,
-                             void *ref),
-                  void *ref) {
-  bool cont = true;
-  if (nodeIndex != -1) {
-    hashEntry *node = _getIndexNodeHT(pHT, nodeIndex);
-
-    if (node->left != -1) {
-      cont = _visitNodeHT(pHT, node->left, visit, ref);
-    }
-    if (node->right != -1 && cont) {
-      cont = _visitNodeHT(pHT, node->right, visit, ref);
-    }
+bool _inRightHT(const hashEntry *left, const hashEntry *right, void *ref) {
+  return right != NULL;
+}
 
-    if (cont) {
-      cont = visit(node, nodeIndex, ref);
-    }
+/**
+ * @private
+ */
+size_t _linkRangeHT(hashTree *pHT, const size_t from, const size_t to,
+                    const size_t parent) {
+  size_t middle = -1;
+
+  // the middle of each range is the root of its sub tree
+  if (from < to) {
+    middle = from + (to - from) / 2;
+    _setParentHT(pHT, middle, (parent == -1) ? middle : parent);
+    _setLeftHT(pHT, middle, _linkRangeHT(pHT, from, middle, middle));
+    _setRightHT(pHT, middle, _linkRangeHT(pHT, middle + 1, to, middle));
   }
 
-  return cont;
+  return middle;
 }
 
 /**
  * @private
  */
-void _insertNodeHT(hashTree *pHT, hashEntry *entry, const size_t entryIndex,
-                   const size_t nodeIndex) {
+static __thread int (*_sortCompareHT)(const void *a, const void *b);
 
-  hashEntry *node = _getIndexNodeHT(pHT, nodeIndex);
-  int comp = _compareHashElement(pHT, entry, node);
-
-  if (comp < 0) {
-    if (node->left == -1) {
-      node->left = entryIndex;
-      entry->parent = nodeIndex;
-    } else {
-      _insertNodeHT(pHT, entry, entryIndex, node->left);
-    }
-  } else if (comp > 0) {
-    if (node->right == -1) {
-      node->right = entryIndex;
-      entry->parent = nodeIndex;
-    } else {
-      _insertNodeHT(pHT, entry, entryIndex, node->right);
-    }
+/**
+ * @private
+ */
+int _compareEntryHT(const void *a, const void *b) {
+  const hashEntry *left = a, *right = b;
+  int comp = (left->hash < right->hash)   ? -1
+             : (left->hash > right->hash) ? 1
+                                          : 0;
+  if (comp == 0) {
+    comp = _sortCompareHT(left->kEntry->key, right->kEntry->key);
   }
+  return comp;
 }
 
 /**
  * @private
  */
-void _reinsertHT(hashTree *pHT, const size_t entryIndex) {
-  if (entryIndex != -1) {
-    hashEntry *entry = _getIndexNodeHT(pHT, entryIndex);
-    _insertNodeHT(pHT, entry, entryIndex, _getRootIndexHT(pHT));
+void _setMediansHT(hashTree *pHT, const hashEntry *entry, const size_t from,
+                   const size_t to) {
+  // each range adds its middle first, so the tree fills level by level
+  if (from < to) {
+    size_t middle = from + (to - from) / 2;
+    setHT(pHT, entry[middle].kEntry, entry[middle].value);
+    _setMediansHT(pHT, entry, from, middle);
+    _setMediansHT(pHT, entry, middle + 1, to);
   }
 }
 
 /**
  * @private
  */
-void _deleteHT(hashTree *pHT, hashEntry *entry, const size_t nodeIndex,
-               void deleted(const hashTree *pHT, const keyEntry *kEntry,
-                            void *value, void *ref),
-               void *ref) {
-
-  size_t found = _findNodeIndexHT(pHT, entry, _getRootIndexHT(pHT));
-
-  if (found != -1) {
-    hashEntry *delNode = _getIndexNodeHT(pHT, found);
-
-    if (_getRootIndexHT(pHT) != found) {
-      hashEntry *parent = _getIndexNodeHT(pHT, delNode->parent);
-
-      parent->left = (parent->left == found) ? -1 : parent->left;
-      parent->right = (parent->right == found) ? -1 : parent->right;
-    } else {
-      _setRootIndexHT(pHT,
-                      (delNode->left != -1) ? delNode->left : delNode->right);
-    }
+void _buildHT(hashTree *pHT, const dynArray *entries, const bool sorted) {
+  const hashEntry *entry = entries->array;
 
-    _reinsertHT(pHT, delNode->left);
-    _reinsertHT(pHT, delNode->right);
+  if (!_btreeHT(pHT) && !sorted) {
+    // entries added in a near order would unbalance a binary tree
+    _sortCompareHT = pHT->da->compare;
+    qsort(entries->array, entries->size, sizeof(hashEntry), _compareEntryHT);
+  }
 
-    if (deleted) {
-      deleted(pHT, delNode->kEntry, delNode->value, ref);
+  if (_btreeHT(pHT)) {
+    for (size_t i = 0; i < entries->size; i++) {
+      setHT(pHT, entry[i].kEntry, entry[i].value);
     }
-
-    size_t lastIndex = pHT->da->size - 1;
-    if (lastIndex > 0) {
-      hashEntry *lastNode = _getIndexNodeHT(pHT, lastIndex);
-      hashEntry *lastParent = _getIndexNodeHT(pHT, lastNode->parent);
-      memcpy(delNode, lastNode, pHT->da->elementSize);
-      lastParent->left =
-          (lastParent->left == lastIndex) ? found : lastParent->left;
-      lastParent->right =
-          (lastParent->right == lastIndex) ? found : lastParent->right;
-      if (_getRootIndexHT(pHT) == lastIndex) {
-        _setRootIndexHT(pHT, found);
-      }
-      hashEntry *foundNode = _getIndexNodeHT(pHT, found);
-      if (foundNode->left != -1) {
-        _getIndexNodeHT(pHT, foundNode->left)->parent = found;
-      }
-      if (foundNode->right != -1) {
-        _getIndexNodeHT(pHT, foundNode->right)->parent = found;
-      }
+  } else if (pHT->cache == NULL && pHT->da->size == 0) {
+    // entries in order are stored as they are, then linked into a balanced
+    // tree without a search per entry
+    _beginWriteHT(pHT);
+    for (size_t i = 0; i < entries->size; i++) {
+      _emplaceNodeHT(pHT, &entry[i], i);
     }
-    pHT->da->size--;
+    _setRootIndexHT(pHT, _linkRangeHT(pHT, 0, entries->size, -1));
+    _endWriteHT(pHT);
+  } else {
+    // bounded trees are set entry by entry, so they are charged and evict
+    _setMediansHT(pHT, entry, 0, entries->size);
   }
 }
 
+/**
+ * @private
+ */
+hashTree *_combineHT(const hashTree *pHT, const hashTree *pOther,
+                     hashTreeParams *params, const int keep) {
+  hashTree *pResult = createHT(pHT->da->compare, params);
+  hashMerge merge = (hashMerge){
+      .entries = createDA(sizeof(hashEntry), NULL, NULL), .keep = keep};
+
+  _mergeHT(pHT, pOther, keep & MERGE_RIGHT, _keepMergedHT, &merge);
+  // entries only from the left stay in its order even without a merge
+  _buildHT(pResult, merge.entries,
+           pResult->ordered == pHT->ordered &&
+               (_mergeableHT(pHT, pOther) || !(keep & MERGE_RIGHT)));
+  freeDA(merge.entries);
+
+  return pResult;
+}
+
 /////////////////////////////////
 // Exposed methods
 /////////////////////////////////
 
-void retainAllHT(hashTree *pHT, hashTree *pOther) {
-  size_t limit = pHT->da->size, cnt = 0;
-  const keyEntry *orphans[limit];
-
-  for (size_t i = 0; i < limit; i++) {
-    const keyEntry *kEntry = _getIndexNodeHT(pHT, i)->kEntry;
-    if (!hasEntryHT(pOther, kEntry)) {
-      orphans[cnt++] = kEntry;
-    }
-    orphans[cnt] = NULL;
+/**
+ * @private
+ */
+bool _visitHT(const hashTree *pHT, const size_t index,
+              bool visit(const hashEntry *entry, const size_t entryIndex,
+                         void *ref),
+              void *ref) {
+  bool cont = true;
+  if (_btreeHT(pHT) && index != -1) {
+    cont = _visitPageBT(pHT, index, visit, ref);
+  } else if (!_btreeHT(pHT)) {
+    cont = _visitNodeHT(pHT, index, visit, ref);
   }
+  return cont;
+}
+
+/**
+ * @private
+ */
+bool _setEntryHT(const hashEntry *entry, const size_t entryIndex,
+                 void *ref) {
+  setHT(ref, entry->kEntry, entry->value);
+  return true;
+}
 
-  for (size_t i = 0; i < limit && orphans[i] != NULL; i++) {
-    deleteHT(pHT, orphans[i]);
+void retainAllHT(hashTree *pHT, hashTree *pOther) {
+  bool rebuild = !_btreeHT(pHT) && pHT->cache == NULL;
+  // binary trees are rebuilt from the entries kept, rather than deleting
+  // the others one by one, each delete reinserting its sub trees
+  hashMerge merge =
+      (hashMerge){.entries = createDA(sizeof(hashEntry), NULL, NULL),
+                  .keep = rebuild ? MERGE_BOTH : MERGE_LEFT};
+  _mergeHT(pHT, pOther, false, _keepMergedHT, &merge);
+
+  if (rebuild && merge.entries->size < sizeHT(pHT)) {
+    // the clear and rebuild commit together, so the log never holds the
+    // tree empty
+    _beginWriteHT(pHT);
+    clearHT(pHT);
+    _buildHT(pHT, merge.entries, true);
+    _endWriteHT(pHT);
+  } else if (!rebuild) {
+    for (size_t i = 0; i < merge.entries->size; i++) {
+      deleteHT(pHT, ((hashEntry *)merge.entries->array)[i].kEntry);
+    }
   }
+  freeDA(merge.entries);
 }
 
 void deleteHT(hashTree *pHT, const keyEntry *kEntry) {
@@ -459,19 +1602,32 @@ void deleteCallbackHT(hashTree *pHT, const keyEntry *kEntry,
                                 .hash = hashKey(kEntry, 0),
                                 .left = -1,
                                 .right = -1};
-  _deleteHT(pHT, &entry, _getRootIndexHT(pHT), deleted, ref);
+  _beginWriteHT(pHT);
+  if (_btreeHT(pHT)) {
+    _deleteRootBT(pHT, &entry, deleted, ref);
+  } else {
+    _deleteHT(pHT, &entry, _getRootIndexHT(pHT), deleted, ref);
+  }
+  _endWriteHT(pHT);
 }
 
 unsigned int maxDepthHT(const hashTree *pHT, const size_t nodeIndex) {
   unsigned int left = 0, right = 0, depth = 0;
 
-  if (nodeIndex < pHT->da->size) {
-    hashEntry *entry = _getIndexNodeHT(pHT, nodeIndex);
-    if (entry->left != -1) {
-      left = maxDepthHT(pHT, entry->left);
+  if (_btreeHT(pHT)) {
+    // every leaf of a B-tree is at the same depth
+    size_t page = nodeIndex;
+    while (page < pHT->da->size) {
+      hashPage *pPage = _pageBT(pHT, page);
+      page = pPage->leaf ? (size_t)-1 : pPage->children[0];
+      depth++;
+    }
+  } else if (nodeIndex < pHT->da->size) {
+    if (_leftHT(pHT, nodeIndex) != -1) {
+      left = maxDepthHT(pHT, _leftHT(pHT, nodeIndex));
     }
-    if (entry->right != -1) {
-      right = maxDepthHT(pHT, entry->right);
+    if (_rightHT(pHT, nodeIndex) != -1) {
+      right = maxDepthHT(pHT, _rightHT(pHT, nodeIndex));
     }
 
     depth = 1 + ((left > right) ? left : right);
@@ -480,7 +1636,13 @@ unsigned int maxDepthHT(const hashTree *pHT, const size_t nodeIndex) {
   return depth;
 }
 
-void balanceHT(hashTree *pHT) { _balanceNodeHT(pHT, _getRootIndexHT(pHT), 0); }
+void balanceHT(hashTree *pHT) {
+  if (_getRootIndexHT(pHT) != -1 && !_btreeHT(pHT)) {
+    _beginWriteHT(pHT);
+    _balanceNodeHT(pHT, _getRootIndexHT(pHT), 0);
+    _endWriteHT(pHT);
+  }
+}
 
 hashEntry *getHT(const hashTree *pHT, const keyEntry *kEntry) {
   hashEntry entry = (hashEntry){.kEntry = kEntry,
@@ -488,8 +1650,33 @@ hashEntry *getHT(const hashTree *pHT, const keyEntry *kEntry) {
                                 .hash = hashKey(kEntry, 0),
                                 .left = -1,
                                 .right = -1};
+  hashEntry *node = NULL;
+
+  if (_btreeHT(pHT)) {
+    size_t page;
+    int slot;
+    if (_findBT(pHT, &entry, &page, &slot)) {
+      // page slots are gathered into a copy for this thread
+      _gatherBT(_pageBT(pHT, page), slot, &_foundHT);
+      node = &_foundHT;
+    }
+    return node;
+  }
+
+  size_t found = _findNodeIndexHT(pHT, &entry, _getRootIndexHT(pHT));
+  if (found != -1 && pHT->cache != NULL) {
+    _cacheHT(pHT, found)->referenced = true;
+  }
+  if (found != -1 && _compactHT(pHT)) {
+    // compact nodes are gathered into a copy for this thread
+    hashEntry gathered = _probeHT(pHT, found);
+    memcpy(&_foundHT, &gathered, sizeof(hashEntry));
+    node = &_foundHT;
+  } else if (found != -1) {
+    node = _getIndexNodeHT(pHT, found);
+  }
 
-  return _findNodeHT(pHT, &entry, _getRootIndexHT(pHT));
+  return node;
 }
 
 void visitNodesHT(const hashTree *pHT,
@@ -503,23 +1690,138 @@ void visitSubTreeHT(const hashTree *pHT, size_t index,
                     bool visit(const hashEntry *entry, const size_t entryIndex,
                                void *ref),
                     void *ref) {
-  _visitNodeHT(pHT, index, visit, ref);
+  _visitHT(pHT, index, visit, ref);
+}
+
+bool seekHT(hashCursor *cursor, const hashTree *pHT, const keyEntry *kEntry) {
+  bool btree = _btreeHT(pHT);
+  cursor->pHT = pHT;
+  cursor->depth = 0;
+
+  if (btree && pHT->root != -1 && kEntry == NULL) {
+    _descendBT(cursor, pHT->root);
+  } else if (btree && pHT->root != -1) {
+    hashEntry entry = (hashEntry){.kEntry = kEntry, .hash = hashKey(kEntry, 0)};
+    bool found = false;
+    size_t page = pHT->root;
+
+    // the path keeps the slot to resume from at each page
+    while (page != -1) {
+      hashPage *pPage = _pageBT(pHT, page);
+      int slot = _slotBT(pHT, pPage, &entry, &found);
+      cursor->pages[cursor->depth] = page;
+      cursor->slots[cursor->depth++] = slot;
+      page = (found || pPage->leaf) ? (size_t)-1 : pPage->children[slot];
+    }
+  } else if (!btree) {
+    DEBUG_LOG("Cursors need a B-tree, element size: %lu\n",
+              pHT->da->elementSize);
+  }
+
+  return btree;
+}
+
+hashEntry *nextHT(hashCursor *cursor) {
+  size_t entryIndex;
+  return _nextBT(cursor, &entryIndex);
+}
+
+hashEntry *firstHT(const hashTree *pHT) {
+  hashEntry *node = NULL;
+  hashCursor cursor;
+
+  if (seekHT(&cursor, pHT, NULL) && nextHT(&cursor) != NULL) {
+    memcpy(&_foundHT, &cursor.entry, sizeof(hashEntry));
+    node = &_foundHT;
+  }
+
+  return node;
+}
+
+hashEntry *lastHT(const hashTree *pHT) {
+  hashEntry *node = NULL;
+
+  if (_btreeHT(pHT) && pHT->root != -1) {
+    hashPage *pPage = _pageBT(pHT, pHT->root);
+    while (!pPage->leaf) {
+      pPage = _pageBT(pHT, pPage->children[pPage->count]);
+    }
+    _gatherBT(pPage, pPage->count - 1, &_foundHT);
+    node = &_foundHT;
+  }
+
+  return node;
+}
+
+bool rangeHT(const hashTree *pHT, const keyEntry *lo, const keyEntry *hi,
+             bool visit(const hashEntry *entry, const size_t entryIndex,
+                        void *ref),
+             void *ref) {
+  bool cont = _btreeHT(pHT) && pHT->ordered;
+  hashCursor cursor;
+  hashEntry *entry;
+  size_t entryIndex;
+
+  if (cont) {
+    seekHT(&cursor, pHT, lo);
+    while (cont && (entry = _nextBT(&cursor, &entryIndex)) != NULL &&
+           (hi == NULL || pHT->da->compare(entry->kEntry->key, hi->key) <= 0)) {
+      cont = visit(entry, entryIndex, ref);
+    }
+  } else {
+    DEBUG_LOG("Ranges need an ordered tree, element size: %lu\n",
+              pHT->da->elementSize);
+  }
+
+  return cont;
 }
 
 hashTree *createHT(int compare(const void *a, const void *b),
                    hashTreeParams *params) {
   hashTree *pHT = _safeCalloc(1, sizeof(hashTree));
+  hashTreeParams defaults = (hashTreeParams){.growth = 1.5, .capacity = 10};
 
   if (params == NULL) {
-    params = &((hashTreeParams){.growth = 1.5, .capacity = 10});
+    params = &defaults;
   }
 
   dynArrayParams daParams = (dynArrayParams){.size = 0,
                                              .growth = params->growth,
                                              .capacity = params->capacity,
-                                             .filename = params->filename};
+                                             .filename = params->filename,
+                                             .walBatch = params->walBatch,
+                                             .snapshots = params->snapshots};
+
+  if (params->btree || params->ordered) {
+    // pages are laid out by cache line
+    daParams.alignment = CACHE_LINE_ALIGNMENT;
+    pHT->da = createDA(sizeof(hashPage), compare, &daParams);
+    pHT->ordered = params->ordered;
+  } else if (params->compact) {
+    pHT->da = createDA(sizeof(hashNode), compare, &daParams);
+    if (params->filename != NULL) {
+      daParams.filename = _coldFilenameHT(params->filename);
+    }
+    pHT->cold = createDA(sizeof(hashNodeData), NULL, &daParams);
+    if (params->filename != NULL) {
+      free(daParams.filename);
+    }
+  } else {
+    pHT->da = createDA(sizeof(hashEntry), compare, &daParams);
+  }
 
-  pHT->da = createDA(sizeof(hashEntry), compare, &daParams);
+  if ((params->maxEntries != 0 || params->maxBytes != 0) && _btreeHT(pHT)) {
+    DEBUG_LOG("B-trees are not bounded, max entries: %lu\n",
+              params->maxEntries);
+  } else if (params->maxEntries != 0 || params->maxBytes != 0) {
+    pHT->cache = createDA(sizeof(hashCacheEntry), NULL,
+                          &(dynArrayParams){.capacity = params->capacity});
+    pHT->maxEntries = params->maxEntries;
+    pHT->maxBytes = params->maxBytes;
+    pHT->evicted = params->evicted;
+    pHT->evictedRef = params->evictedRef;
+  }
+  pHT->freePage = -1;
   _setRootIndexHT(pHT, -1);
   return pHT;
 }
@@ -528,57 +1830,135 @@ hashTree *copyHT(hashTree *pHT) {
   hashTree *pOther = _safeCalloc(1, sizeof(hashTree));
   memcpy(pOther, pHT, sizeof(hashTree));
   pOther->da = copyDA(pHT->da);
+  pOther->cold = _compactHT(pHT) ? copyDA(pHT->cold) : NULL;
+  pOther->cache = (pHT->cache != NULL) ? copyDA(pHT->cache) : NULL;
+  return pOther;
+}
+
+hashTree *snapshotHT(hashTree *pHT) {
+  hashTree *pOther = _safeCalloc(1, sizeof(hashTree));
+  memcpy(pOther, pHT, sizeof(hashTree));
+  pOther->da = snapshotDA(pHT->da);
+  pOther->cold = _compactHT(pHT) ? snapshotDA(pHT->cold) : NULL;
+  pOther->cache = (pHT->cache != NULL) ? copyDA(pHT->cache) : NULL;
   return pOther;
 }
 
 void setHT(hashTree *pHT, const keyEntry *kEntry, void *value) {
+  setSizedHT(pHT, kEntry, value, kEntry->length);
+}
+
+void setSizedHT(hashTree *pHT, const keyEntry *kEntry, void *value,
+                const size_t bytes) {
   hashEntry entry = (hashEntry){.kEntry = kEntry,
                                 .value = value,
                                 .hash = hashKey(kEntry, 0),
                                 .left = -1,
                                 .right = -1};
-
-  if (pHT->da->size == 0) {
-    //  if size zero then add to root
-    addDA(pHT->da, &entry);
+  size_t size = pHT->da->size;
+
+  // the tree links must be committed together
+  _beginWriteHT(pHT);
+  if (_btreeHT(pHT)) {
+    pHT->count += _insertBT(pHT, &entry);
+  } else if (pHT->da->size == 0) {
+    //  if size zero then add to root, with the parent pointing to itself
+    _emplaceNodeHT(pHT, &entry, 0);
     // set the root pointer
-    _setRootIndexHT(pHT, pHT->da->size - 1);
-    // update the parent index pointer to point to itself
-    ((hashEntry *)getDA(pHT->da, _getRootIndexHT(pHT)))->parent =
-        _getRootIndexHT(pHT);
+    _setRootIndexHT(pHT, 0);
   } else {
     // update the root node
     _addToNodeHT(pHT, &entry, _getRootIndexHT(pHT));
   }
+
+  if (pHT->cache != NULL) {
+    if (pHT->da->size > size) {
+      hashCacheEntry *added = emplaceDA(pHT->cache);
+      *added = (hashCacheEntry){.bytes = bytes, .referenced = false};
+    } else {
+      // a replaced value is charged afresh, and counts as a use
+      hashCacheEntry *replaced = _cacheHT(
+          pHT, _findNodeIndexHT(pHT, &entry, _getRootIndexHT(pHT)));
+      pHT->bytes -= replaced->bytes;
+      *replaced = (hashCacheEntry){.bytes = bytes, .referenced = true};
+    }
+    pHT->bytes += bytes;
+    _evictHT(pHT);
+  }
+  _endWriteHT(pHT);
 }
 
 void setAllHT(hashTree *pHT, const hashTree *pOther) {
-  size_t limit = pOther->da->size;
-  for (size_t i = 0; i < limit; i++) {
-    hashEntry *other = _getIndexNodeHT(pOther, i);
-    setHT(pHT, other->kEntry, other->value);
+  // a merged rebuild reads every entry, so small additions are set in place
+  if (!_btreeHT(pHT) && pHT->cache == NULL && _mergeableHT(pHT, pOther) &&
+      sizeHT(pOther) * 16 >= sizeHT(pHT)) {
+    hashMerge merge = (hashMerge){
+        .entries = createDA(sizeof(hashEntry), NULL, NULL),
+        .keep = MERGE_LEFT | MERGE_BOTH | MERGE_RIGHT | MERGE_RIGHT_VALUE};
+    _mergeHT(pHT, pOther, true, _keepMergedHT, &merge);
+    _beginWriteHT(pHT);
+    clearHT(pHT);
+    _buildHT(pHT, merge.entries, true);
+    _endWriteHT(pHT);
+    freeDA(merge.entries);
+  } else {
+    visitNodesHT(pOther, _setEntryHT, pHT);
   }
 }
 
 bool hasEntryHT(const hashTree *pHT, const keyEntry *kEntry) {
-  return getHT(pHT, kEntry) != NULL;
+  hashEntry entry = (hashEntry){.kEntry = kEntry, .hash = hashKey(kEntry, 0)};
+  size_t page;
+  int slot;
+  return _btreeHT(pHT)
+             ? _findBT(pHT, &entry, &page, &slot)
+             : _findNodeIndexHT(pHT, &entry, _getRootIndexHT(pHT)) != -1;
 }
 
 bool hasAllHT(const hashTree *pHT, const hashTree *pOther) {
-  bool has = pHT != NULL && pOther != NULL && pHT->da->size >= pOther->da->size;
+  bool has = pHT != NULL && pOther != NULL && sizeHT(pHT) >= sizeHT(pOther);
 
-  size_t limit = pOther->da->size;
-  for (size_t i = 0; has && i < limit; i++) {
-    has = hasEntryHT(pHT, _getIndexNodeHT(pOther, i)->kEntry);
-  }
+  return has && subsetHT(pOther, pHT);
+}
 
-  return has;
+bool subsetHT(const hashTree *pHT, const hashTree *pOther) {
+  // the merge stops at the first entry missing from the other tree
+  return sizeHT(pHT) <= sizeHT(pOther) &&
+         _mergeHT(pHT, pOther, false, _inRightHT, NULL);
+}
+
+hashTree *unionHT(const hashTree *pHT, const hashTree *pOther,
+                  hashTreeParams *params) {
+  return _combineHT(pHT, pOther, params,
+                    MERGE_LEFT | MERGE_BOTH | MERGE_RIGHT);
+}
+
+hashTree *intersectHT(const hashTree *pHT, const hashTree *pOther,
+                      hashTreeParams *params) {
+  return _combineHT(pHT, pOther, params, MERGE_BOTH);
+}
+
+hashTree *differenceHT(const hashTree *pHT, const hashTree *pOther,
+                       hashTreeParams *params) {
+  return _combineHT(pHT, pOther, params, MERGE_LEFT);
 }
 
 void clearHT(hashTree *pHT) {
   if (pHT) {
+    _beginWriteHT(pHT);
     clearDA(pHT->da);
+    if (_compactHT(pHT)) {
+      clearDA(pHT->cold);
+    }
+    if (pHT->cache != NULL) {
+      clearDA(pHT->cache);
+    }
+    pHT->hand = 0;
+    pHT->bytes = 0;
+    pHT->count = 0;
+    pHT->freePage = -1;
     _setRootIndexHT(pHT, -1);
+    _endWriteHT(pHT);
   }
 }
 
@@ -586,7 +1966,10 @@ void drawNode(const hashTree *pHT, const size_t nodeIdx, FILE *file) {
   if (file == NULL) {
     file = stdout;
   }
-  if (pHT->da->size > 0 && _getRootIndexHT(pHT) != -1) {
+  if (pHT->da->size > 0 && nodeIdx != -1 && _btreeHT(pHT)) {
+    fprintf(file, "\n");
+    _drawPageBT(pHT, nodeIdx, 0, file);
+  } else if (pHT->da->size > 0 && _getRootIndexHT(pHT) != -1) {
     fprintf(file, "\n");
     _drawNode(pHT, _getRootIndexHT(pHT), "", "", file);
   }
@@ -601,21 +1984,54 @@ hashTree *loadHT(const char *filename,
                  int compare(const void *a, const void *b)) {
 
   dynArray *pDA = loadDA(filename, compare);
-
-  hashTree *pHT = _safeCalloc(1, sizeof(hashTree));
-  pHT->da=pDA;
-  
-  fileHeader header;
-  readHeaderDA(pDA, &header);
-  
-  pHT->root = *(size_t *)(header.buffer);
+  hashTree *pHT = NULL;
+
+  if (pDA != NULL) {
+    pHT = _safeCalloc(1, sizeof(hashTree));
+    pHT->da = pDA;
+
+    fileHeader header;
+    readHeaderDA(pDA, &header);
+
+    memcpy(&pHT->root, header.buffer, sizeof(pHT->root));
+    pHT->freePage = -1;
+
+    if (_btreeHT(pHT)) {
+      // B-trees keep the free page list and order after the root, and
+      // count their entries on load
+      memcpy(&pHT->freePage, header.buffer + sizeof(pHT->root),
+             sizeof(pHT->freePage));
+      memcpy(&pHT->ordered,
+             header.buffer + sizeof(pHT->root) + sizeof(pHT->freePage),
+             sizeof(pHT->ordered));
+      pHT->count = (pHT->root != -1) ? _countPageBT(pHT, pHT->root) : 0;
+    } else if (pDA->elementSize == sizeof(hashNode)) {
+      // compact trees keep the node data in a second file
+      char *name = _coldFilenameHT(filename);
+      pHT->cold = loadDA(name, NULL);
+      free(name);
+      if (pHT->cold == NULL || pHT->cold->size != pDA->size) {
+        DEBUG_LOG("Error invalid compact tree file: %s\n", filename);
+        freeDA(pHT->cold);
+        freeDA(pDA);
+        free(pHT);
+        pHT = NULL;
+      }
+    }
+  }
 
   return pHT;
 }
 
+size_t sizeHT(const hashTree *pHT) {
+  return _btreeHT(pHT) ? pHT->count : pHT->da->size;
+}
+
 void freeHT(hashTree *pHT) {
   if (pHT) {
     freeDA(pHT->da);
+    freeDA(pHT->cold);
+    freeDA(pHT->cache);
     free(pHT);
   }
 }
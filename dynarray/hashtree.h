@@ -4,6 +4,10 @@
 #include "dynarray.h"
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
  * @file dynarray.h
  *
@@ -30,14 +34,100 @@ typedef struct HashEntry {
   void *value;            ///< the value
 } hashEntry;
 
+/**
+ * @brief The hot part of a compact tree node, read on every step of a search
+ */
+typedef struct HashNode {
+  uint32_t hash;  ///< the hash
+  uint32_t left;  ///< the smaller left node or UINT32_MAX
+  uint32_t right; ///< the larger right node or UINT32_MAX
+} hashNode;
+
+/**
+ * @brief The cold part of a compact tree node, read when the hash matches
+ */
+typedef struct HashNodeData {
+  const keyEntry *kEntry; ///< the key
+  void *value;            ///< the value
+  size_t parent;          ///< the parent node
+} hashNodeData;
+
+/**
+ * @brief The suffix of the node data file for memory mapped compact trees
+ */
+#define HT_COLD_SUFFIX ".cold"
+
+/**
+ * @brief The minimum degree of a B-tree page
+ */
+#define BT_DEGREE 8
+
+/**
+ * @brief The most entries in a B-tree page
+ */
+#define BT_KEYS (2 * BT_DEGREE - 1)
+
+/**
+ * @brief A B-tree page
+ *
+ * The hashes and the child links each fill a cache line, so a search reads
+ * two lines per page and only reads a key when its hash matches.
+ */
+typedef struct HashPage {
+  uint32_t hashes[BT_KEYS];          ///< the entry hashes in order
+  uint16_t count;                    ///< the number of entries
+  uint16_t leaf;                     ///< 1 if the page has no children
+  uint32_t children[BT_KEYS + 1];    ///< the child pages
+  const keyEntry *kEntries[BT_KEYS]; ///< the entry keys
+  void *values[BT_KEYS];             ///< the entry values
+} __attribute__((aligned(64))) hashPage;
+
+/**
+ * @brief The cache state of a tree node, see hashTreeParams
+ */
+typedef struct HashCacheEntry {
+  size_t bytes;    ///< the bytes charged for the entry
+  bool referenced; ///< set by getHT(), cleared as the clock hand passes
+} hashCacheEntry;
+
 /**
  * @brief Hash tree entity
  */
 typedef struct HashTree {
-  dynArray *da; ///< the storage array
-  size_t root;  ///< the root node
+  dynArray *da;    ///< the storage array, of hashNode for compact trees and
+                   ///< hashPage for B-trees
+  size_t root;     ///< the root node, or root page for B-trees
+  dynArray *cold;  ///< the hashNodeData of a compact tree, else NULL
+  size_t count;    ///< the number of entries in a B-tree
+  size_t freePage; ///< the first free B-tree page or -1
+  bool ordered;    ///< 'true' if the B-tree is ordered by key alone
+  dynArray *cache; ///< the hashCacheEntry of each node if bounded, else NULL
+  size_t hand;     ///< the next node checked by the cache clock hand
+  size_t bytes;    ///< the bytes charged to a bounded tree
+  size_t maxEntries; ///< the most entries in a bounded tree or 0
+  size_t maxBytes;   ///< the most bytes charged to a bounded tree or 0
+  void (*evicted)(const struct HashTree *pHT, const keyEntry *kEntry,
+                  void *value,
+                  void *ref); ///< called for each evicted entry, may be NULL
+  void *evictedRef;           ///< the evicted callback reference
 } hashTree;
 
+/**
+ * @brief The most pages from the root to a leaf of a B-tree
+ */
+#define BT_MAX_DEPTH 16
+
+/**
+ * @brief A position in a B-tree, see seekHT()
+ */
+typedef struct HashCursor {
+  const hashTree *pHT;           ///< the tree being iterated
+  uint32_t pages[BT_MAX_DEPTH];  ///< the pages from the root down
+  uint16_t slots[BT_MAX_DEPTH];  ///< the next slot in each page
+  int depth;                     ///< the number of pages on the path
+  hashEntry entry;               ///< the last entry returned by nextHT()
+} hashCursor;
+
 /**
  * @brief Hash tree creation parameters
  */
@@ -46,6 +136,17 @@ typedef struct HashTreeParams {
   size_t capacity; ///< the initial reserved capacity for the entries
   char
       *filename; ///< the filename for the memory mapped file if used, else NULL
+  size_t walBatch; ///< the write ahead log group commit size or 0 for no log
+  bool snapshots;  ///< back the tree with shared pages for snapshotHT()
+  bool compact;    ///< split the nodes into hashNode and hashNodeData arrays
+  bool btree;      ///< store the entries in hashPage B-tree pages
+  bool ordered;    ///< order a B-tree by the key comparator alone, implies
+                   ///< btree
+  size_t maxEntries; ///< bound the tree to this many entries, or 0
+  size_t maxBytes;   ///< bound the bytes charged to the tree, or 0
+  void (*evicted)(const hashTree *pHT, const keyEntry *kEntry, void *value,
+                  void *ref); ///< called for each evicted entry, may be NULL
+  void *evictedRef;           ///< the evicted callback reference
 } hashTreeParams;
 
 /**
@@ -76,6 +177,32 @@ uint32_t hashKey(const keyEntry *kEntry, const uint32_t seed);
 /**
  * @brief Create a new hash tree
  *
+ * Compact trees keep the hash and 32 bit child links of each node in one
+ * array and the key, value and parent in another, so a search only reads
+ * the 12 byte hot nodes until the hash matches. They hold fewer than
+ * UINT32_MAX entries. Memory mapped compact trees store the node data in a
+ * second file, with HT_COLD_SUFFIX appended to the filename, and each file
+ * commits its own write ahead log.
+ *
+ * B-trees keep the same hash then key order in pages of up to BT_KEYS
+ * entries, so a search reads a few pages rather than one node per level.
+ * They are always balanced. The visitors see the entries in order, with an
+ * entry index of the page times BT_KEYS plus the slot, and the sub tree
+ * functions take a page index.
+ *
+ * Ordered B-trees compare the keys alone, so the entries are visited in key
+ * order and can be scanned by range with rangeHT() or a cursor. A lookup
+ * then compares keys at each page rather than hashes.
+ *
+ * A tree with maxEntries or maxBytes set is a bounded cache. Once a set
+ * goes over a bound, entries are evicted with the CLOCK algorithm: a hand
+ * sweeps the nodes in storage order, sparing and clearing those looked up by
+ * getHT() since it last passed, and deleting the first it finds unreferenced.
+ * Each eviction is passed to the evicted callback, as with deleteCallbackHT().
+ * Entries are charged their key length, or the bytes given to setSizedHT().
+ * The cache state is kept beside the nodes, on the heap, so it is lost when
+ * a memory mapped tree is loaded. B-trees are not bounded.
+ *
  * @param compare the key comparator function
  * @param params a pointer to the hash tree parameters or NULL for default
  * @return An initialised hash tree that
@@ -88,7 +215,8 @@ hashTree *createHT(int compare(const void *a, const void *b),
  * @brief Load a hash tree
  * @param filename the filename to load from
  * @param compare the comparator function
- * @return An initialised hash tree that should be freed with freeHT()
+ * @return An initialised hash tree that should be freed with freeHT(), or
+ * NULL if the file could not be loaded
  */
 hashTree *loadHT(const char *filename,
                  int compare(const void *a, const void *b));
@@ -101,6 +229,17 @@ hashTree *loadHT(const char *filename,
  */
 hashTree *copyHT(hashTree *pHT);
 
+/**
+ * @brief Take a copy on write snapshot of a hash tree
+ *
+ * See snapshotDA(), trees created without snapshots are copied.
+ *
+ * @param pHT the hash tree pointer to snapshot
+ * @return A snapshot of the hash tree that
+ *          should be freed with freeHT()
+ */
+hashTree *snapshotHT(hashTree *pHT);
+
 /**
  * @brief Aet a key value pair in the tree
  * @param pHT the hash tree pointer
@@ -109,6 +248,19 @@ hashTree *copyHT(hashTree *pHT);
  */
 void setHT(hashTree *pHT, const keyEntry *kEntry, void *value);
 
+/**
+ * @brief Set a key value pair, charging a bounded tree for its size
+ *
+ * Replacing a value updates the charge. See createHT() for bounded trees.
+ *
+ * @param pHT the hash tree pointer
+ * @param kEntry the key entry pointer
+ * @param value the value pointer
+ * @param bytes the bytes to charge for the entry
+ */
+void setSizedHT(hashTree *pHT, const keyEntry *kEntry, void *value,
+                size_t bytes);
+
 /**
  * @brief Set all the key value pairs from the other tree
  * @param pHT the hash tree pointer to set in
@@ -141,6 +293,11 @@ void drawTree(const hashTree *pHT, FILE *file);
 
 /**
  * @brief Find a node in the tree
+ *
+ * The nodes of compact trees and B-trees are gathered into an entry owned by
+ * the calling thread, which is replaced by the next call. Use setHT() to
+ * change the value.
+ *
  * @param pHT the hash tree pointer to search
  * @param kEntry the key entry
  * @return the found entry or NULL if not found
@@ -185,6 +342,68 @@ void visitSubTreeHT(const hashTree *pHT, size_t index,
                                void *ref),
                     void *ref);
 
+/**
+ * @brief Position a cursor at the first entry not less than a key
+ *
+ * Cursors walk a B-tree in order, reading one page per level to seek and
+ * then each entry in turn. Any change to the tree invalidates its cursors.
+ * For example:
+ *
+ * hashCursor cursor;
+ * seekHT(&cursor, pHT, NULL);
+ * for (hashEntry *entry; (entry = nextHT(&cursor)) != NULL;) { ... }
+ *
+ * @param cursor the cursor to position
+ * @param pHT the B-tree to iterate
+ * @param kEntry the key to seek or NULL for the first entry
+ * @return 'false' if the tree is not a B-tree
+ */
+bool seekHT(hashCursor *cursor, const hashTree *pHT, const keyEntry *kEntry);
+
+/**
+ * @brief Read the entry at a cursor and move to the next
+ * @param cursor the cursor positioned by seekHT()
+ * @return the entry, owned by the cursor, or NULL after the last entry
+ */
+hashEntry *nextHT(hashCursor *cursor);
+
+/**
+ * @brief Find the first entry of a B-tree
+ *
+ * The entry is gathered as for getHT().
+ *
+ * @param pHT the B-tree to search
+ * @return the entry with the lowest key for ordered trees, or NULL if empty
+ */
+hashEntry *firstHT(const hashTree *pHT);
+
+/**
+ * @brief Find the last entry of a B-tree
+ *
+ * The entry is gathered as for getHT().
+ *
+ * @param pHT the B-tree to search
+ * @return the entry with the highest key for ordered trees, or NULL if empty
+ */
+hashEntry *lastHT(const hashTree *pHT);
+
+/**
+ * @brief Vist each entry of an ordered tree in a key range, in key order
+ *
+ * If the visitor method returns false then the visit will stop.
+ *
+ * @param pHT the ordered tree to visit
+ * @param lo the lowest key to visit or NULL for the first entry
+ * @param hi the highest key to visit or NULL for the last entry
+ * @param visit the function to call for each entry
+ * @param ref optional value to pass to visit method, maybe NULL
+ * @return 'false' if the tree is not ordered or the visitor stopped
+ */
+bool rangeHT(const hashTree *pHT, const keyEntry *lo, const keyEntry *hi,
+             bool visit(const hashEntry *entry, const size_t entryIndex,
+                        void *ref),
+             void *ref);
+
 /**
  * @brief Delete a node from the tree
  * @param pHT the hash tree pointer to delete from
@@ -228,16 +447,74 @@ bool hasAllHT(const hashTree *pHT, const hashTree *pOther);
  */
 void retainAllHT(hashTree *pHT, hashTree *pOther);
 
+/**
+ * @brief Check if all the keys of the tree are in the other tree
+ *
+ * Trees of the same order are read side by side in a single pass, otherwise
+ * each key is looked up in the other tree.
+ *
+ * @param pHT the hash tree pointer of keys to search for
+ * @param pOther the hash tree pointer to search
+ * @return 'true' if all the keys are in the other tree
+ */
+bool subsetHT(const hashTree *pHT, const hashTree *pOther);
+
+/**
+ * @brief Create a tree of the entries in either tree
+ *
+ * The entries are merged in a single pass and the new tree is built from
+ * them in bulk, a binary tree coming out already balanced. The values of the
+ * first tree are kept for keys in both.
+ *
+ * @param pHT the hash tree pointer
+ * @param pOther the other hash tree pointer
+ * @param params a pointer to the tree parameters of the result or NULL
+ * @return the tree that should be freed with freeHT()
+ */
+hashTree *unionHT(const hashTree *pHT, const hashTree *pOther,
+                  hashTreeParams *params);
+
+/**
+ * @brief Create a tree of the entries of the first tree also in the other
+ * @param pHT the hash tree pointer of the entries to keep
+ * @param pOther the other hash tree pointer
+ * @param params a pointer to the tree parameters of the result or NULL
+ * @return the tree that should be freed with freeHT()
+ */
+hashTree *intersectHT(const hashTree *pHT, const hashTree *pOther,
+                      hashTreeParams *params);
+
+/**
+ * @brief Create a tree of the entries of the first tree not in the other
+ * @param pHT the hash tree pointer of the entries to keep
+ * @param pOther the other hash tree pointer
+ * @param params a pointer to the tree parameters of the result or NULL
+ * @return the tree that should be freed with freeHT()
+ */
+hashTree *differenceHT(const hashTree *pHT, const hashTree *pOther,
+                       hashTreeParams *params);
+
 /**
  * @brief Clear the contents of the hash tree.
  * @param pHT the hash tree pointer to clear
  */
 void clearHT(hashTree *pHT);
 
+/**
+ * @brief The number of entries in the tree
+ * @param pHT the hash tree pointer
+ * @return the number of entries
+ */
+size_t sizeHT(const hashTree *pHT);
+
 /**
  * @brief Free a hash tree
  * @param pHT the hash tree to free
  */
 void freeHT(hashTree *pHT);
 
-#endif
\ No newline at end of file
+#ifdef __cplusplus
+}
+#endif
+
+#endif